@@ -10,7 +10,7 @@ namespace descript {
     class dsAllocator
     {
     public:
-        virtual [[nodiscard]] void* allocate(uint32_t size, uint32_t alignment) = 0;
+        [[nodiscard]] virtual void* allocate(uint32_t size, uint32_t alignment) = 0;
         virtual void free(void* block, uint32_t size, uint32_t alignment) = 0;
 
     protected:
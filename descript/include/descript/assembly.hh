@@ -16,4 +16,9 @@ namespace descript {
         uint32_t size);
     DS_API void dsAcquireAssembly(dsAssembly* assembly) noexcept;
     DS_API void dsReleaseAssembly(dsAssembly* assembly);
+
+    /// Pre-allocates memory so that at least count instances of the assembly can be
+    /// created without further allocations. Large counts are reserved in several slabs;
+    /// if the allocator fails, only the slabs allocated before it remain reserved.
+    DS_API void dsReserveInstances(dsAssembly* assembly, uint32_t count);
 } // namespace descript
@@ -0,0 +1,89 @@
+// descript
+
+#pragma once
+
+#include "descript/compile_types.hh"
+#include "descript/context.hh"
+#include "descript/meta.hh"
+#include "descript/types.hh"
+#include "descript/value.hh"
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace descript {
+    /// Everything needed to register a plain C++ function with both the compiler and the runtime.
+    struct dsFunctionBinding
+    {
+        dsFunction function = nullptr;            // reads arguments through dsFunctionContext; also usable to fold
+        dsNativeFunction native = nullptr;        // reads arguments in place from the evaluation stack
+        dsTypeMeta const* nativeResult = nullptr; // type of the value native writes
+        dsFunctionSignature const* signature = nullptr;
+    };
+
+    namespace detail_ {
+        template <auto Function, typename FunctionT>
+        struct dsFunctionBinder;
+
+        template <auto Function, typename ResultT, typename... ParamsT>
+        struct dsFunctionBinder<Function, ResultT (*)(ParamsT...)>
+        {
+            using Result = std::remove_cvref_t<ResultT>;
+
+            static_assert(dsIsValue<Result>, "bound functions must return a value type");
+            static_assert((dsIsValue<std::remove_cvref_t<ParamsT>> && ...), "bound function parameters must be value types");
+            static_assert(((sizeof(std::remove_cvref_t<ParamsT>) <= dsNativeArgStride) && ... && (sizeof(Result) <= dsNativeArgStride)),
+                "bound function values must fit a stack cell");
+            static_assert(sizeof...(ParamsT) <= UINT8_MAX, "too many parameters");
+
+            // padded, so that a function without parameters does not declare an empty array
+            static constexpr dsTypeId paramTypes[] = {dsType<std::remove_cvref_t<ParamsT>>.typeId..., dsInvalidTypeId};
+            static constexpr dsFunctionSignature signature{
+                .paramTypes = paramTypes, .returnType = dsType<Result>.typeId, .paramCount = sizeof...(ParamsT)};
+
+            template <typename T>
+            static T const& arg(void const* args, uint32_t index) noexcept
+            {
+                void const* const cell = static_cast<char const*>(args) + index * dsNativeArgStride;
+                return *std::launder(static_cast<T const*>(cell));
+            }
+
+            template <size_t... Indices>
+            static void invokeNative(void* args, std::index_sequence<Indices...>)
+            {
+                // every argument is read before the result overwrites the first of them
+                Result const result = Function(arg<std::remove_cvref_t<ParamsT>>(args, Indices)...);
+                new (args) Result(result);
+            }
+
+            template <size_t... Indices>
+            static void invoke(dsFunctionContext& ctx, std::index_sequence<Indices...>)
+            {
+                ctx.result(Result(Function(ctx.getArgAt<std::remove_cvref_t<ParamsT>>(Indices)...)));
+            }
+
+            static void native(void* args, void*) { invokeNative(args, std::index_sequence_for<ParamsT...>{}); }
+            static void function(dsFunctionContext& ctx, void*) { invoke(ctx, std::index_sequence_for<ParamsT...>{}); }
+        };
+
+        template <auto Function, typename ResultT, typename... ParamsT>
+        struct dsFunctionBinder<Function, ResultT (*)(ParamsT...) noexcept> : dsFunctionBinder<Function, ResultT (*)(ParamsT...)>
+        {
+        };
+    } // namespace detail_
+
+    /// Adapts a function taking and returning value types, such as float(float, float), so that the
+    /// interpreter may call it with its arguments taken directly from the stack. The signature lets
+    /// the compiler check the argument types, which the native adapter relies upon.
+    template <auto Function>
+    [[nodiscard]] constexpr dsFunctionBinding dsBindFunction() noexcept
+    {
+        using Binder = detail_::dsFunctionBinder<Function, decltype(Function)>;
+        return dsFunctionBinding{.function = &Binder::function,
+            .native = &Binder::native,
+            .nativeResult = &dsType<typename Binder::Result>,
+            .signature = &Binder::signature};
+    }
+} // namespace descript
@@ -53,5 +53,10 @@ namespace descript {
         char const* name = nullptr;
         dsFunctionId functionId = dsInvalidFunctionId;
         dsTypeId returnType = dsInvalidTypeId;
+        bool isVolatile = false;   // may return a different result without the expression being notified of a change
+        bool isPure = false;       // result depends only on the arguments, so calls with constant arguments may be folded
+        dsFunction fold = nullptr; // evaluates a pure call at compile time; often the runtime implementation itself
+        void* foldUserData = nullptr;
+        dsFunctionSignature const* signature = nullptr; // when set, calls must match it (or one chained after it)
     };
 }
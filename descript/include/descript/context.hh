@@ -31,16 +31,16 @@ namespace descript {
     class dsNodeContext
     {
     public:
-        virtual [[nodiscard]] dsInstanceId instanceId() const noexcept = 0;
-        virtual [[nodiscard]] dsNodeIndex nodeIndex() const noexcept = 0;
+        [[nodiscard]] virtual dsInstanceId instanceId() const noexcept = 0;
+        [[nodiscard]] virtual dsNodeIndex nodeIndex() const noexcept = 0;
 
-        virtual [[nodiscard]] uint32_t numInputPlugs() const noexcept = 0;
-        virtual [[nodiscard]] uint32_t numOutputPlugs() const noexcept = 0;
-        virtual [[nodiscard]] uint32_t numInputSlots() const noexcept = 0;
-        virtual [[nodiscard]] uint32_t numOutputSlots() const noexcept = 0;
+        [[nodiscard]] virtual uint32_t numInputPlugs() const noexcept = 0;
+        [[nodiscard]] virtual uint32_t numOutputPlugs() const noexcept = 0;
+        [[nodiscard]] virtual uint32_t numInputSlots() const noexcept = 0;
+        [[nodiscard]] virtual uint32_t numOutputSlots() const noexcept = 0;
 
-        virtual [[nodiscard]] bool readSlot(dsInputSlot slot, dsValueOut out_value) = 0;
-        virtual [[nodiscard]] bool readOutputSlot(dsOutputSlot slot, dsValueOut out_value) = 0;
+        [[nodiscard]] virtual bool readSlot(dsInputSlot slot, dsValueOut out_value) = 0;
+        [[nodiscard]] virtual bool readOutputSlot(dsOutputSlot slot, dsValueOut out_value) = 0;
 
         virtual void writeSlot(dsOutputSlot slot, dsValueRef const& value) = 0;
 
@@ -40,16 +40,18 @@ namespace descript {
     public:
         virtual void reset() = 0;
 
-        virtual [[nodiscard]]bool compile(char const* expression, char const* expressionEnd = nullptr) = 0;
-        virtual [[nodiscard]]bool optimize() = 0;
-        virtual [[nodiscard]]bool build(dsExpressionBuilder& builder) = 0;
-
-        virtual [[nodiscard]]bool isEmpty() const noexcept = 0;
-        virtual [[nodiscard]]bool isConstant() const noexcept = 0;
-        virtual [[nodiscard]]bool isVariableOnly() const noexcept = 0;
-        virtual [[nodiscard]]dsTypeId resultType() const noexcept = 0;
-
-        virtual [[nodiscard]] bool asConstant(dsValueOut out_value) const = 0;
+        [[nodiscard]] virtual bool compile(char const* expression, char const* expressionEnd = nullptr) = 0;
+        [[nodiscard]] virtual bool optimize() = 0;
+        [[nodiscard]] virtual bool build(dsExpressionBuilder& builder) = 0;
+
+        [[nodiscard]] virtual bool isEmpty() const noexcept = 0;
+        [[nodiscard]] virtual bool isConstant() const noexcept = 0;
+        [[nodiscard]] virtual bool isVariableOnly() const noexcept = 0;
+        [[nodiscard]] virtual bool isVolatile() const noexcept = 0;
+        [[nodiscard]] virtual dsTypeId resultType() const noexcept = 0;
+        [[nodiscard]] virtual uint32_t maxStackDepth() const noexcept = 0;
+
+        [[nodiscard]] virtual bool asConstant(dsValueOut out_value) const = 0;
 
     protected:
         ~dsExpressionCompiler() = default;
@@ -55,18 +55,18 @@ namespace descript {
         virtual void addWire(dsNodeId fromNodeId, dsOutputPlugIndex fromPlugIndex, dsNodeId toNodeId, dsInputPlugIndex toPlugIndex) = 0;
 
         // compiles defined graph, validates for errors and builds internal state
-        virtual [[nodiscard]] bool compile() = 0;
+        [[nodiscard]] virtual bool compile() = 0;
 
         // creates an assembly for serialization; only allowed after compile() returns true
-        virtual [[nodiscard]] bool build() = 0;
+        [[nodiscard]] virtual bool build() = 0;
 
         // queries the errors that have occured for the current graph
-        virtual [[nodiscard]] uint32_t getErrorCount() const noexcept = 0;
-        virtual [[nodiscard]] dsCompileError getError(uint32_t index) const noexcept = 0;
+        [[nodiscard]] virtual uint32_t getErrorCount() const noexcept = 0;
+        [[nodiscard]] virtual dsCompileError getError(uint32_t index) const noexcept = 0;
 
         // retrives the serialized assembly, only valid after build() returns true
-        virtual [[nodiscard]] uint8_t const* assemblyBytes() const noexcept = 0;
-        virtual [[nodiscard]] uint32_t assemblySize() const noexcept = 0;
+        [[nodiscard]] virtual uint8_t const* assemblyBytes() const noexcept = 0;
+        [[nodiscard]] virtual uint32_t assemblySize() const noexcept = 0;
 
     protected:
         ~dsGraphCompiler() = default;
@@ -12,10 +12,10 @@ namespace descript {
     public:
         constexpr explicit dsKey(UnderlyingT value) noexcept : value_(value) {}
 
-        constexpr [[nodiscard]] UnderlyingT value() const noexcept { return value_; }
+        [[nodiscard]] constexpr UnderlyingT value() const noexcept { return value_; }
 
-        constexpr [[nodiscard]] std::strong_ordering operator<=>(dsKey const&) const noexcept = default;
-        constexpr [[nodiscard]] bool operator==(dsKey const&) const noexcept = default;
+        [[nodiscard]] constexpr std::strong_ordering operator<=>(dsKey const&) const noexcept = default;
+        [[nodiscard]] constexpr bool operator==(dsKey const&) const noexcept = default;
 
     private:
         UnderlyingT value_;
@@ -122,5 +122,5 @@ namespace descript {
 
     template <typename T>
     requires dsIsValue<T>
-    constexpr [[nodiscard]] dsTypeMeta const& dsTypeOf(T const&) noexcept { return dsType<T>; }
+    [[nodiscard]] constexpr dsTypeMeta const& dsTypeOf(T const&) noexcept { return dsType<T>; }
 } // namespace descript
@@ -27,6 +27,51 @@ namespace descript {
         dsFunctionId functionId = dsInvalidFunctionId;
         dsFunction function = nullptr;
         void* userData = nullptr;
+        dsNativeFunction native = nullptr;         // preferred over function by the interpreter when set
+        dsTypeMeta const* nativeResult = nullptr; // type of the value native writes
+    };
+
+    struct dsRuntimeStats final
+    {
+        uint64_t queuedEvents = 0;
+        uint64_t coalescedDependencyEvents = 0; // Dependency events merged into one already pending for the node
+        uint64_t coalescedPostedChanges = 0;    // posted changes dropped as duplicates within a single drain
+        uint64_t rejectedPostedChanges = 0;     // postChange() calls refused because the queue was full
+        uint64_t cachedSlotReads = 0;           // expression slot reads answered from the instance's result cache
+        uint64_t listenerChanges = 0;           // listeners added to or removed from the emitter registry
+    };
+
+    using dsRuntimeJob = void (*)(void* userData, uint32_t jobIndex);
+
+    /// Bridges the runtime to the host's job system for parallel event processing.
+    class dsRuntimeScheduler
+    {
+    public:
+        /// Number of jobs parallel work is split into; usually the number of worker threads.
+        [[nodiscard]] virtual uint32_t workerCount() const noexcept = 0;
+
+        /// Invokes job for every index in [0, jobCount), potentially concurrently,
+        /// and returns only once all of them have completed.
+        virtual void dispatch(dsRuntimeJob job, void* userData, uint32_t jobCount) = 0;
+
+    protected:
+        ~dsRuntimeScheduler() = default;
+    };
+
+    /// Controls how processEvents() distributes instances.
+    ///
+    /// In the parallel modes, node and function callbacks for different instances run
+    /// concurrently. Callbacks may use their context, makeEmitterId() and notifyChange(),
+    /// but must not create, destroy or access other instances. The runtime's allocator
+    /// must be thread-safe.
+    enum class dsProcessMode : uint8_t
+    {
+        Serial,
+        // instances are processed in chunks on the host's scheduler
+        Parallel,
+        // as Parallel, but listener changes, notifications and emitter ids are
+        // merged in chunk order, so results do not depend on thread timing
+        Deterministic,
     };
 
     class dsRuntimeHost
@@ -36,6 +81,12 @@ namespace descript {
         virtual bool lookupFunction(dsFunctionId, dsFunctionRuntimeMeta& out_meta) const noexcept = 0;
         virtual bool lookupType(dsTypeId typeId, dsTypeMeta const*& out_meta) const noexcept = 0;
 
+        // hosts without a scheduler always process events serially
+        [[nodiscard]] virtual dsRuntimeScheduler* scheduler() const noexcept { return nullptr; }
+
+        // changes postChange() can queue between two processEvents() calls; rounded up to a power of two
+        [[nodiscard]] virtual uint32_t postedChangeCapacity() const noexcept { return 4096; }
+
     protected:
         ~dsRuntimeHost() = default;
     };
@@ -47,13 +98,31 @@ namespace descript {
         virtual void destroyInstance(dsInstanceId instanceId) = 0;
 
         virtual bool writeVariable(dsInstanceId instanceId, dsName variable, dsValueRef const& value) = 0;
-        virtual [[nodiscard]] bool readVariable(dsInstanceId instanceId, dsName variable, dsValueOut out_value) = 0;
+        [[nodiscard]] virtual bool readVariable(dsInstanceId instanceId, dsName variable, dsValueOut out_value) = 0;
+
+        // handles resolve a variable name once; they are only valid for instances of the assembly they were looked up in
+        [[nodiscard]] virtual dsVariableHandle lookupVariable(dsAssembly* assembly, dsName variable) const noexcept = 0;
+        virtual bool writeVariable(dsInstanceId instanceId, dsVariableHandle variable, dsValueRef const& value) = 0;
+        [[nodiscard]] virtual bool readVariable(dsInstanceId instanceId, dsVariableHandle variable, dsValueOut out_value) = 0;
+
+        // reads an input slot of a node, as the node itself would, for several instances of the assembly, writing the value for
+        // instanceIds[i] to out_values[i]; expressions over int32, float and bool values are evaluated across the instances at once
+        [[nodiscard]] virtual bool readInputSlot(dsAssembly* assembly, dsNodeIndex nodeIndex, dsInputSlot inputSlot,
+            dsInstanceId const* instanceIds, uint32_t count, dsValueOut const* out_values) = 0;
 
         virtual void processEvents() = 0;
+        virtual void setProcessMode(dsProcessMode mode) noexcept = 0;
 
-        virtual [[nodiscard]] dsEmitterId makeEmitterId() = 0;
+        [[nodiscard]] virtual dsEmitterId makeEmitterId() = 0;
         virtual void notifyChange(dsEmitterId emitterId) = 0;
 
+        // thread-safe and non-blocking; posted changes are applied at the start of the next
+        // processEvents(), with repeats of the same emitter collapsed. Returns false if the queue is full;
+        // the queue holds dsRuntimeHost::postedChangeCapacity() changes.
+        virtual bool postChange(dsEmitterId emitterId) noexcept = 0;
+
+        [[nodiscard]] virtual dsRuntimeStats stats() const noexcept = 0;
+
     protected:
         ~dsRuntime() = default;
     };
@@ -26,6 +26,7 @@ namespace descript {
     DS_DEFINE_KEY(dsInstanceId, uint64_t);
     DS_DEFINE_KEY(dsNodeIndex, uint32_t);
     DS_DEFINE_KEY(dsTypeId, uint32_t);
+    DS_DEFINE_KEY(dsVariableHandle, uint64_t);
 
     // invalid ids
     static constexpr dsEmitterId dsInvalidEmitterId{~uint64_t{0}};
@@ -33,6 +34,7 @@ namespace descript {
     static constexpr dsInstanceId dsInvalidInstanceId{~uint64_t{0}};
     static constexpr dsFunctionId dsInvalidFunctionId{~uint64_t{0}};
     static constexpr dsTypeId dsInvalidTypeId{~uint32_t{0}};
+    static constexpr dsVariableHandle dsInvalidVariableHandle{~uint64_t{0}};
 
     // special constants for plug indices
     static constexpr dsInputPlugIndex dsBeginPlugIndex{254};
@@ -70,6 +72,12 @@ namespace descript {
 
     using dsFunction = void (*)(dsFunctionContext& context, void* userData);
 
+    /// Calls a function with its arguments read in place from the evaluation stack, dsNativeArgStride
+    /// bytes apart, and writes the result over the first argument. See dsBindFunction.
+    using dsNativeFunction = void (*)(void* args, void* userData);
+
+    inline constexpr uint32_t dsNativeArgStride = 16;
+
     using dsNodeFunction = void (*)(dsNodeContext& context, dsEventType eventType, void* userData);
 
     struct dsParam final
@@ -230,6 +230,9 @@ namespace descript {
                     item->~StorageValue();
                 }
             }
+
+            // the items now live in the new memory, so deallocate must not destroy them again
+            sentinel_ = first_;
         }
 
         deallocate();
@@ -8,9 +8,11 @@
 #include "assembly_internal.hh"
 
 #include "bit.hh"
+#include "evaluate_internal.hh"
 #include "fnv.hh"
 #include "instance.hh"
 
+#include <cstdint>
 #include <new>
 
 namespace descript {
@@ -31,6 +33,9 @@ namespace descript {
 
         dsAssemblyHeader const& header = *std::launder(reinterpret_cast<dsAssemblyHeader const*>(bytes));
 
+        // reject assemblies built for another byte code or layout
+        DS_VALIDATE(header.version == dsAssemblyVersion);
+
         // ensure the block is big enough for the header's declared size
         DS_VALIDATE(size >= header.size);
 
@@ -110,8 +115,17 @@ namespace descript {
         }
 
         for (dsAssemblyExpression const& expression : header.expressions)
+        {
             DS_VALIDATE(isInRange(expression.codeStart.value(), expression.codeCount, header.byteCode.count));
 
+            // the declared depth sizes the stack of the unchecked interpreter, so it must cover the verified
+            // depth; every byte pushes at most one value, which bounds it by the length of the code
+            dsByteCodeSummary summary;
+            DS_VALIDATE(dsDecodeByteCode(header, nullptr, header.byteCode.data() + expression.codeStart.value(), expression.codeCount,
+                nullptr, summary));
+            DS_VALIDATE(summary.maxStack <= expression.maxStack && expression.maxStack <= expression.codeCount);
+        }
+
         return true;
     }
 
@@ -142,6 +156,66 @@ namespace descript {
     static void nullNode(dsNodeContext&, dsEventType, void*) {}
     static void missingFunction(dsFunctionContext& context, void* userData) {}
 
+    static std::atomic<uint32_t> nextHandleTag = 0;
+
+    namespace {
+        constexpr uint32_t minSlabBlocks = 8;
+        constexpr uint32_t maxSlabBlocks = 1024;
+        constexpr uint32_t slabHeaderSize = dsAlign(sizeof(dsAssemblyInstancePool::Slab), alignof(dsInstance));
+
+        // assemblies may be shared by runtimes on different threads, but the pool
+        // is only locked for a handful of instructions at a time
+        class PoolLock
+        {
+        public:
+            explicit PoolLock(dsAssemblyInstancePool& pool) noexcept : pool_(pool)
+            {
+                while (pool_.lock.test_and_set(std::memory_order_acquire))
+                    ;
+            }
+            ~PoolLock() { pool_.lock.clear(std::memory_order_release); }
+
+            PoolLock(PoolLock const&) = delete;
+            PoolLock& operator=(PoolLock const&) = delete;
+
+        private:
+            dsAssemblyInstancePool& pool_;
+        };
+    } // namespace
+
+    // the most blocks a single slab may hold, so that its size fits the allocator's 32-bit sizes
+    static uint32_t slabCapacity(dsAssemblyInstancePool const& pool) noexcept
+    {
+        uint32_t const fitting = (UINT32_MAX - slabHeaderSize) / pool.blockStride;
+        return fitting < maxSlabBlocks ? fitting : maxSlabBlocks;
+    }
+
+    // must be called with the pool lock held; leaves the pool unchanged if the allocator fails
+    static bool growInstancePool(dsAssembly& assembly, uint32_t blockCount)
+    {
+        dsAssemblyInstancePool& pool = assembly.instancePool;
+        DS_ASSERT(blockCount != 0 && blockCount <= slabCapacity(pool));
+
+        void* const memory = assembly.allocator.allocate(slabHeaderSize + blockCount * pool.blockStride, alignof(dsInstance));
+        if (memory == nullptr)
+            return false;
+
+        auto* const slab = new (memory) dsAssemblyInstancePool::Slab{.next = pool.slabs, .blockCount = blockCount};
+        pool.slabs = slab;
+        pool.blockCount += blockCount;
+        pool.freeCount += blockCount;
+
+        // link in reverse so that blocks are handed out in address order
+        uint8_t* const blocks = static_cast<uint8_t*>(memory) + slabHeaderSize;
+        for (uint32_t index = blockCount; index-- != 0;)
+        {
+            void* const block = blocks + index * pool.blockStride;
+            *static_cast<void**>(block) = pool.freeBlocks;
+            pool.freeBlocks = block;
+        }
+        return true;
+    }
+
     dsAssembly* dsLoadAssembly(dsAllocator& alloc, dsRuntimeHost& host, uint8_t const* bytes, uint32_t size)
     {
         if (!dsValidateAssembly(bytes, size))
@@ -149,6 +223,17 @@ namespace descript {
 
         dsAssemblyHeader const& header = *reinterpret_cast<dsAssemblyHeader const*>(bytes);
 
+        // size the decoded instruction stream; the byte code has already been verified
+        uint32_t instructionCount = 0;
+        for (dsAssemblyExpression const& expression : header.expressions)
+        {
+            dsByteCodeSummary summary;
+            if (!dsDecodeByteCode(header, nullptr, header.byteCode.data() + expression.codeStart.value(), expression.codeCount, nullptr,
+                    summary))
+                return nullptr;
+            instructionCount += summary.instructionCount;
+        }
+
         uint32_t assemblySize = sizeof(dsAssembly);
 
         uint32_t const headerOffset = dsAlign(assemblySize, alignof(dsAssemblyHeader));
@@ -163,15 +248,42 @@ namespace descript {
         uint32_t const functionImplOffset = dsAlign(assemblySize, alignof(dsAssemblyFunctionImpl));
         assemblySize = functionImplOffset + header.functions.count * sizeof(dsAssemblyFunctionImpl);
 
+        uint32_t const variableLookupOffset = dsAlign(assemblySize, alignof(dsAssemblyVariableLookup));
+        assemblySize = variableLookupOffset + header.variables.count * sizeof(dsAssemblyVariableLookup);
+
+        uint32_t const decodedExpressionsOffset = dsAlign(assemblySize, alignof(dsAssemblyDecodedExpression));
+        assemblySize = decodedExpressionsOffset + header.expressions.count * sizeof(dsAssemblyDecodedExpression);
+
+        uint32_t const instructionsOffset = dsAlign(assemblySize, alignof(dsAssemblyInstruction));
+        assemblySize = instructionsOffset + instructionCount * sizeof(dsAssemblyInstruction);
+
         static_assert(alignof(dsAssemblyHeader) <= alignof(dsAssembly));
         dsAssembly* const assembly = new (alloc.allocate(assemblySize, alignof(dsAssembly))) dsAssembly(alloc, assemblySize);
 
         std::memcpy(reinterpret_cast<uint8_t*>(assembly) + headerOffset, bytes, header.size);
 
+        assembly->handleTag = nextHandleTag++;
+
         assembly->header.assign(reinterpret_cast<uintptr_t>(assembly), headerOffset);
         assembly->nodes.assign(reinterpret_cast<uintptr_t>(assembly), nodeImplOffset, header.nodes.count);
         assembly->constants.assign(reinterpret_cast<uintptr_t>(assembly), constantsOffset, header.constants.count);
         assembly->functions.assign(reinterpret_cast<uintptr_t>(assembly), functionImplOffset, header.functions.count);
+        assembly->variableLookup.assign(reinterpret_cast<uintptr_t>(assembly), variableLookupOffset, header.variables.count);
+        assembly->decodedExpressions.assign(reinterpret_cast<uintptr_t>(assembly), decodedExpressionsOffset, header.expressions.count);
+        assembly->instructions.assign(reinterpret_cast<uintptr_t>(assembly), instructionsOffset, instructionCount);
+
+        // the graph compiler sorts variables by type, so that each built-in type is packed into an array of
+        // its own; a variable out of that order, or of any other type, is held in storage
+        dsVariableLayout& layout = assembly->variableLayout;
+        layout.count = header.variables.count;
+        auto const packedRun = [&header](uint32_t start, dsTypeId typeId) {
+            while (start != header.variables.count && header.variables[dsAssemblyVariableIndex{start}].typeId == typeId.value())
+                ++start;
+            return start;
+        };
+        layout.float32Start = packedRun(0, dsType<int32_t>.typeId);
+        layout.boolStart = packedRun(layout.float32Start, dsType<float>.typeId);
+        layout.valueStart = packedRun(layout.boolStart, dsType<bool>.typeId);
 
         // calculate size and offets for instance data
         assembly->instanceSize = sizeof(dsInstance);
@@ -181,7 +293,28 @@ namespace descript {
             decltype(dsInstance::activeInputPlugs)::allocate(assembly->instanceSize, header.inputPlugCount);
         assembly->instanceOutputPlugsOffset =
             decltype(dsInstance::activeOutputPlugs)::allocate(assembly->instanceSize, header.outputPlugs.count);
-        assembly->instanceValuesOffset = decltype(dsInstance::values)::allocate(assembly->instanceSize, header.variables.count);
+        assembly->instanceDependenciesOffset =
+            decltype(dsInstance::pendingDependencies)::allocate(assembly->instanceSize, header.nodes.count);
+        assembly->instanceInt32sOffset = decltype(dsInstance::int32Values)::allocate(assembly->instanceSize, layout.int32Count());
+        assembly->instanceFloat32sOffset = decltype(dsInstance::float32Values)::allocate(assembly->instanceSize, layout.float32Count());
+        assembly->instanceBoolBitsOffset = decltype(dsInstance::boolValues)::allocate(assembly->instanceSize, layout.boolCount());
+        assembly->instanceValuesOffset = decltype(dsInstance::values)::allocate(assembly->instanceSize, layout.valueCount());
+        assembly->instanceListenersOffset =
+            decltype(dsInstance::listeners)::allocate(assembly->instanceSize, header.inputSlots.count);
+        assembly->instanceCachedResultsOffset =
+            decltype(dsInstance::cachedResults)::allocate(assembly->instanceSize, header.expressions.count);
+        assembly->instanceResultsOffset = decltype(dsInstance::results)::allocate(assembly->instanceSize, header.expressions.count);
+
+        // build the variable lookup table; graphs have few variables, so an insertion sort is fine
+        for (dsAssemblyVariableIndex variableIndex{0}; variableIndex != header.variables.count; ++variableIndex)
+        {
+            dsAssemblyVariableLookup const entry{.nameHash = header.variables[variableIndex].nameHash, .variableIndex = variableIndex};
+
+            uint32_t index = variableIndex.value();
+            for (; index != 0 && assembly->variableLookup[index - 1].nameHash > entry.nameHash; --index)
+                assembly->variableLookup[index] = assembly->variableLookup[index - 1];
+            assembly->variableLookup[index] = entry;
+        }
 
         // deserialize constants
         for (dsAssemblyConstantIndex constantIndex{0}; constantIndex != header.constants.count; ++constantIndex)
@@ -200,11 +333,35 @@ namespace descript {
         {
             dsFunctionRuntimeMeta meta;
             if (host.lookupFunction(header.functions[functionIndex], meta) && meta.function != nullptr)
-                assembly->functions[functionIndex] = {.function = meta.function, .userData = meta.userData};
+            {
+                // a native adapter is useless without the type of the value it leaves on the stack
+                bool const native = meta.native != nullptr && meta.nativeResult != nullptr;
+                assembly->functions[functionIndex] = {.function = meta.function,
+                    .userData = meta.userData,
+                    .native = native ? meta.native : nullptr,
+                    .nativeResult = native ? meta.nativeResult : nullptr};
+            }
             else
                 assembly->functions[functionIndex] = {.function = missingFunction};
         }
 
+        // decode byte code now that constants and functions have been resolved
+        uint32_t instructionStart = 0;
+        for (dsAssemblyExpressionIndex expressionIndex{0}; expressionIndex != header.expressions.count; ++expressionIndex)
+        {
+            dsAssemblyExpression const& expression = header.expressions[expressionIndex];
+
+            dsByteCodeSummary summary;
+            [[maybe_unused]] bool const decoded = dsDecodeByteCode(header, assembly,
+                header.byteCode.data() + expression.codeStart.value(), expression.codeCount,
+                assembly->instructions.data() + instructionStart, summary);
+            DS_ASSERT(decoded);
+
+            new (&assembly->decodedExpressions[expressionIndex]) dsAssemblyDecodedExpression{
+                .instructionStart = instructionStart, .instructionCount = summary.instructionCount, .maxStack = expression.maxStack};
+            instructionStart += summary.instructionCount;
+        }
+
         // fill node implementations and node userData offsets
         for (dsAssemblyNodeIndex nodeIndex{0}; nodeIndex != header.nodes.count; ++nodeIndex)
         {
@@ -224,6 +381,42 @@ namespace descript {
             }
         }
 
+        assembly->instancePool.blockStride = dsAlign(assembly->instanceSize, alignof(dsInstance));
+
+        // build the prototype instance, so that creating an instance only needs to copy it
+        void* const image = alloc.allocate(assembly->instanceSize, alignof(dsInstance));
+        std::memset(image, 0, assembly->instanceSize);
+
+        dsInstance& prototype = *new (image) dsInstance(alloc, dsInvalidInstanceId);
+        prototype.assembly = assembly;
+
+        prototype.activeNodes.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceStatesOffset, header.nodes.count);
+        prototype.activeInputPlugs.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceInputPlugsOffset, header.inputPlugCount);
+        prototype.activeOutputPlugs.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceOutputPlugsOffset,
+            header.outputPlugs.count);
+        prototype.pendingDependencies.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceDependenciesOffset,
+            header.nodes.count);
+        prototype.int32Values.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceInt32sOffset, layout.int32Count());
+        prototype.float32Values.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceFloat32sOffset, layout.float32Count());
+        prototype.boolValues.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceBoolBitsOffset, layout.boolCount());
+        prototype.values.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceValuesOffset, layout.valueCount());
+        prototype.listeners.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceListenersOffset, header.inputSlots.count);
+        prototype.cachedResults.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceCachedResultsOffset,
+            header.expressions.count);
+        prototype.results.assign(reinterpret_cast<uintptr_t>(image), assembly->instanceResultsOffset, header.expressions.count);
+
+        // reset the variables held in storage, since the memset will leave them in an invalid state; the
+        // packed variables start out as zero, or false
+        for (dsValueStorage& value : prototype.values)
+            value = {};
+        for (dsValueStorage& result : prototype.results)
+            result = {};
+
+        for (uint32_t& listenerIndex : prototype.listeners)
+            listenerIndex = dsInvalidListenerIndex;
+
+        assembly->instanceImage = image;
+
         return assembly;
     }
 
@@ -242,9 +435,98 @@ namespace descript {
             dsAllocator* const alloc = &assembly->allocator;
             uint32_t const size = assembly->assemblySize;
 
+            // every instance holds a reference, so all blocks have been returned by now
+            dsAssemblyInstancePool& pool = assembly->instancePool;
+            DS_ASSERT(pool.freeCount == pool.blockCount);
+            while (pool.slabs != nullptr)
+            {
+                dsAssemblyInstancePool::Slab* const slab = pool.slabs;
+                pool.slabs = slab->next;
+                alloc->free(slab, slabHeaderSize + slab->blockCount * pool.blockStride, alignof(dsInstance));
+            }
+
+#if DS_JIT
+            for (dsAssemblyDecodedExpression& expression : assembly->decodedExpressions)
+                dsJitRelease(expression.jit);
+#endif
+
+            static_cast<dsInstance*>(assembly->instanceImage)->~dsInstance();
+            alloc->free(assembly->instanceImage, assembly->instanceSize, alignof(dsInstance));
+
             assembly->~dsAssembly();
 
             alloc->free(assembly, size, alignof(dsAssembly));
         }
     }
+
+    dsAssemblyVariableIndex dsFindAssemblyVariable(dsAssembly const& assembly, uint64_t nameHash) noexcept
+    {
+        uint32_t first = 0;
+        uint32_t last = assembly.variableLookup.count;
+        while (first != last)
+        {
+            uint32_t const middle = first + (last - first) / 2;
+            dsAssemblyVariableLookup const& entry = assembly.variableLookup[middle];
+            if (entry.nameHash == nameHash)
+                return entry.variableIndex;
+            if (entry.nameHash < nameHash)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return dsInvalidIndex;
+    }
+
+    void dsReserveInstances(dsAssembly* assembly, uint32_t count)
+    {
+        DS_GUARD_VOID(assembly != nullptr);
+
+        dsAssemblyInstancePool& pool = assembly->instancePool;
+        PoolLock lock(pool);
+
+        // a large reservation is split into several slabs rather than one whose size would overflow
+        uint32_t const capacity = slabCapacity(pool);
+        while (pool.freeCount < count)
+        {
+            uint32_t const missing = count - pool.freeCount;
+            if (!growInstancePool(*assembly, missing < capacity ? missing : capacity))
+                return;
+        }
+    }
+
+    void* dsAllocateInstanceMemory(dsAssembly& assembly)
+    {
+        dsAssemblyInstancePool& pool = assembly.instancePool;
+        PoolLock lock(pool);
+
+        // grow geometrically, so the number of slabs stays logarithmic in the peak population
+        if (pool.freeBlocks == nullptr)
+        {
+            uint32_t const capacity = slabCapacity(pool);
+            uint32_t blockCount = pool.blockCount;
+            if (blockCount < minSlabBlocks)
+                blockCount = minSlabBlocks;
+            if (blockCount > capacity)
+                blockCount = capacity;
+            if (blockCount == 0 || !growInstancePool(assembly, blockCount))
+                return nullptr;
+        }
+
+        void* const block = pool.freeBlocks;
+        pool.freeBlocks = *static_cast<void**>(block);
+        --pool.freeCount;
+        return block;
+    }
+
+    void dsFreeInstanceMemory(dsAssembly& assembly, void* memory) noexcept
+    {
+        DS_ASSERT(memory != nullptr);
+
+        dsAssemblyInstancePool& pool = assembly.instancePool;
+        PoolLock lock(pool);
+
+        *static_cast<void**>(memory) = pool.freeBlocks;
+        pool.freeBlocks = memory;
+        ++pool.freeCount;
+    }
 } // namespace descript
@@ -6,6 +6,8 @@
 #include "descript/types.hh"
 
 #include "index.hh"
+#include "jit.hh"
+#include "ops.hh"
 #include "rel.hh"
 #include "storage.hh"
 
@@ -69,6 +71,13 @@ namespace descript {
         uint64_t nameHash = 0;
         dsAssemblyDependencyIndex dependencyStart;
         uint32_t dependencyCount = 0;
+        uint32_t typeId = 0; // as declared to the graph compiler
+    };
+
+    struct dsAssemblyVariableLookup
+    {
+        uint64_t nameHash = 0;
+        dsAssemblyVariableIndex variableIndex;
     };
 
     struct dsAssemblyDependency
@@ -81,6 +90,8 @@ namespace descript {
     {
         dsAssemblyByteCodeIndex codeStart;
         uint32_t codeCount = 0;
+        uint32_t maxStack = 0;   // deepest the value stack grows while evaluating the expression
+        bool isVolatile = false; // calls a volatile function, so its result is never cached
     };
 
     struct dsAssemblyConstant
@@ -89,9 +100,12 @@ namespace descript {
         uint64_t serialized = 0;
     };
 
+    // bumped whenever the byte code or the layout of any assembly structure changes
+    inline constexpr uint32_t dsAssemblyVersion = 1;
+
     struct dsAssemblyHeader
     {
-        uint32_t version = 0;
+        uint32_t version = dsAssemblyVersion;
         uint32_t size = 0; // number of bytes, including header, payload, and all padding
         uint64_t hash = 0; // hash of header and all payload bytes, assuming padding and hash field are all 0
 
@@ -121,6 +135,53 @@ namespace descript {
         dsFunctionId functionId = dsInvalidFunctionId;
         dsFunction function = nullptr;
         void* userData = nullptr;
+        dsNativeFunction native = nullptr;
+        dsTypeMeta const* nativeResult = nullptr;
+    };
+
+    /// Fixed-width form of a single byte code operation, with its operands decoded and
+    /// resolved against the loaded assembly.
+    struct dsAssemblyInstruction
+    {
+        dsOpCode op = dsOpCode::Nop;
+        uint8_t argc = 0; // Call only
+        union {
+            int32_t immediate = 0;                  // integer pushes, and the right operand of *ImmI32
+            uint32_t variableIndex;                 // Read, and the right operand of *Read*
+            uint32_t variableIndices[2];            // ReadRead
+            dsValueStorage const* constant;         // PushConstant
+            dsAssemblyFunctionImpl const* function; // Call
+            uint32_t target;                        // jumps, as the index of the instruction they continue at
+        };
+    };
+
+    struct dsAssemblyDecodedExpression
+    {
+        uint32_t instructionStart = 0;
+        uint32_t instructionCount = 0;
+        uint32_t maxStack = 0;
+#if DS_JIT
+        mutable dsJitExpression jit; // promoted while evaluating, so it changes even in a shared assembly
+#endif
+    };
+
+    /// Recycles instance-sized blocks for an assembly, so that spawning does not go
+    /// through the general allocator. Blocks are carved from slabs which are only
+    /// freed along with the assembly.
+    struct dsAssemblyInstancePool
+    {
+        struct Slab
+        {
+            Slab* next = nullptr;
+            uint32_t blockCount = 0;
+        };
+
+        Slab* slabs = nullptr;
+        void* freeBlocks = nullptr;
+        uint32_t blockStride = 0;
+        uint32_t blockCount = 0;
+        uint32_t freeCount = 0;
+        std::atomic_flag lock;
     };
 
     struct dsAssembly
@@ -132,16 +193,55 @@ namespace descript {
         dsRelativeArray<dsAssemblyNodeImpl, dsAssemblyNodeIndex> nodes;
         dsRelativeArray<dsValueStorage, dsAssemblyConstantIndex> constants;
         dsRelativeArray<dsAssemblyFunctionImpl, dsAssemblyFunctionIndex> functions;
+        dsRelativeArray<dsAssemblyVariableLookup> variableLookup; // sorted by name hash
+        dsRelativeArray<dsAssemblyDecodedExpression, dsAssemblyExpressionIndex> decodedExpressions;
+        dsRelativeArray<dsAssemblyInstruction> instructions;      // byte code of every expression, decoded at load
+        void* instanceImage = nullptr;                            // prototype copied into each new instance
+        uint32_t handleTag = 0;                                   // distinguishes variable handles of different assemblies
+        dsVariableLayout variableLayout;                          // ranges of the variables packed by type in each instance
         uint32_t assemblySize = 0;
         uint32_t instanceSize = 0;
         uint32_t instanceStatesOffset = 0;
         uint32_t instanceInputPlugsOffset = 0;
         uint32_t instanceOutputPlugsOffset = 0;
+        uint32_t instanceDependenciesOffset = 0;
+        uint32_t instanceInt32sOffset = 0;
+        uint32_t instanceFloat32sOffset = 0;
+        uint32_t instanceBoolBitsOffset = 0;
         uint32_t instanceValuesOffset = 0;
+        uint32_t instanceListenersOffset = 0;
+        uint32_t instanceCachedResultsOffset = 0;
+        uint32_t instanceResultsOffset = 0;
         uint32_t instanceFunctionsOffset = 0;
+        dsAssemblyInstancePool instancePool;
         dsAllocator& allocator;
     };
 
+    /// Finds the variable with the given name hash, or returns dsInvalidIndex.
+    [[nodiscard]] dsAssemblyVariableIndex dsFindAssemblyVariable(dsAssembly const& assembly, uint64_t nameHash) noexcept;
+
+    /// Variable handles pack the assembly's tag above the variable index.
+    constexpr dsVariableHandle dsMakeVariableHandle(dsAssembly const& assembly, dsAssemblyVariableIndex variableIndex) noexcept
+    {
+        return dsVariableHandle{(uint64_t{assembly.handleTag} << 32) | variableIndex.value()};
+    }
+
+    /// Unpacks a variable handle, or returns dsInvalidIndex if it belongs to another assembly.
+    constexpr dsAssemblyVariableIndex dsResolveVariableHandle(dsAssembly const& assembly, dsVariableHandle handle) noexcept
+    {
+        uint32_t const index = static_cast<uint32_t>(handle.value());
+        if (static_cast<uint32_t>(handle.value() >> 32) != assembly.handleTag || index >= assembly.variableLookup.count)
+            return dsInvalidIndex;
+        return dsAssemblyVariableIndex{index};
+    }
+
+    /// Allocates uninitialized memory for an instance from the assembly's pool. Returns nullptr if
+    /// the pool must grow and the allocator fails.
+    [[nodiscard]] void* dsAllocateInstanceMemory(dsAssembly& assembly);
+
+    /// Returns memory acquired from dsAllocateInstanceMemory to the assembly's pool.
+    void dsFreeInstanceMemory(dsAssembly& assembly, void* memory) noexcept;
+
     /// Validates that the provided range of bytes describes a valid assembly.
     bool dsValidateAssembly(uint8_t const* bytes, uint32_t size) noexcept;
 
@@ -6,325 +6,1377 @@
 #include "descript/value.hh"
 
 #include "array.hh"
-#include "assembly_internal.hh"
+#include "evaluate_internal.hh"
+#include "evaluate_t.hh"
 #include "ops.hh"
 #include "utility.hh"
 
+#include <cstring>
+#include <type_traits>
 #include <utility>
 
 namespace descript {
     namespace {
-        static constexpr uint32_t s_stackSize = 32;
+        using namespace detail_;
 
-        class Context final : public dsFunctionContext
+        static constexpr uint32_t s_laneCount = 8;
+
+        // a stack entry for a group of lanes; every lane of an entry has the same type, so the values sit
+        // side by side and a typed operation is a fixed-length loop which the compiler vectorizes
+        struct LaneCell
         {
-        public:
-            Context(dsEvaluateHost& host, uint32_t argc, dsValueStorage const* argv, dsValueStorage& result) noexcept
-                : host_(host), argc_(argc), argv_(argv), result_(result)
-            {
-            }
+            alignas(32) char storage[s_laneCount * sizeof(uint32_t)];
 
-            uint32_t getArgCount() const noexcept { return argc_; }
-            dsValueRef getArgValueAt(uint32_t index) const noexcept
-            {
-                DS_ASSERT(index < argc_);
-                return argv_[index].ref();
-            }
+            template <typename T>
+            requires dsIsValue<T>
+            T* as() noexcept { return static_cast<T*>(static_cast<void*>(storage)); }
 
-            void result(dsValueRef const& result) override { result_ = dsValueStorage{result}; }
+            template <typename T>
+            requires dsIsValue<T>
+            T const* as() const noexcept { return static_cast<T const*>(static_cast<void const*>(storage)); }
+        };
+    } // namespace
 
-            void listen(dsEmitterId emitterId) override { host_.listen(emitterId); }
+// verified code cannot overflow or underflow the stack, so these variants check nothing
+#define DS_PUSH_UNCHECKED(type, val)          \
+    {                                         \
+        tags[stackTop] = cellTag<type>;       \
+        stack[stackTop++].as<type>() = (val); \
+    }
 
-        private:
-            dsEvaluateHost& host_;
-            uint32_t argc_ = 0;
-            dsValueStorage const* argv_ = nullptr;
-            dsValueStorage& result_;
-        };
+#define DS_UNOP_UNCHECKED(op, type)                   \
+    {                                                 \
+        type& value = stack[stackTop - 1].as<type>(); \
+        value = op::apply(value);                     \
+    }
 
-        template <typename T>
-        constexpr bool IsArithmetic =
-            std::conjunction_v<std::is_arithmetic<T>, std::negation<std::is_same<T, bool>>>;
+#define DS_BINOP_UNCHECKED(op, type)                     \
+    {                                                    \
+        type const right = stack[--stackTop].as<type>(); \
+        type& left = stack[stackTop - 1].as<type>();     \
+        left = op::apply(left, right);                   \
+    }
 
-        static_assert(IsArithmetic<int>);
-        static_assert(IsArithmetic<float>);
-        static_assert(!IsArithmetic<bool>);
-        static_assert(!IsArithmetic<char*>);
-        static_assert(!IsArithmetic<dsPlugKind>);
+#define DS_CMPOP_UNCHECKED(op, type)                                          \
+    {                                                                         \
+        type const right = stack[--stackTop].as<type>();                      \
+        bool const result = op::apply(stack[stackTop - 1].as<type>(), right); \
+        stack[stackTop - 1].as<bool>() = result;                              \
+        tags[stackTop - 1] = CellTag::Bool;                                   \
+    }
 
-        struct Neg
-        {
-            template <typename T>
-            requires IsArithmetic<T>
-            static constexpr T apply(T val) noexcept { return -val; }
-        };
+// the right operand is a variable; one of another type is copied through the scratch slot above the
+// left operand, so that the result is exactly that of the Read and operator the op-code fuses
+#define DS_TERNOP_UNCHECKED(op, type)                      \
+    {                                                      \
+        stackTop -= 2;                                     \
+        type const second = stack[stackTop].as<type>();    \
+        type const third = stack[stackTop + 1].as<type>(); \
+        type& first = stack[stackTop - 1].as<type>();      \
+        first = op::apply(first, second, third);           \
+    }
+
+#define DS_BINOP_READ_UNCHECKED(op, type)                                         \
+    {                                                                             \
+        type& left = stack[stackTop - 1].as<type>();                              \
+        if (type const* const right = readAs<type>(variables, ip->variableIndex)) \
+            left = op::apply(left, *right);                                       \
+        else if (pushVariable(ip->variableIndex))                                 \
+            left = op::apply(left, stack[--stackTop].as<type>());                 \
+        else                                                                      \
+            return false;                                                         \
+    }
 
-        struct Not
+#define DS_BINOP_IMM_UNCHECKED(op)                         \
+    {                                                      \
+        int32_t& left = stack[stackTop - 1].as<int32_t>(); \
+        left = op::apply(left, ip->immediate);             \
+    }
+
+    dsEvaluateScratch::dsEvaluateScratch(dsEvaluateScratch&& rhs) noexcept
+        : allocator_(rhs.allocator_), memory_(rhs.memory_), size_(rhs.size_), align_(rhs.align_), acquired_(rhs.acquired_)
+    {
+        rhs.memory_ = nullptr;
+        rhs.size_ = 0;
+        rhs.acquired_ = false;
+    }
+
+    dsEvaluateScratch::~dsEvaluateScratch()
+    {
+        DS_ASSERT(!acquired_);
+
+        if (memory_ != nullptr)
+            allocator_->free(memory_, size_, align_);
+    }
+
+    void* dsEvaluateScratch::acquire(uint32_t size, uint32_t align) noexcept
+    {
+        if (acquired_)
+            return nullptr;
+
+        if (size > size_ || align > align_)
         {
-            static constexpr bool apply(bool val) noexcept { return !val; }
-        };
+            void* const memory = allocator_->allocate(size, align);
+            if (memory == nullptr)
+                return nullptr;
+
+            if (memory_ != nullptr)
+                allocator_->free(memory_, size_, align_);
+            memory_ = memory;
+            size_ = size;
+            align_ = align;
+        }
+
+        acquired_ = true;
+        return memory_;
+    }
 
-        struct And
+    void dsEvaluateScratch::release() noexcept
+    {
+        DS_ASSERT(acquired_);
+        acquired_ = false;
+    }
+
+    bool dsEvaluate(dsEvaluateHost& host, uint8_t const* ops, uint32_t opsLen, dsValueOut out_value)
+    {
+        return dsEvaluateT(host, ops, opsLen, out_value);
+    }
+
+    // the type a typed read op-code is emitted for
+    static dsTypeId typedReadType(dsOpCode op) noexcept
+    {
+        switch (op)
         {
-            static constexpr bool apply(bool left, bool right) noexcept { return left && right; }
-        };
+        case dsOpCode::ReadI32: return dsType<int32_t>.typeId;
+        case dsOpCode::ReadF32: return dsType<float>.typeId;
+        case dsOpCode::ReadB: return dsType<bool>.typeId;
+        default: return dsInvalidTypeId;
+        }
+    }
 
-        struct Or
+    static bool packsTypedRead(dsVariableLayout const& layout, dsOpCode op, uint32_t variableIndex) noexcept
+    {
+        switch (op)
         {
-            static constexpr bool apply(bool left, bool right) noexcept { return left || right; }
+        case dsOpCode::ReadI32: return layout.packs<int32_t>(variableIndex);
+        case dsOpCode::ReadF32: return layout.packs<float>(variableIndex);
+        case dsOpCode::ReadB: return layout.packs<bool>(variableIndex);
+        default: return false;
+        }
+    }
+
+    bool dsDecodeByteCode(dsAssemblyHeader const& header, dsAssembly const* assembly, uint8_t const* ops, uint32_t opsLen,
+        dsAssemblyInstruction* out_instructions, dsByteCodeSummary& out_summary) noexcept
+    {
+        DS_GUARD_OR(ops != nullptr || opsLen == 0, false);
+        DS_GUARD_OR(assembly != nullptr || out_instructions == nullptr, false);
+
+        uint8_t const* ip = ops;
+        uint8_t const* const opsEnd = ops + opsLen;
+
+        // reads a big-endian operand of the given width
+        auto const readOperand = [&ip, opsEnd](uint32_t width, uint32_t& out_value) noexcept {
+            if (static_cast<uint32_t>(opsEnd - ip) < width)
+                return false;
+            out_value = 0;
+            for (; width != 0; --width)
+                out_value = (out_value << 8) | *ip++;
+            return true;
         };
 
-        struct Xor
+        // jumps only go forward, so each is resolved once the scan reaches its target, where the stack must
+        // have the same depth along every path; the number of jumps awaiting their target is bounded
+        struct PendingJump
         {
-            static constexpr bool apply(bool left, bool right) noexcept { return left ^ right; }
+            uint32_t target = 0;
+            uint32_t depth = 0;
+            uint32_t instruction = 0;
         };
+        constexpr uint32_t maxPendingJumps = 32;
+        PendingJump pending[maxPendingJumps];
+        uint32_t pendingCount = 0;
+        bool reachable = true;
 
-        struct Add
+        uint32_t count = 0;
+        uint32_t depth = 0;
+        uint32_t maxDepth = 0;
+        for (;;)
         {
-            template <typename T>
-            requires IsArithmetic<T>
-            static constexpr T apply(T left, T right) noexcept { return left + right; }
-        };
+            uint32_t const offset = static_cast<uint32_t>(ip - ops);
+            for (uint32_t index = 0; index != pendingCount;)
+            {
+                PendingJump const jump = pending[index];
+                if (jump.target != offset)
+                {
+                    ++index;
+                    continue;
+                }
+
+                if (!reachable)
+                    depth = jump.depth;
+                else if (depth != jump.depth)
+                    return false;
+                reachable = true;
+
+                if (out_instructions != nullptr)
+                    out_instructions[jump.instruction].target = count;
+                pending[index] = pending[--pendingCount];
+            }
+
+            if (ip == opsEnd)
+                break;
+
+            // the code following an unconditional jump must be the target of another
+            if (!reachable)
+                return false;
+
+            dsAssemblyInstruction instruction{};
+            instruction.op = dsOpCode(*ip++);
+            uint32_t operand = 0;
+
+            // values consumed from and produced onto the stack, and any slot used above the operands; a
+            // superinstruction needs the same stack as the sequence it fuses
+            uint32_t pops = 0;
+            uint32_t pushes = 1;
+            uint32_t scratch = 0;
+
+            switch (instruction.op)
+            {
+            case dsOpCode::Nop: pushes = 0; break;
+            case dsOpCode::PushTrue:
+            case dsOpCode::PushFalse:
+            case dsOpCode::PushNil: break;
+            case dsOpCode::Push0: instruction.immediate = 0; break;
+            case dsOpCode::Push1: instruction.immediate = 1; break;
+            case dsOpCode::Push2: instruction.immediate = 2; break;
+            case dsOpCode::PushNeg1: instruction.immediate = -1; break;
+            case dsOpCode::PushS8:
+                if (!readOperand(1, operand))
+                    return false;
+                instruction.immediate = static_cast<int8_t>(operand);
+                break;
+            case dsOpCode::PushU8:
+                if (!readOperand(1, operand))
+                    return false;
+                instruction.immediate = static_cast<int32_t>(operand);
+                break;
+            case dsOpCode::PushS16:
+                if (!readOperand(2, operand))
+                    return false;
+                instruction.immediate = static_cast<int16_t>(operand);
+                break;
+            case dsOpCode::PushU16:
+                if (!readOperand(2, operand))
+                    return false;
+                instruction.immediate = static_cast<int32_t>(operand);
+                break;
+            case dsOpCode::PushConstant:
+                if (!readOperand(2, operand) || operand >= header.constants.count)
+                    return false;
+                if (assembly != nullptr)
+                    instruction.constant = &assembly->constants[dsAssemblyConstantIndex{operand}];
+                break;
+            case dsOpCode::Read:
+                if (!readOperand(2, operand) || operand >= header.variables.count)
+                    return false;
+                instruction.variableIndex = operand;
+                break;
+            case dsOpCode::ReadI32:
+            case dsOpCode::ReadF32:
+            case dsOpCode::ReadB:
+                if (!readOperand(2, operand) || operand >= header.variables.count)
+                    return false;
+                if (header.variables[dsAssemblyVariableIndex{operand}].typeId != typedReadType(instruction.op).value())
+                    return false;
+                instruction.variableIndex = operand;
+
+                // a variable the loader could not pack is read as any other
+                if (assembly != nullptr && !packsTypedRead(assembly->variableLayout, instruction.op, operand))
+                    instruction.op = dsOpCode::Read;
+                break;
+            case dsOpCode::Call:
+                if (!readOperand(2, operand) || operand >= header.functions.count)
+                    return false;
+                if (assembly != nullptr)
+                    instruction.function = &assembly->functions[dsAssemblyFunctionIndex{operand}];
+                if (!readOperand(1, operand))
+                    return false;
+                instruction.argc = static_cast<uint8_t>(operand);
+                pops = operand;
+                break;
+            case dsOpCode::NegI32:
+            case dsOpCode::NegF32:
+            case dsOpCode::NotB:
+            case dsOpCode::AbsI32:
+            case dsOpCode::AbsF32:
+            case dsOpCode::FloorF32:
+            case dsOpCode::SqrtF32: pops = 1; break;
+            case dsOpCode::AddI32:
+            case dsOpCode::AddF32:
+            case dsOpCode::SubI32:
+            case dsOpCode::SubF32:
+            case dsOpCode::MulI32:
+            case dsOpCode::MulF32:
+            case dsOpCode::DivI32:
+            case dsOpCode::DivF32:
+            case dsOpCode::AndB:
+            case dsOpCode::OrB:
+            case dsOpCode::XorB:
+            case dsOpCode::MinI32:
+            case dsOpCode::MinF32:
+            case dsOpCode::MaxI32:
+            case dsOpCode::MaxF32: pops = 2; break;
+            case dsOpCode::EqI32:
+            case dsOpCode::EqF32:
+            case dsOpCode::EqB:
+            case dsOpCode::NeI32:
+            case dsOpCode::NeF32:
+            case dsOpCode::NeB:
+            case dsOpCode::LtI32:
+            case dsOpCode::LtF32:
+            case dsOpCode::LeI32:
+            case dsOpCode::LeF32:
+            case dsOpCode::GtI32:
+            case dsOpCode::GtF32:
+            case dsOpCode::GeI32:
+            case dsOpCode::GeF32: pops = 2; break;
+            case dsOpCode::ClampI32:
+            case dsOpCode::ClampF32:
+            case dsOpCode::LerpF32:
+            case dsOpCode::Select: pops = 3; break;
+            case dsOpCode::Jump:
+            case dsOpCode::JumpIfFalse:
+            case dsOpCode::JumpIfFalseOrPop:
+            case dsOpCode::JumpIfTrueOrPop: {
+                if (!readOperand(2, operand) || pendingCount == maxPendingJumps)
+                    return false;
+
+                // the conditional jumps consume their condition if they fall through, and JumpIfFalse also if it is taken
+                pops = instruction.op == dsOpCode::Jump ? 0 : 1;
+                pushes = 0;
+                if (pops > depth)
+                    return false;
+                uint32_t const takenDepth = instruction.op == dsOpCode::JumpIfFalse ? depth - 1 : depth;
+
+                pending[pendingCount++] = {.target = static_cast<uint32_t>(ip - ops) + operand, .depth = takenDepth, .instruction = count};
+                reachable = instruction.op != dsOpCode::Jump;
+                break;
+            }
+            case dsOpCode::ReadRead:
+                for (uint32_t& variableIndex : instruction.variableIndices)
+                {
+                    if (!readOperand(2, operand) || operand >= header.variables.count)
+                        return false;
+                    variableIndex = operand;
+                }
+                pushes = 2;
+                break;
+            case dsOpCode::AddReadI32:
+            case dsOpCode::AddReadF32:
+            case dsOpCode::SubReadI32:
+            case dsOpCode::SubReadF32:
+            case dsOpCode::MulReadI32:
+            case dsOpCode::MulReadF32:
+                if (!readOperand(2, operand) || operand >= header.variables.count)
+                    return false;
+                instruction.variableIndex = operand;
+                pops = 1;
+                scratch = 1;
+                break;
+            case dsOpCode::AddImmI32:
+            case dsOpCode::SubImmI32:
+            case dsOpCode::MulImmI32:
+                if (!readOperand(2, operand))
+                    return false;
+                instruction.immediate = static_cast<int16_t>(operand);
+                pops = 1;
+                scratch = 1;
+                break;
+            default: return false;
+            }
+
+            if (pops > depth)
+                return false;
+            if (depth + scratch > maxDepth)
+                maxDepth = depth + scratch;
+            depth = depth - pops + pushes;
+            if (depth > maxDepth)
+                maxDepth = depth;
+
+            if (out_instructions != nullptr)
+                out_instructions[count] = instruction;
+            ++count;
+        }
 
-        struct Sub
+        // a jump whose target lies past the end or within another instruction is never resolved
+        if (pendingCount != 0 || depth != 1)
+            return false;
+
+        out_summary = {.instructionCount = count, .maxStack = maxDepth};
+        return true;
+    }
+
+    bool dsCountOpCodes(uint8_t const* ops, uint32_t opsLen, dsOpHistogram& histogram) noexcept
+    {
+        DS_GUARD_OR(ops != nullptr || opsLen == 0, false);
+
+        uint8_t const* ip = ops;
+        uint8_t const* const opsEnd = ops + opsLen;
+
+        dsOpCode previous = dsOpCode::Last;
+        while (ip != opsEnd)
         {
-            template <typename T>
-            requires IsArithmetic<T>
-            static constexpr T apply(T left, T right) noexcept { return left - right; }
+            dsOpCode const op = dsOpCode(*ip++);
+            if (op >= dsOpCode::Last)
+                return false;
+
+            uint32_t const operandBytes = dsOpOperandBytes(op);
+            if (static_cast<uint32_t>(opsEnd - ip) < operandBytes)
+                return false;
+            ip += operandBytes;
+
+            ++histogram.ops[static_cast<uint8_t>(op)];
+            if (previous != dsOpCode::Last)
+                ++histogram.pairs[static_cast<uint8_t>(previous)][static_cast<uint8_t>(op)];
+            previous = op;
+        }
+        return true;
+    }
+
+    // copies a variable onto the stack
+    static bool readVariable(
+        Cell& cell, CellTag& tag, dsTypeMeta const*& boxed, dsValueStorage const* variables, uint32_t variableIndex) noexcept
+    {
+        CellOut out{.cell = cell, .tag = tag, .boxed = boxed};
+        return out.accept(variables[variableIndex].ref());
+    }
+
+    static bool readVariable(
+        Cell& cell, CellTag& tag, dsTypeMeta const*& boxed, dsPackedVariables const* variables, uint32_t variableIndex) noexcept
+    {
+        CellOut out{.cell = cell, .tag = tag, .boxed = boxed};
+        return out.accept(variables->ref(variableIndex));
+    }
+
+    // copies a variable read by a typed op-code onto the stack; only a packed variable is known to be of
+    // that type, without checking the type it holds
+    template <typename T>
+    static bool readTyped(
+        Cell& cell, CellTag& tag, dsTypeMeta const*& boxed, dsValueStorage const* variables, uint32_t variableIndex) noexcept
+    {
+        return readVariable(cell, tag, boxed, variables, variableIndex);
+    }
+
+    template <typename T>
+    static bool readTyped(Cell& cell, CellTag& tag, dsTypeMeta const*&, dsPackedVariables const* variables, uint32_t variableIndex) noexcept
+    {
+        tag = cellTag<T>;
+        cell.as<T>() = variables->read<T>(variableIndex);
+        return true;
+    }
+
+    // the variable's value, if it is held as exactly T
+    template <typename T>
+    static T const* readAs(dsValueStorage const* variables, uint32_t variableIndex) noexcept
+    {
+        dsValueStorage const& variable = variables[variableIndex];
+        return variable.type() == dsType<T>.typeId ? static_cast<T const*>(variable.pointer()) : nullptr;
+    }
+
+    template <typename T>
+    static T const* readAs(dsPackedVariables const* variables, uint32_t variableIndex) noexcept
+    {
+        if (!variables->layout.packs<T>(variableIndex))
+            return nullptr;
+        if constexpr (std::is_same_v<T, int32_t>)
+            return &variables->int32s[variableIndex];
+        else
+            return &variables->float32s[variableIndex - variables->layout.float32Start];
+    }
+
+    template <dsEvaluateDispatch Dispatch, typename VariableT>
+    static bool evaluateInstructions(dsEvaluateHost& host, dsAssemblyInstruction const* instructions, uint32_t count,
+        VariableT const* variables, Cell* stack, CellTag* tags, dsTypeMeta const** boxed, dsValueOut out_value)
+    {
+        static_assert(DS_THREADED_DISPATCH || Dispatch == dsEvaluateDispatch::Switch);
+
+        uint32_t stackTop = 0;
+
+        auto const pushValue = [&](dsValueRef const& value) {
+            CellOut out{.cell = stack[stackTop], .tag = tags[stackTop], .boxed = boxed[stackTop]};
+            ++stackTop;
+            return out.accept(value);
         };
 
-        struct Mul
-        {
-            template <typename T>
-            requires IsArithmetic<T>
-            static constexpr T apply(T left, T right) noexcept { return left * right; }
+        auto const pushVariable = [&](uint32_t variableIndex) {
+            uint32_t const slot = stackTop++;
+            return readVariable(stack[slot], tags[slot], boxed[slot], variables, variableIndex);
         };
 
-        struct Div
+        dsAssemblyInstruction const* ip = instructions;
+        dsAssemblyInstruction const* const end = instructions + count;
+
+#if DS_THREADED_DISPATCH
+        // each handler jumps straight to the next, giving the branch predictor a site per op-code
+        [[maybe_unused]] void* const* handlers = nullptr;
+        if constexpr (Dispatch == dsEvaluateDispatch::Threaded)
         {
-            template <typename T>
-            requires IsArithmetic<T>
-            static constexpr T apply(T left, T right) noexcept { return right != T{0} ? left / right : T{0}; }
-        };
+            // indexed by op-code, so the order must match dsOpCode
+            static void* const table[] = {&&handleNop, &&handlePushTrue, &&handlePushFalse, &&handlePushNil, &&handlePush0, &&handlePush1,
+                &&handlePush2, &&handlePushNeg1, &&handlePushS8, &&handlePushU8, &&handlePushS16, &&handlePushU16, &&handlePushConstant,
+                &&handleRead, &&handleReadI32, &&handleReadF32, &&handleReadB, &&handleCall, &&handleNegI32, &&handleNegF32, &&handleNotB,
+                &&handleAddI32, &&handleAddF32, &&handleSubI32, &&handleSubF32, &&handleMulI32, &&handleMulF32, &&handleDivI32,
+                &&handleDivF32, &&handleAndB, &&handleOrB, &&handleXorB, &&handleMinI32, &&handleMinF32, &&handleMaxI32, &&handleMaxF32,
+                &&handleAbsI32, &&handleAbsF32, &&handleFloorF32, &&handleSqrtF32, &&handleClampI32, &&handleClampF32, &&handleLerpF32,
+                &&handleEqI32, &&handleEqF32, &&handleEqB, &&handleNeI32, &&handleNeF32, &&handleNeB, &&handleLtI32, &&handleLtF32,
+                &&handleLeI32, &&handleLeF32, &&handleGtI32, &&handleGtF32, &&handleGeI32, &&handleGeF32, &&handleSelect, &&handleJump,
+                &&handleJumpIfFalse, &&handleJumpIfFalseOrPop, &&handleJumpIfTrueOrPop, &&handleReadRead, &&handleAddReadI32,
+                &&handleAddReadF32, &&handleSubReadI32, &&handleSubReadF32, &&handleMulReadI32, &&handleMulReadF32, &&handleAddImmI32,
+                &&handleSubImmI32, &&handleMulImmI32};
+            static_assert(sizeof(table) / sizeof(table[0]) == static_cast<size_t>(dsOpCode::Last));
+            handlers = table;
+        }
+
+#define DS_NEXT()                                               \
+    if constexpr (Dispatch == dsEvaluateDispatch::Threaded)     \
+    {                                                           \
+        if (++ip == end)                                        \
+            goto done;                                          \
+        goto* handlers[static_cast<uint8_t>(ip->op)];           \
+    }                                                           \
+    else                                                        \
+    {                                                           \
+        ++ip;                                                   \
+        goto dispatch;                                          \
+    }
+#else
+#define DS_NEXT() \
+    ++ip;         \
+    goto dispatch;
+#endif
 
-        template <typename Op, typename... T>
-        constexpr bool IsApplicable = requires(T const&... args)
+// the verifier resolved the target of every jump to an instruction after it
+#define DS_JUMP()                       \
+    ip = instructions + ip->target - 1; \
+    DS_NEXT()
+
+    // threaded dispatch only falls through here for the first instruction, so never jumps to the label
+    [[maybe_unused]] dispatch:
+        if (ip == end)
+            goto done;
+        switch (ip->op)
         {
-            Op::apply(args...);
-        };
+        case dsOpCode::Nop: goto handleNop;
+        case dsOpCode::PushTrue: goto handlePushTrue;
+        case dsOpCode::PushFalse: goto handlePushFalse;
+        case dsOpCode::PushNil: goto handlePushNil;
+        case dsOpCode::Push0: goto handlePush0;
+        case dsOpCode::Push1: goto handlePush1;
+        case dsOpCode::Push2: goto handlePush2;
+        case dsOpCode::PushNeg1: goto handlePushNeg1;
+        case dsOpCode::PushS8: goto handlePushS8;
+        case dsOpCode::PushU8: goto handlePushU8;
+        case dsOpCode::PushS16: goto handlePushS16;
+        case dsOpCode::PushU16: goto handlePushU16;
+        case dsOpCode::PushConstant: goto handlePushConstant;
+        case dsOpCode::Read: goto handleRead;
+        case dsOpCode::ReadI32: goto handleReadI32;
+        case dsOpCode::ReadF32: goto handleReadF32;
+        case dsOpCode::ReadB: goto handleReadB;
+        case dsOpCode::Call: goto handleCall;
+        case dsOpCode::NegI32: goto handleNegI32;
+        case dsOpCode::NegF32: goto handleNegF32;
+        case dsOpCode::NotB: goto handleNotB;
+        case dsOpCode::AddI32: goto handleAddI32;
+        case dsOpCode::AddF32: goto handleAddF32;
+        case dsOpCode::SubI32: goto handleSubI32;
+        case dsOpCode::SubF32: goto handleSubF32;
+        case dsOpCode::MulI32: goto handleMulI32;
+        case dsOpCode::MulF32: goto handleMulF32;
+        case dsOpCode::DivI32: goto handleDivI32;
+        case dsOpCode::DivF32: goto handleDivF32;
+        case dsOpCode::AndB: goto handleAndB;
+        case dsOpCode::OrB: goto handleOrB;
+        case dsOpCode::XorB: goto handleXorB;
+        case dsOpCode::MinI32: goto handleMinI32;
+        case dsOpCode::MinF32: goto handleMinF32;
+        case dsOpCode::MaxI32: goto handleMaxI32;
+        case dsOpCode::MaxF32: goto handleMaxF32;
+        case dsOpCode::AbsI32: goto handleAbsI32;
+        case dsOpCode::AbsF32: goto handleAbsF32;
+        case dsOpCode::FloorF32: goto handleFloorF32;
+        case dsOpCode::SqrtF32: goto handleSqrtF32;
+        case dsOpCode::ClampI32: goto handleClampI32;
+        case dsOpCode::ClampF32: goto handleClampF32;
+        case dsOpCode::LerpF32: goto handleLerpF32;
+        case dsOpCode::EqI32: goto handleEqI32;
+        case dsOpCode::EqF32: goto handleEqF32;
+        case dsOpCode::EqB: goto handleEqB;
+        case dsOpCode::NeI32: goto handleNeI32;
+        case dsOpCode::NeF32: goto handleNeF32;
+        case dsOpCode::NeB: goto handleNeB;
+        case dsOpCode::LtI32: goto handleLtI32;
+        case dsOpCode::LtF32: goto handleLtF32;
+        case dsOpCode::LeI32: goto handleLeI32;
+        case dsOpCode::LeF32: goto handleLeF32;
+        case dsOpCode::GtI32: goto handleGtI32;
+        case dsOpCode::GtF32: goto handleGtF32;
+        case dsOpCode::GeI32: goto handleGeI32;
+        case dsOpCode::GeF32: goto handleGeF32;
+        case dsOpCode::Select: goto handleSelect;
+        case dsOpCode::Jump: goto handleJump;
+        case dsOpCode::JumpIfFalse: goto handleJumpIfFalse;
+        case dsOpCode::JumpIfFalseOrPop: goto handleJumpIfFalseOrPop;
+        case dsOpCode::JumpIfTrueOrPop: goto handleJumpIfTrueOrPop;
+        case dsOpCode::ReadRead: goto handleReadRead;
+        case dsOpCode::AddReadI32: goto handleAddReadI32;
+        case dsOpCode::AddReadF32: goto handleAddReadF32;
+        case dsOpCode::SubReadI32: goto handleSubReadI32;
+        case dsOpCode::SubReadF32: goto handleSubReadF32;
+        case dsOpCode::MulReadI32: goto handleMulReadI32;
+        case dsOpCode::MulReadF32: goto handleMulReadF32;
+        case dsOpCode::AddImmI32: goto handleAddImmI32;
+        case dsOpCode::SubImmI32: goto handleSubImmI32;
+        case dsOpCode::MulImmI32: goto handleMulImmI32;
+        default: DS_GUARD_OR(false, false, "Unverified op-code");
+        }
 
-        static_assert(IsApplicable<Add, int, int>);
+    handleNop:
+        DS_NEXT();
+    handlePushTrue:
+        DS_PUSH_UNCHECKED(bool, true);
+        DS_NEXT();
+    handlePushFalse:
+        DS_PUSH_UNCHECKED(bool, false);
+        DS_NEXT();
+    handlePushNil:
+        DS_PUSH_UNCHECKED(decltype(nullptr), nullptr);
+        DS_NEXT();
+    handlePush0:
+    handlePush1:
+    handlePush2:
+    handlePushNeg1:
+    handlePushS8:
+    handlePushU8:
+    handlePushS16:
+    handlePushU16:
+        DS_PUSH_UNCHECKED(int32_t, ip->immediate);
+        DS_NEXT();
+    handlePushConstant:
+        if (!pushValue(ip->constant->ref()))
+            return false;
+        DS_NEXT();
+    handleRead:
+        if (!pushVariable(ip->variableIndex))
+            return false;
+        DS_NEXT();
+    handleReadI32:
+        if (!readTyped<int32_t>(stack[stackTop], tags[stackTop], boxed[stackTop], variables, ip->variableIndex))
+            return false;
+        ++stackTop;
+        DS_NEXT();
+    handleReadF32:
+        if (!readTyped<float>(stack[stackTop], tags[stackTop], boxed[stackTop], variables, ip->variableIndex))
+            return false;
+        ++stackTop;
+        DS_NEXT();
+    handleReadB:
+        if (!readTyped<bool>(stack[stackTop], tags[stackTop], boxed[stackTop], variables, ip->variableIndex))
+            return false;
+        ++stackTop;
+        DS_NEXT();
+    handleCall:
+    {
+        dsAssemblyFunctionImpl const& function = *ip->function;
+        stackTop -= ip->argc;
 
-        template <typename Op, typename T>
-        constexpr bool applyTyped(dsValueOut& out_result, T const& val) noexcept
+        // the compiler checked the arguments against the signature the adapter was generated from
+        if (function.native != nullptr)
         {
-            if constexpr (IsApplicable<Op, T>)
-                return out_result.accept(Op::apply(val));
-            else
-                return false;
+            function.native(stack[stackTop].storage, function.userData);
+            setCellType(tags[stackTop], boxed[stackTop], *function.nativeResult);
+            ++stackTop;
+            DS_NEXT();
         }
 
-        template <typename Op>
-        constexpr bool apply(dsValueOut out_result, dsValueStorage const& val) noexcept
+        dsValueStorage result;
+        Context ctx(host, ip->argc, &stack[stackTop], &tags[stackTop], &boxed[stackTop], result);
+        function.function(ctx, function.userData);
+        if (!pushValue(result.ref()))
+            return false;
+        DS_NEXT();
+    }
+    handleNegI32:
+        DS_UNOP_UNCHECKED(Neg, int32_t);
+        DS_NEXT();
+    handleNegF32:
+        DS_UNOP_UNCHECKED(Neg, float);
+        DS_NEXT();
+    handleNotB:
+        DS_UNOP_UNCHECKED(Not, bool);
+        DS_NEXT();
+    handleAddI32:
+        DS_BINOP_UNCHECKED(Add, int32_t);
+        DS_NEXT();
+    handleAddF32:
+        DS_BINOP_UNCHECKED(Add, float);
+        DS_NEXT();
+    handleSubI32:
+        DS_BINOP_UNCHECKED(Sub, int32_t);
+        DS_NEXT();
+    handleSubF32:
+        DS_BINOP_UNCHECKED(Sub, float);
+        DS_NEXT();
+    handleMulI32:
+        DS_BINOP_UNCHECKED(Mul, int32_t);
+        DS_NEXT();
+    handleMulF32:
+        DS_BINOP_UNCHECKED(Mul, float);
+        DS_NEXT();
+    handleDivI32:
+        DS_BINOP_UNCHECKED(Div, int32_t);
+        DS_NEXT();
+    handleDivF32:
+        DS_BINOP_UNCHECKED(Div, float);
+        DS_NEXT();
+    handleAndB:
+        DS_BINOP_UNCHECKED(And, bool);
+        DS_NEXT();
+    handleOrB:
+        DS_BINOP_UNCHECKED(Or, bool);
+        DS_NEXT();
+    handleXorB:
+        DS_BINOP_UNCHECKED(Xor, bool);
+        DS_NEXT();
+    handleMinI32:
+        DS_BINOP_UNCHECKED(Min, int32_t);
+        DS_NEXT();
+    handleMinF32:
+        DS_BINOP_UNCHECKED(Min, float);
+        DS_NEXT();
+    handleMaxI32:
+        DS_BINOP_UNCHECKED(Max, int32_t);
+        DS_NEXT();
+    handleMaxF32:
+        DS_BINOP_UNCHECKED(Max, float);
+        DS_NEXT();
+    handleAbsI32:
+        DS_UNOP_UNCHECKED(Abs, int32_t);
+        DS_NEXT();
+    handleAbsF32:
+        DS_UNOP_UNCHECKED(Abs, float);
+        DS_NEXT();
+    handleFloorF32:
+        DS_UNOP_UNCHECKED(Floor, float);
+        DS_NEXT();
+    handleSqrtF32:
+        DS_UNOP_UNCHECKED(Sqrt, float);
+        DS_NEXT();
+    handleClampI32:
+        DS_TERNOP_UNCHECKED(Clamp, int32_t);
+        DS_NEXT();
+    handleClampF32:
+        DS_TERNOP_UNCHECKED(Clamp, float);
+        DS_NEXT();
+    handleLerpF32:
+        DS_TERNOP_UNCHECKED(Lerp, float);
+        DS_NEXT();
+    handleEqI32:
+        DS_CMPOP_UNCHECKED(Equal, int32_t);
+        DS_NEXT();
+    handleEqF32:
+        DS_CMPOP_UNCHECKED(Equal, float);
+        DS_NEXT();
+    handleEqB:
+        DS_CMPOP_UNCHECKED(Equal, bool);
+        DS_NEXT();
+    handleNeI32:
+        DS_CMPOP_UNCHECKED(NotEqual, int32_t);
+        DS_NEXT();
+    handleNeF32:
+        DS_CMPOP_UNCHECKED(NotEqual, float);
+        DS_NEXT();
+    handleNeB:
+        DS_CMPOP_UNCHECKED(NotEqual, bool);
+        DS_NEXT();
+    handleLtI32:
+        DS_CMPOP_UNCHECKED(Less, int32_t);
+        DS_NEXT();
+    handleLtF32:
+        DS_CMPOP_UNCHECKED(Less, float);
+        DS_NEXT();
+    handleLeI32:
+        DS_CMPOP_UNCHECKED(LessEqual, int32_t);
+        DS_NEXT();
+    handleLeF32:
+        DS_CMPOP_UNCHECKED(LessEqual, float);
+        DS_NEXT();
+    handleGtI32:
+        DS_CMPOP_UNCHECKED(Greater, int32_t);
+        DS_NEXT();
+    handleGtF32:
+        DS_CMPOP_UNCHECKED(Greater, float);
+        DS_NEXT();
+    handleGeI32:
+        DS_CMPOP_UNCHECKED(GreaterEqual, int32_t);
+        DS_NEXT();
+    handleGeF32:
+        DS_CMPOP_UNCHECKED(GreaterEqual, float);
+        DS_NEXT();
+    handleSelect:
+    {
+        stackTop -= 2;
+        uint32_t const chosen = stack[stackTop - 1].as<bool>() ? stackTop : stackTop + 1;
+        stack[stackTop - 1] = stack[chosen];
+        tags[stackTop - 1] = tags[chosen];
+        if (tags[chosen] == CellTag::Boxed)
+            boxed[stackTop - 1] = boxed[chosen];
+        DS_NEXT();
+    }
+    handleJump:
+        DS_JUMP();
+    handleJumpIfFalse:
+        if (!stack[--stackTop].as<bool>())
         {
-            if (val.type() == dsType<int32_t>.typeId)
-                return applyTyped<Op>(out_result, val.as<int32_t>());
-            if (val.type() == dsType<float>.typeId)
-                return applyTyped<Op>(out_result, val.as<float>());
-            if (val.type() == dsType<bool>.typeId)
-                return applyTyped<Op>(out_result, val.as<bool>());
+            DS_JUMP();
+        }
+        DS_NEXT();
+    handleJumpIfFalseOrPop:
+        if (!stack[stackTop - 1].as<bool>())
+        {
+            DS_JUMP();
+        }
+        --stackTop;
+        DS_NEXT();
+    handleJumpIfTrueOrPop:
+        if (stack[stackTop - 1].as<bool>())
+        {
+            DS_JUMP();
+        }
+        --stackTop;
+        DS_NEXT();
+    handleReadRead:
+        if (!pushVariable(ip->variableIndices[0]) || !pushVariable(ip->variableIndices[1]))
             return false;
+        DS_NEXT();
+    handleAddReadI32:
+        DS_BINOP_READ_UNCHECKED(Add, int32_t);
+        DS_NEXT();
+    handleAddReadF32:
+        DS_BINOP_READ_UNCHECKED(Add, float);
+        DS_NEXT();
+    handleSubReadI32:
+        DS_BINOP_READ_UNCHECKED(Sub, int32_t);
+        DS_NEXT();
+    handleSubReadF32:
+        DS_BINOP_READ_UNCHECKED(Sub, float);
+        DS_NEXT();
+    handleMulReadI32:
+        DS_BINOP_READ_UNCHECKED(Mul, int32_t);
+        DS_NEXT();
+    handleMulReadF32:
+        DS_BINOP_READ_UNCHECKED(Mul, float);
+        DS_NEXT();
+    handleAddImmI32:
+        DS_BINOP_IMM_UNCHECKED(Add);
+        DS_NEXT();
+    handleSubImmI32:
+        DS_BINOP_IMM_UNCHECKED(Sub);
+        DS_NEXT();
+    handleMulImmI32:
+        DS_BINOP_IMM_UNCHECKED(Mul);
+        DS_NEXT();
+
+#undef DS_JUMP
+#undef DS_NEXT
+
+    done:
+        return out_value.accept(cellMeta(tags[0], boxed[0]), stack[0].storage);
+    }
+
+    template <dsEvaluateDispatch Dispatch, typename VariableT>
+    static bool evaluateExpression(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, VariableT const* variables, dsValueOut out_value)
+    {
+        dsAssemblyDecodedExpression const& expression = assembly.decodedExpressions[expressionIndex];
+        dsAssemblyInstruction const* const instructions = assembly.instructions.data() + expression.instructionStart;
+
+        if (expression.maxStack <= s_stackSize)
+        {
+            Cell stack[s_stackSize];
+            CellTag tags[s_stackSize];
+            dsTypeMeta const* boxed[s_stackSize];
+            return evaluateInstructions<Dispatch>(
+                host, instructions, expression.instructionCount, variables, stack, tags, boxed, out_value);
         }
 
-        template <typename Op, typename T, typename U>
-        constexpr bool applyTyped(dsValueOut& out_result, T const& left, U const& right) noexcept
+        // the cells, followed by the types of boxed cells, then the tags
+        static_assert(alignof(Cell) >= alignof(dsTypeMeta const*));
+        uint64_t const stackSize = uint64_t{expression.maxStack} * (sizeof(Cell) + sizeof(dsTypeMeta const*) + sizeof(CellTag));
+        if (stackSize > UINT32_MAX)
+            return false;
+        uint32_t const size = static_cast<uint32_t>(stackSize);
+
+        // an evaluation nested within one already using the scratch memory allocates its own
+        void* const memory = scratch.acquire(size, alignof(Cell));
+        void* const stackMemory = memory != nullptr ? memory : scratch.allocator().allocate(size, alignof(Cell));
+        if (stackMemory == nullptr)
+            return false;
+
+        Cell* const stack = static_cast<Cell*>(stackMemory);
+        auto** const boxed = reinterpret_cast<dsTypeMeta const**>(stack + expression.maxStack);
+        auto* const tags = reinterpret_cast<CellTag*>(boxed + expression.maxStack);
+
+        bool const result =
+            evaluateInstructions<Dispatch>(host, instructions, expression.instructionCount, variables, stack, tags, boxed, out_value);
+
+        if (memory != nullptr)
+            scratch.release();
+        else
+            scratch.allocator().free(stackMemory, size, alignof(Cell));
+        return result;
+    }
+
+    template <typename VariableT>
+    static bool evaluateDispatched(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, VariableT const* variables, dsValueOut out_value, dsEvaluateDispatch dispatch)
+    {
+#if DS_THREADED_DISPATCH
+        if (dispatch == dsEvaluateDispatch::Threaded)
+            return evaluateExpression<dsEvaluateDispatch::Threaded>(host, scratch, assembly, expressionIndex, variables, out_value);
+#endif
+        return evaluateExpression<dsEvaluateDispatch::Switch>(host, scratch, assembly, expressionIndex, variables, out_value);
+    }
+
+    bool dsEvaluateInstructions(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* variables, dsValueOut out_value, dsEvaluateDispatch dispatch)
+    {
+        return evaluateDispatched(host, scratch, assembly, expressionIndex, variables, out_value, dispatch);
+    }
+
+    bool dsEvaluateInstructions(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* variables, dsValueOut out_value, dsEvaluateDispatch dispatch)
+    {
+        return evaluateDispatched(host, scratch, assembly, expressionIndex, variables, out_value, dispatch);
+    }
+
+    template <typename T>
+    static void splatLanes(LaneCell& cell, T value) noexcept
+    {
+        T* const values = cell.as<T>();
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+            values[lane] = value;
+    }
+
+    // lanes only carry the types the typed op-codes operate on
+    static bool splatLanes(LaneCell& cell, CellTag& tag, dsValueRef const& value) noexcept
+    {
+        tag = cellTagOf(value.meta());
+        switch (tag)
         {
-            if constexpr (IsApplicable<Op, T, U>)
-                return out_result.accept(Op::apply(left, right));
-            else
-                return false;
+        case CellTag::Int32: splatLanes(cell, *static_cast<int32_t const*>(value.pointer())); return true;
+        case CellTag::Float32: splatLanes(cell, *static_cast<float const*>(value.pointer())); return true;
+        case CellTag::Bool: splatLanes(cell, *static_cast<bool const*>(value.pointer())); return true;
+        default: return false;
         }
+    }
 
-        // note: left/right are swapped because we pop the right before the left
-        template <typename Op>
-        constexpr bool apply(dsValueOut out_result, dsValueStorage const& left, dsValueStorage const& right) noexcept
+    // a lane's variable, if it is held as exactly T
+    template <typename T>
+    static bool readLane(dsValueStorage const* variables, uint32_t variableIndex, T& out_value) noexcept
+    {
+        dsValueStorage const& variable = variables[variableIndex];
+        if (variable.type() != dsType<T>.typeId)
+            return false;
+        out_value = *static_cast<T const*>(variable.pointer());
+        return true;
+    }
+
+    template <typename T>
+    static bool readLane(dsPackedVariables const* variables, uint32_t variableIndex, T& out_value) noexcept
+    {
+        if (variables->layout.packs<T>(variableIndex))
         {
-            if (left.type() != right.type())
+            out_value = variables->read<T>(variableIndex);
+            return true;
+        }
+        dsValueRef const variable = variables->ref(variableIndex);
+        if (variable.type() != dsType<T>.typeId)
+            return false;
+        out_value = *static_cast<T const*>(variable.pointer());
+        return true;
+    }
+
+    static dsTypeMeta const& laneMeta(dsValueStorage const* variables, uint32_t variableIndex) noexcept
+    {
+        return variables[variableIndex].ref().meta();
+    }
+    static dsTypeMeta const& laneMeta(dsPackedVariables const* variables, uint32_t variableIndex) noexcept
+    {
+        return variables->ref(variableIndex).meta();
+    }
+
+    template <typename T, typename VariableT>
+    static bool readLanes(LaneCell& cell, VariableT const* const* variables, uint32_t variableIndex) noexcept
+    {
+        T* const values = cell.as<T>();
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+        {
+            if (!readLane(variables[lane], variableIndex, values[lane]))
                 return false;
+        }
+        return true;
+    }
 
-            if (left.type() == dsType<int32_t>.typeId)
-                return applyTyped<Op>(out_result, left.as<int32_t>(), right.as<int32_t>());
-            if (left.type() == dsType<float>.typeId)
-                return applyTyped<Op>(out_result, left.as<float>(), right.as<float>());
-            if (left.type() == dsType<bool>.typeId)
-                return applyTyped<Op>(out_result, left.as<bool>(), right.as<bool>());
-            return false;
+    template <typename VariableT>
+    static bool readLanes(LaneCell& cell, CellTag& tag, VariableT const* const* variables, uint32_t variableIndex) noexcept
+    {
+        tag = cellTagOf(laneMeta(variables[0], variableIndex));
+        switch (tag)
+        {
+        case CellTag::Int32: return readLanes<int32_t>(cell, variables, variableIndex);
+        case CellTag::Float32: return readLanes<float>(cell, variables, variableIndex);
+        case CellTag::Bool: return readLanes<bool>(cell, variables, variableIndex);
+        default: return false;
         }
+    }
 
-        union RefUnion {
-            char dummy_ = 0;
-            dsValueRef ref;
+    template <typename T>
+    static void storeLanes(LaneCell const& cell, dsValueStorage* out_values, uint32_t laneCount) noexcept
+    {
+        T const* const values = cell.as<T>();
+        for (uint32_t lane = 0; lane != laneCount; ++lane)
+            out_values[lane] = dsValueStorage{values[lane]};
+    }
 
-            RefUnion() = default;
-            ~RefUnion() = default;
-        };
-    } // namespace
+    template <typename Op, typename T>
+    static void applyLanes(LaneCell& cell) noexcept
+    {
+        T* const values = cell.as<T>();
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+            values[lane] = Op::apply(values[lane]);
+    }
 
-#define DS_CHECKTOP()            \
-    if (stackTop >= s_stackSize) \
-        return false;            \
-    else                         \
-        ;
-
-#define DS_PUSH(val)                             \
-    if (true)                                    \
-    {                                            \
-        DS_CHECKTOP()                            \
-        stack[stackTop++] = dsValueStorage(val); \
-    }                                            \
-    else                                         \
-        ;
-
-#define DS_POP(result) \
-    if (stackTop == 0) \
-        return false;  \
-    result = std::move(stack[--stackTop])
-
-#define DS_UNNOP(op)                                  \
-    {                                                 \
-        DS_POP(auto const& value);                    \
-        if (!apply<op>(stack[stackTop].out(), value)) \
-            return false;                             \
-        ++stackTop;                                   \
+    template <typename Op, typename T>
+    static void applyLanes(LaneCell& left, LaneCell const& right) noexcept
+    {
+        T* const lefts = left.as<T>();
+        T const* const rights = right.as<T>();
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+            lefts[lane] = Op::apply(lefts[lane], rights[lane]);
     }
 
-#define DS_BINOP(op)                                        \
-    {                                                       \
-        DS_POP(auto const& right);                          \
-        DS_POP(auto const& left);                           \
-        if (!apply<op>(stack[stackTop].out(), left, right)) \
-            return false;                                   \
-        ++stackTop;                                         \
+    template <typename Op, typename T>
+    static void applyLanes(LaneCell& first, LaneCell const& second, LaneCell const& third) noexcept
+    {
+        T* const firsts = first.as<T>();
+        T const* const seconds = second.as<T>();
+        T const* const thirds = third.as<T>();
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+            firsts[lane] = Op::apply(firsts[lane], seconds[lane], thirds[lane]);
     }
 
-    bool dsEvaluate(dsEvaluateHost& host, uint8_t const* ops, uint32_t opsLen, dsValueOut out_value)
+    // a comparison leaves booleans in the lanes of its left operand
+    template <typename Op, typename T>
+    static void compareLanes(LaneCell& left, LaneCell const& right) noexcept
     {
-        DS_GUARD_OR(ops != nullptr, false);
-        DS_GUARD_OR(opsLen > 0, false);
+        T const* const lefts = left.as<T>();
+        T const* const rights = right.as<T>();
+        bool results[s_laneCount];
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+            results[lane] = Op::apply(lefts[lane], rights[lane]);
+        std::memcpy(left.storage, results, sizeof(results));
+    }
 
-        uint8_t const* const opsEnd = ops + opsLen;
+    // both values were evaluated for every lane, so choosing between them is a blend
+    template <typename T>
+    static void selectLanes(LaneCell& condition, LaneCell const& ifTrue, LaneCell const& ifFalse) noexcept
+    {
+        bool const* const conditions = condition.as<bool>();
+        T const* const trues = ifTrue.as<T>();
+        T const* const falses = ifFalse.as<T>();
+        T results[s_laneCount];
+        for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+            results[lane] = conditions[lane] ? trues[lane] : falses[lane];
+        std::memcpy(condition.storage, results, sizeof(results));
+    }
+
+    static void selectLanes(LaneCell& condition, LaneCell const& ifTrue, LaneCell const& ifFalse, CellTag tag) noexcept
+    {
+        if (tag == CellTag::Int32)
+            selectLanes<int32_t>(condition, ifTrue, ifFalse);
+        else if (tag == CellTag::Float32)
+            selectLanes<float>(condition, ifTrue, ifFalse);
+        else
+            selectLanes<bool>(condition, ifTrue, ifFalse);
+    }
+
+#define DS_UNOP_LANES(op, type) applyLanes<op, type>(stack[stackTop - 1])
+
+#define DS_BINOP_LANES(op, type)                                    \
+    {                                                               \
+        --stackTop;                                                 \
+        applyLanes<op, type>(stack[stackTop - 1], stack[stackTop]); \
+    }
 
-        dsValueStorage stack[s_stackSize];
+#define DS_TERNOP_LANES(op, type)                                                        \
+    {                                                                                    \
+        stackTop -= 2;                                                                   \
+        applyLanes<op, type>(stack[stackTop - 1], stack[stackTop], stack[stackTop + 1]); \
+    }
+
+#define DS_CMPOP_LANES(op, type)                                      \
+    {                                                                 \
+        --stackTop;                                                   \
+        compareLanes<op, type>(stack[stackTop - 1], stack[stackTop]); \
+        tags[stackTop - 1] = CellTag::Bool;                           \
+    }
+
+// superinstructions load their right operand into the scratch slot above the left one
+#define DS_BINOP_READ_LANES(op, type)                                        \
+    {                                                                        \
+        if (!readLanes<type>(stack[stackTop], variables, ip->variableIndex)) \
+            return false;                                                    \
+        applyLanes<op, type>(stack[stackTop - 1], stack[stackTop]);          \
+    }
+
+#define DS_BINOP_IMM_LANES(op)                                         \
+    {                                                                  \
+        splatLanes(stack[stackTop], ip->immediate);                    \
+        applyLanes<op, int32_t>(stack[stackTop - 1], stack[stackTop]); \
+    }
+
+    // evaluates a group of lanes, one variable block per lane; fails without side effects if any
+    // operation or value cannot be carried in lanes, so that the caller may evaluate each block alone
+    template <typename VariableT>
+    static bool evaluateLanes(dsAssemblyInstruction const* instructions, uint32_t count, VariableT const* const* variables,
+        LaneCell* stack, CellTag* tags) noexcept
+    {
         uint32_t stackTop = 0;
 
-        for (uint8_t const* ip = ops; ip != opsEnd; ++ip)
+        // each op-code does the work of every lane, so dispatch is already amortized and a switch suffices
+        for (dsAssemblyInstruction const* ip = instructions; ip != instructions + count; ++ip)
         {
-            switch (dsOpCode(*ip))
+            switch (ip->op)
             {
             case dsOpCode::Nop: break;
-            case dsOpCode::PushTrue: DS_PUSH(true); break;
-            case dsOpCode::PushFalse: DS_PUSH(false); break;
-            case dsOpCode::PushNil: DS_PUSH(nullptr); break;
-            case dsOpCode::Push0: DS_PUSH(0); break;
-            case dsOpCode::Push1: DS_PUSH(1); break;
-            case dsOpCode::Push2: DS_PUSH(2); break;
-            case dsOpCode::PushNeg1: DS_PUSH(-1); break;
-            case dsOpCode::PushS8:
-                if (++ip == opsEnd)
-                    return false;
-                DS_PUSH(static_cast<int32_t>(static_cast<int8_t>(*ip)));
+            case dsOpCode::PushTrue:
+            case dsOpCode::PushFalse:
+                tags[stackTop] = CellTag::Bool;
+                splatLanes(stack[stackTop++], ip->op == dsOpCode::PushTrue);
                 break;
+            case dsOpCode::Push0:
+            case dsOpCode::Push1:
+            case dsOpCode::Push2:
+            case dsOpCode::PushNeg1:
+            case dsOpCode::PushS8:
             case dsOpCode::PushU8:
-                if (++ip == opsEnd)
-                    return false;
-                DS_PUSH(static_cast<int32_t>(*ip));
-                break;
-            case dsOpCode::PushS16: {
-                if (++ip == opsEnd)
-                    return false;
-                uint16_t value = *ip << 8;
-                if (++ip == opsEnd)
-                    return false;
-                value |= *ip;
-                DS_PUSH(static_cast<int32_t>(static_cast<int16_t>(value)));
+            case dsOpCode::PushS16:
+            case dsOpCode::PushU16:
+                tags[stackTop] = CellTag::Int32;
+                splatLanes(stack[stackTop++], ip->immediate);
                 break;
-            }
-            case dsOpCode::PushU16: {
-                if (++ip == opsEnd)
-                    return false;
-                uint16_t value = *ip << 8;
-                if (++ip == opsEnd)
-                    return false;
-                value |= *ip;
-                DS_PUSH(static_cast<int32_t>(value));
-                break;
-            }
-            case dsOpCode::PushConstant: {
-                if (++ip == opsEnd)
-                    return false;
-                uint16_t index = *ip << 8;
-
-                if (++ip == opsEnd)
-                    return false;
-                index |= *ip;
-                DS_CHECKTOP();
-                if (!host.readConstant(index, stack[stackTop].out()))
+            case dsOpCode::PushConstant:
+                if (!splatLanes(stack[stackTop], tags[stackTop], ip->constant->ref()))
                     return false;
                 ++stackTop;
                 break;
-            }
-            case dsOpCode::Read: {
-                if (++ip == opsEnd)
-                    return false;
-                uint16_t index = *ip << 8;
-                if (++ip == opsEnd)
-                    return false;
-                index |= *ip;
-                DS_CHECKTOP();
-                if (!host.readVariable(index, stack[stackTop].out()))
+            case dsOpCode::Read:
+            case dsOpCode::ReadI32:
+            case dsOpCode::ReadF32:
+            case dsOpCode::ReadB:
+                if (!readLanes(stack[stackTop], tags[stackTop], variables, ip->variableIndex))
                     return false;
                 ++stackTop;
                 break;
-            }
-            case dsOpCode::Call: {
-                if (++ip == opsEnd)
-                    return false;
-                uint16_t index = *ip << 8;
-                if (++ip == opsEnd)
-                    return false;
-                index |= *ip;
-                if (++ip == opsEnd)
-                    return false;
-                uint8_t argc = *ip;
-                if (argc > stackTop)
-                    return false;
-
-                dsValueStorage result;
-                uint32_t const stackArgOffset = stackTop - argc;
-                Context ctx(host, argc, &stack[stackArgOffset], result);
-                if (!host.invokeFunction(index, ctx))
-                    return false;
-
-                stackTop -= argc;
-                DS_PUSH(std::move(result));
+            case dsOpCode::NegI32: DS_UNOP_LANES(Neg, int32_t); break;
+            case dsOpCode::NegF32: DS_UNOP_LANES(Neg, float); break;
+            case dsOpCode::NotB: DS_UNOP_LANES(Not, bool); break;
+            case dsOpCode::AddI32: DS_BINOP_LANES(Add, int32_t); break;
+            case dsOpCode::AddF32: DS_BINOP_LANES(Add, float); break;
+            case dsOpCode::SubI32: DS_BINOP_LANES(Sub, int32_t); break;
+            case dsOpCode::SubF32: DS_BINOP_LANES(Sub, float); break;
+            case dsOpCode::MulI32: DS_BINOP_LANES(Mul, int32_t); break;
+            case dsOpCode::MulF32: DS_BINOP_LANES(Mul, float); break;
+            case dsOpCode::DivI32: DS_BINOP_LANES(Div, int32_t); break;
+            case dsOpCode::DivF32: DS_BINOP_LANES(Div, float); break;
+            case dsOpCode::AndB: DS_BINOP_LANES(And, bool); break;
+            case dsOpCode::OrB: DS_BINOP_LANES(Or, bool); break;
+            case dsOpCode::XorB: DS_BINOP_LANES(Xor, bool); break;
+            case dsOpCode::MinI32: DS_BINOP_LANES(Min, int32_t); break;
+            case dsOpCode::MinF32: DS_BINOP_LANES(Min, float); break;
+            case dsOpCode::MaxI32: DS_BINOP_LANES(Max, int32_t); break;
+            case dsOpCode::MaxF32: DS_BINOP_LANES(Max, float); break;
+            case dsOpCode::AbsI32: DS_UNOP_LANES(Abs, int32_t); break;
+            case dsOpCode::AbsF32: DS_UNOP_LANES(Abs, float); break;
+            case dsOpCode::FloorF32: DS_UNOP_LANES(Floor, float); break;
+            case dsOpCode::SqrtF32: DS_UNOP_LANES(Sqrt, float); break;
+            case dsOpCode::ClampI32: DS_TERNOP_LANES(Clamp, int32_t); break;
+            case dsOpCode::ClampF32: DS_TERNOP_LANES(Clamp, float); break;
+            case dsOpCode::LerpF32: DS_TERNOP_LANES(Lerp, float); break;
+            case dsOpCode::EqI32: DS_CMPOP_LANES(Equal, int32_t); break;
+            case dsOpCode::EqF32: DS_CMPOP_LANES(Equal, float); break;
+            case dsOpCode::EqB: DS_CMPOP_LANES(Equal, bool); break;
+            case dsOpCode::NeI32: DS_CMPOP_LANES(NotEqual, int32_t); break;
+            case dsOpCode::NeF32: DS_CMPOP_LANES(NotEqual, float); break;
+            case dsOpCode::NeB: DS_CMPOP_LANES(NotEqual, bool); break;
+            case dsOpCode::LtI32: DS_CMPOP_LANES(Less, int32_t); break;
+            case dsOpCode::LtF32: DS_CMPOP_LANES(Less, float); break;
+            case dsOpCode::LeI32: DS_CMPOP_LANES(LessEqual, int32_t); break;
+            case dsOpCode::LeF32: DS_CMPOP_LANES(LessEqual, float); break;
+            case dsOpCode::GtI32: DS_CMPOP_LANES(Greater, int32_t); break;
+            case dsOpCode::GtF32: DS_CMPOP_LANES(Greater, float); break;
+            case dsOpCode::GeI32: DS_CMPOP_LANES(GreaterEqual, int32_t); break;
+            case dsOpCode::GeF32: DS_CMPOP_LANES(GreaterEqual, float); break;
+            case dsOpCode::Select:
+                stackTop -= 2;
+                selectLanes(stack[stackTop - 1], stack[stackTop], stack[stackTop + 1], tags[stackTop]);
+                tags[stackTop - 1] = tags[stackTop];
                 break;
-            }
-            case dsOpCode::Neg: DS_UNNOP(Neg); break;
-            case dsOpCode::Not: DS_UNNOP(Not); break;
-            case dsOpCode::Add: DS_BINOP(Add); break;
-            case dsOpCode::Sub: DS_BINOP(Sub); break;
-            case dsOpCode::Mul: DS_BINOP(Mul); break;
-            case dsOpCode::Div: DS_BINOP(Div); break;
-            case dsOpCode::And: DS_BINOP(And); break;
-            case dsOpCode::Or: DS_BINOP(Or); break;
-            case dsOpCode::Xor: DS_BINOP(Xor); break;
+            case dsOpCode::ReadRead:
+                for (uint32_t const variableIndex : ip->variableIndices)
+                {
+                    if (!readLanes(stack[stackTop], tags[stackTop], variables, variableIndex))
+                        return false;
+                    ++stackTop;
+                }
+                break;
+            case dsOpCode::AddReadI32: DS_BINOP_READ_LANES(Add, int32_t); break;
+            case dsOpCode::AddReadF32: DS_BINOP_READ_LANES(Add, float); break;
+            case dsOpCode::SubReadI32: DS_BINOP_READ_LANES(Sub, int32_t); break;
+            case dsOpCode::SubReadF32: DS_BINOP_READ_LANES(Sub, float); break;
+            case dsOpCode::MulReadI32: DS_BINOP_READ_LANES(Mul, int32_t); break;
+            case dsOpCode::MulReadF32: DS_BINOP_READ_LANES(Mul, float); break;
+            case dsOpCode::AddImmI32: DS_BINOP_IMM_LANES(Add); break;
+            case dsOpCode::SubImmI32: DS_BINOP_IMM_LANES(Sub); break;
+            case dsOpCode::MulImmI32: DS_BINOP_IMM_LANES(Mul); break;
+            // nil does not fit a lane, functions are invoked with a single set of arguments, and lanes may
+            // disagree on the way a jump goes
+            case dsOpCode::PushNil:
+            case dsOpCode::Call:
+            case dsOpCode::Jump:
+            case dsOpCode::JumpIfFalse:
+            case dsOpCode::JumpIfFalseOrPop:
+            case dsOpCode::JumpIfTrueOrPop:
             default: return false;
             }
         }
+        return true;
+    }
 
-        if (stackTop != 1)
-            return false;
+    template <typename VariableT>
+    static uint32_t evaluateLaneGroups(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex,
+        VariableT const* const* variables, uint32_t count, dsValueStorage* out_values) noexcept
+    {
+        dsAssemblyDecodedExpression const& expression = assembly.decodedExpressions[expressionIndex];
+        dsAssemblyInstruction const* const instructions = assembly.instructions.data() + expression.instructionStart;
+
+        if (expression.maxStack > s_stackSize)
+            return 0;
 
-        return out_value.accept(stack[0].ref());
+        LaneCell stack[s_stackSize];
+        CellTag tags[s_stackSize];
+
+        uint32_t first = 0;
+        for (; first < count; first += s_laneCount)
+        {
+            uint32_t const laneCount = count - first < s_laneCount ? count - first : s_laneCount;
+
+            // a partial group repeats its first block in the unused lanes, whose results are discarded
+            VariableT const* laneVariables[s_laneCount];
+            for (uint32_t lane = 0; lane != s_laneCount; ++lane)
+                laneVariables[lane] = variables[first + (lane < laneCount ? lane : 0)];
+
+            // an expression that cannot be carried in lanes will not be able to for any later group either,
+            // unless a variable held an unexpected type; either way, the remaining blocks are left to the caller
+            if (!evaluateLanes(instructions, expression.instructionCount, laneVariables, stack, tags))
+                return first;
+
+            if (tags[0] == CellTag::Int32)
+                storeLanes<int32_t>(stack[0], out_values + first, laneCount);
+            else if (tags[0] == CellTag::Float32)
+                storeLanes<float>(stack[0], out_values + first, laneCount);
+            else
+                storeLanes<bool>(stack[0], out_values + first, laneCount);
+        }
+        return count;
+    }
+
+    uint32_t dsEvaluateLanes(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* const* variables,
+        uint32_t count, dsValueStorage* out_values) noexcept
+    {
+        DS_GUARD_OR(count == 0 || (variables != nullptr && out_values != nullptr), 0);
+
+        return evaluateLaneGroups(assembly, expressionIndex, variables, count, out_values);
+    }
+
+    uint32_t dsEvaluateLanes(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex,
+        dsPackedVariables const* const* variables, uint32_t count, dsValueStorage* out_values) noexcept
+    {
+        DS_GUARD_OR(count == 0 || (variables != nullptr && out_values != nullptr), 0);
+
+        return evaluateLaneGroups(assembly, expressionIndex, variables, count, out_values);
+    }
+
+    template <typename VariableT>
+    static bool evaluateBatch(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, VariableT const* const* variables, uint32_t count, dsValueStorage* out_values)
+    {
+        DS_GUARD_OR(count == 0 || (variables != nullptr && out_values != nullptr), false);
+
+        for (uint32_t index = evaluateLaneGroups(assembly, expressionIndex, variables, count, out_values); index != count; ++index)
+        {
+            if (!dsEvaluateInstructions(host, scratch, assembly, expressionIndex, variables[index], out_values[index].out()))
+                return false;
+        }
+        return true;
+    }
+
+    bool dsEvaluateInstructionsBatch(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* const* variables, uint32_t count, dsValueStorage* out_values)
+    {
+        return evaluateBatch(host, scratch, assembly, expressionIndex, variables, count, out_values);
+    }
+
+    bool dsEvaluateInstructionsBatch(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* const* variables, uint32_t count, dsValueStorage* out_values)
+    {
+        return evaluateBatch(host, scratch, assembly, expressionIndex, variables, count, out_values);
+    }
+
+    template <typename VariableT>
+    static bool evaluateTiered(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, VariableT const* variables, dsValueOut out_value)
+    {
+#if DS_JIT
+        dsJitExpression& jit = assembly.decodedExpressions[expressionIndex].jit;
+        if (dsJitFunction const function = jit.function.load(std::memory_order_acquire); function != nullptr)
+        {
+            // a variable of another type than the code was specialized to, or held in another form than the
+            // code reads, falls back to the interpreter
+            alignas(uint32_t) char result[sizeof(uint32_t)];
+            if (jit.packed == std::is_same_v<VariableT, dsPackedVariables> && function(variables, result))
+                return out_value.accept(*jit.resultMeta, result);
+        }
+        else if (jit.evaluations.fetch_add(1, std::memory_order_relaxed) + 1 == dsJitPromotionThreshold)
+        {
+            // only the evaluation which reaches the threshold compiles, so compiles never race; an
+            // expression which cannot be compiled stays on the interpreter
+            static_cast<void>(dsJitCompile(assembly, expressionIndex, variables, jit));
+        }
+#endif
+        return dsEvaluateInstructions(host, scratch, assembly, expressionIndex, variables, out_value);
+    }
+
+    bool dsEvaluateExpression(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* variables, dsValueOut out_value)
+    {
+        return evaluateTiered(host, scratch, assembly, expressionIndex, variables, out_value);
+    }
+
+    bool dsEvaluateExpression(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* variables, dsValueOut out_value)
+    {
+        return evaluateTiered(host, scratch, assembly, expressionIndex, variables, out_value);
     }
 } // namespace descript
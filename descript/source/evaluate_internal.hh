@@ -0,0 +1,142 @@
+// descript
+
+#pragma once
+
+#include "descript/evaluate.hh"
+
+#include "assembly_internal.hh"
+#include "jit.hh"
+#include "ops.hh"
+
+#include <cstdint>
+
+// computed goto (labels as values) is a GNU extension, also supported by Clang
+#if !defined(DS_THREADED_DISPATCH)
+#if defined(__GNUC__)
+#define DS_THREADED_DISPATCH 1
+#else
+#define DS_THREADED_DISPATCH 0
+#endif
+#endif
+
+namespace descript {
+    enum class dsEvaluateDispatch : uint8_t
+    {
+        Switch,   // portable, a single indirect branch shared by every op-code
+        Threaded, // each handler dispatches the next; only available if DS_THREADED_DISPATCH
+    };
+
+    inline constexpr dsEvaluateDispatch dsDefaultEvaluateDispatch =
+        DS_THREADED_DISPATCH ? dsEvaluateDispatch::Threaded : dsEvaluateDispatch::Switch;
+
+    struct dsByteCodeSummary
+    {
+        uint32_t instructionCount = 0;
+        uint32_t maxStack = 0;
+    };
+
+    /// Verifies and decodes an expression's byte code into fixed-width instructions. Every
+    /// operation must be known, every operand present and in range of the header, and the
+    /// stack must never underflow and must hold exactly the result at the end.
+    ///
+    /// Operands are only resolved if an assembly is provided; otherwise the byte code is
+    /// only verified and summarized, which allows sizing storage before the assembly is allocated.
+    [[nodiscard]] bool dsDecodeByteCode(dsAssemblyHeader const& header, dsAssembly const* assembly, uint8_t const* ops, uint32_t opsLen,
+        dsAssemblyInstruction* out_instructions, dsByteCodeSummary& out_summary) noexcept;
+
+    /// Occurrences of each op-code, and of each pair of adjacent op-codes, in a body of byte code.
+    /// Used to find the sequences which are worth fusing into superinstructions.
+    struct dsOpHistogram
+    {
+        static constexpr uint32_t opCount = static_cast<uint32_t>(dsOpCode::Last);
+
+        uint32_t ops[opCount] = {};
+        uint32_t pairs[opCount][opCount] = {};
+    };
+
+    /// Adds the op-codes of the byte code to the histogram. Fails on unknown op-codes or truncated
+    /// operands, having counted the op-codes before them.
+    [[nodiscard]] bool dsCountOpCodes(uint8_t const* ops, uint32_t opsLen, dsOpHistogram& histogram) noexcept;
+
+    /// Stack memory for expressions deeper than the interpreter's inline stack. It grows to the
+    /// deepest such expression evaluated with it and is kept, so deep expressions do not allocate
+    /// on every evaluation. Not thread-safe; each thread evaluating expressions needs its own.
+    class dsEvaluateScratch
+    {
+    public:
+        explicit dsEvaluateScratch(dsAllocator& alloc) noexcept : allocator_(&alloc) {}
+        dsEvaluateScratch(dsEvaluateScratch&& rhs) noexcept;
+        ~dsEvaluateScratch();
+
+        dsEvaluateScratch(dsEvaluateScratch const&) = delete;
+        dsEvaluateScratch& operator=(dsEvaluateScratch const&) = delete;
+
+        [[nodiscard]] dsAllocator& allocator() const noexcept { return *allocator_; }
+
+        /// Returns at least size bytes, or nullptr if the memory is already acquired or cannot
+        /// be grown. Must be released before it is acquired again.
+        [[nodiscard]] void* acquire(uint32_t size, uint32_t align) noexcept;
+        void release() noexcept;
+
+    private:
+        dsAllocator* allocator_ = nullptr;
+        void* memory_ = nullptr;
+        uint32_t size_ = 0;
+        uint32_t align_ = 0;
+        bool acquired_ = false;
+    };
+
+    /// Evaluates an expression decoded by dsLoadAssembly. The byte code has been verified, so
+    /// neither operands nor stack depth are checked. Expressions deeper than the interpreter's
+    /// inline stack take their stack from the scratch memory.
+    ///
+    /// Requesting threaded dispatch when DS_THREADED_DISPATCH is disabled falls back to the switch.
+    [[nodiscard]] bool dsEvaluateInstructions(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* variables, dsValueOut out_value,
+        dsEvaluateDispatch dispatch = dsDefaultEvaluateDispatch);
+
+    /// As above, over the packed variables of an instance, which typed reads load without checking their type.
+    [[nodiscard]] bool dsEvaluateInstructions(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* variables, dsValueOut out_value,
+        dsEvaluateDispatch dispatch = dsDefaultEvaluateDispatch);
+
+    /// Evaluates one decoded expression for each of count variable blocks, storing the result for
+    /// variables[i] in out_values[i]. Blocks are evaluated in groups of lanes, so that the int32,
+    /// float32, and bool operations of the expression run over the whole group at once.
+    ///
+    /// Stops at the first group which cannot be carried in lanes, such as one calling a function or
+    /// reading a value of another type, and returns the number of blocks evaluated before it. The
+    /// remaining blocks must be evaluated one at a time.
+    [[nodiscard]] uint32_t dsEvaluateLanes(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex,
+        dsValueStorage const* const* variables, uint32_t count, dsValueStorage* out_values) noexcept;
+    [[nodiscard]] uint32_t dsEvaluateLanes(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex,
+        dsPackedVariables const* const* variables, uint32_t count, dsValueStorage* out_values) noexcept;
+
+    /// As dsEvaluateLanes, but evaluates the blocks which cannot be carried in lanes one at a time,
+    /// with the same host for every block.
+    [[nodiscard]] bool dsEvaluateInstructionsBatch(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* const* variables, uint32_t count, dsValueStorage* out_values);
+    [[nodiscard]] bool dsEvaluateInstructionsBatch(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* const* variables, uint32_t count, dsValueStorage* out_values);
+
+    /// Evaluates an expression decoded by dsLoadAssembly on its fastest available tier. Counts the
+    /// evaluations of the expression and, once it is hot, compiles it to native code if possible.
+    [[nodiscard]] bool dsEvaluateExpression(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* variables, dsValueOut out_value);
+    [[nodiscard]] bool dsEvaluateExpression(dsEvaluateHost& host, dsEvaluateScratch& scratch, dsAssembly const& assembly,
+        dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* variables, dsValueOut out_value);
+
+#if DS_JIT
+    /// Compiles an expression to native code specialized to the types currently held by the
+    /// variables, and to the form they are held in. Fails if the expression uses an operation or type
+    /// the code generator does not support, such as function calls. Must not be called concurrently
+    /// for the same expression.
+    [[nodiscard]] bool dsJitCompile(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* variables,
+        dsJitExpression& jit) noexcept;
+    [[nodiscard]] bool dsJitCompile(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex,
+        dsPackedVariables const* variables, dsJitExpression& jit) noexcept;
+
+    /// Frees the native code of an expression, if any.
+    void dsJitRelease(dsJitExpression& jit) noexcept;
+#endif
+} // namespace descript
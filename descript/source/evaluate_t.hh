@@ -0,0 +1,653 @@
+// descript
+
+#pragma once
+
+#include "descript/context.hh"
+#include "descript/evaluate.hh"
+#include "descript/value.hh"
+
+#include "assert.hh"
+#include "ops.hh"
+#include "storage.hh"
+
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace descript {
+    /// Operations dsEvaluateT requires of its host. dsEvaluateHost provides them through virtual
+    /// calls; a concrete host provides them directly, so that they may be inlined.
+    template <typename HostT>
+    concept dsEvaluateHostType = requires(HostT& host, dsEmitterId emitterId, uint32_t index, dsValueOut out, dsFunctionContext& ctx) {
+        host.listen(emitterId);
+        { host.readConstant(index, out) } -> std::convertible_to<bool>;
+        { host.readVariable(index, out) } -> std::convertible_to<bool>;
+        { host.invokeFunction(index, ctx) } -> std::convertible_to<bool>;
+    };
+
+    namespace detail_ {
+        inline constexpr uint32_t s_stackSize = 32;
+
+        // the type of a stack cell, held in a byte beside it; the compiler emits op-codes typed for their
+        // operands, so only the op-codes which produce values from outside the stack record a tag
+        //
+        // the built-in scalar types are known by their tag alone, so their values move on and off the stack
+        // as plain copies; a value of any other type is boxed, and its type held in a side array
+        enum class CellTag : uint8_t
+        {
+            Nil,
+            Int32,
+            Float32,
+            Bool,
+            Boxed,
+        };
+
+        template <typename T>
+        inline constexpr CellTag cellTag = CellTag::Boxed;
+        template <>
+        inline constexpr CellTag cellTag<decltype(nullptr)> = CellTag::Nil;
+        template <>
+        inline constexpr CellTag cellTag<int32_t> = CellTag::Int32;
+        template <>
+        inline constexpr CellTag cellTag<float> = CellTag::Float32;
+        template <>
+        inline constexpr CellTag cellTag<bool> = CellTag::Bool;
+
+        inline CellTag cellTagOf(dsTypeMeta const& meta) noexcept
+        {
+            if (meta.typeId == dsType<int32_t>.typeId)
+                return CellTag::Int32;
+            if (meta.typeId == dsType<float>.typeId)
+                return CellTag::Float32;
+            if (meta.typeId == dsType<bool>.typeId)
+                return CellTag::Bool;
+            if (meta.typeId == dsType<decltype(nullptr)>.typeId)
+                return CellTag::Nil;
+            return CellTag::Boxed;
+        }
+
+        // boxed is only read for a boxed cell, as it is left unset for every other
+        inline dsTypeMeta const& cellMeta(CellTag tag, dsTypeMeta const* const& boxed) noexcept
+        {
+            switch (tag)
+            {
+            case CellTag::Nil: return dsType<decltype(nullptr)>;
+            case CellTag::Int32: return dsType<int32_t>;
+            case CellTag::Float32: return dsType<float>;
+            case CellTag::Bool: return dsType<bool>;
+            case CellTag::Boxed: break;
+            }
+            return *boxed;
+        }
+
+        inline void setCellType(CellTag& tag, dsTypeMeta const*& boxed, dsTypeMeta const& meta) noexcept
+        {
+            tag = cellTagOf(meta);
+            if (tag == CellTag::Boxed)
+                boxed = &meta;
+        }
+
+        struct Cell
+        {
+            alignas(void*) char storage[16];
+
+            template <typename T>
+            requires dsIsValue<T>
+            T& as() noexcept { return *static_cast<T*>(static_cast<void*>(storage)); }
+
+            template <typename T>
+            requires dsIsValue<T>
+            T const& as() const noexcept { return *static_cast<T const*>(static_cast<void const*>(storage)); }
+        };
+
+        // native functions address their arguments by this stride
+        static_assert(sizeof(Cell) == dsNativeArgStride);
+
+        struct CellOut
+        {
+            Cell& cell;
+            CellTag& tag;
+            dsTypeMeta const*& boxed;
+
+            bool accept(dsValueRef const& value) noexcept
+            {
+                dsTypeMeta const& meta = value.meta();
+                if (meta.size > sizeof(cell.storage))
+                    return false;
+                setCellType(tag, boxed, meta);
+
+                // scalars are trivially copyable, so only a boxed value needs its type's copy operation
+                if (tag != CellTag::Boxed)
+                    std::memcpy(cell.storage, value.pointer(), meta.size);
+                else
+                    meta.opCopyTo(cell.storage, value.pointer());
+                return true;
+            }
+
+            dsValueOut out() noexcept { return dsValueOut(&sink, this); }
+
+            static bool sink(dsTypeMeta const& typeMeta, void const* pointer, void* userData)
+            {
+                return static_cast<CellOut*>(userData)->accept(dsValueRef(typeMeta, pointer));
+            }
+        };
+
+        template <typename HostT>
+        class Context final : public dsFunctionContext
+        {
+        public:
+            Context(HostT& host, uint32_t argc, Cell const* argv, CellTag const* argTags, dsTypeMeta const* const* argBoxed,
+                dsValueStorage& result) noexcept
+                : host_(host), argc_(argc), argv_(argv), argTags_(argTags), argBoxed_(argBoxed), result_(result)
+            {
+            }
+
+            uint32_t getArgCount() const noexcept { return argc_; }
+            dsValueRef getArgValueAt(uint32_t index) const noexcept
+            {
+                DS_ASSERT(index < argc_);
+                return dsValueRef(cellMeta(argTags_[index], argBoxed_[index]), argv_[index].storage);
+            }
+
+            void result(dsValueRef const& result) override { result_ = dsValueStorage{result}; }
+
+            void listen(dsEmitterId emitterId) override { host_.listen(emitterId); }
+
+        private:
+            HostT& host_;
+            uint32_t argc_ = 0;
+            Cell const* argv_ = nullptr;
+            CellTag const* argTags_ = nullptr;
+            dsTypeMeta const* const* argBoxed_ = nullptr;
+            dsValueStorage& result_;
+        };
+
+        template <typename T>
+        constexpr bool IsArithmetic =
+            std::conjunction_v<std::is_arithmetic<T>, std::negation<std::is_same<T, bool>>>;
+
+        static_assert(IsArithmetic<int>);
+        static_assert(IsArithmetic<float>);
+        static_assert(!IsArithmetic<bool>);
+        static_assert(!IsArithmetic<char*>);
+        static_assert(!IsArithmetic<dsPlugKind>);
+
+        struct Neg
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T val) noexcept { return -val; }
+        };
+
+        struct Not
+        {
+            static constexpr bool apply(bool val) noexcept { return !val; }
+        };
+
+        struct And
+        {
+            static constexpr bool apply(bool left, bool right) noexcept { return left && right; }
+        };
+
+        struct Or
+        {
+            static constexpr bool apply(bool left, bool right) noexcept { return left || right; }
+        };
+
+        struct Xor
+        {
+            static constexpr bool apply(bool left, bool right) noexcept { return left ^ right; }
+        };
+
+        struct Add
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T left, T right) noexcept { return left + right; }
+        };
+
+        struct Sub
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T left, T right) noexcept { return left - right; }
+        };
+
+        struct Mul
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T left, T right) noexcept { return left * right; }
+        };
+
+        struct Div
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T left, T right) noexcept { return right != T{0} ? left / right : T{0}; }
+        };
+
+        struct Min
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T left, T right) noexcept { return left < right ? left : right; }
+        };
+
+        struct Max
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T left, T right) noexcept { return left > right ? left : right; }
+        };
+
+        // the magnitude of the most negative integer does not fit, so it wraps back to itself
+        struct Abs
+        {
+            static constexpr int32_t apply(int32_t val) noexcept
+            {
+                uint32_t const bits = static_cast<uint32_t>(val);
+                return static_cast<int32_t>(val < 0 ? 0u - bits : bits);
+            }
+            static float apply(float val) noexcept { return std::fabs(val); }
+        };
+
+        struct Floor
+        {
+            static float apply(float val) noexcept { return std::floor(val); }
+        };
+
+        struct Sqrt
+        {
+            static float apply(float val) noexcept { return std::sqrt(val); }
+        };
+
+        struct Clamp
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr T apply(T val, T low, T high) noexcept { return Min::apply(Max::apply(val, low), high); }
+        };
+
+        struct Lerp
+        {
+            static constexpr float apply(float from, float to, float t) noexcept { return from + (to - from) * t; }
+        };
+
+        struct Equal
+        {
+            template <typename T>
+            static constexpr bool apply(T left, T right) noexcept { return left == right; }
+        };
+
+        struct NotEqual
+        {
+            template <typename T>
+            static constexpr bool apply(T left, T right) noexcept { return left != right; }
+        };
+
+        struct Less
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr bool apply(T left, T right) noexcept { return left < right; }
+        };
+
+        struct LessEqual
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr bool apply(T left, T right) noexcept { return left <= right; }
+        };
+
+        struct Greater
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr bool apply(T left, T right) noexcept { return left > right; }
+        };
+
+        struct GreaterEqual
+        {
+            template <typename T>
+            requires IsArithmetic<T>
+            static constexpr bool apply(T left, T right) noexcept { return left >= right; }
+        };
+
+        // reads the big-endian 16-bit operand following the op-code at ip, leaving ip on its last byte
+        inline bool readOperand16(uint8_t const*& ip, uint8_t const* opsEnd, uint16_t& out_value) noexcept
+        {
+            if (opsEnd - ip < 3)
+                return false;
+            out_value = static_cast<uint16_t>(ip[1] << 8 | ip[2]);
+            ip += 2;
+            return true;
+        }
+    } // namespace detail_
+
+#define DS_CHECKTOP()            \
+    if (stackTop >= s_stackSize) \
+        return false;            \
+    else                         \
+        ;
+
+#define DS_PUSH(type, val)                    \
+    if (true)                                 \
+    {                                         \
+        DS_CHECKTOP()                         \
+        tags[stackTop] = cellTag<type>;       \
+        stack[stackTop++].as<type>() = (val); \
+    }                                         \
+    else                                      \
+        ;
+
+// the result of a typed operator has the type of its operands, so the type of the cell is left untouched
+#define DS_UNOP(op, type)                             \
+    {                                                 \
+        if (stackTop == 0)                            \
+            return false;                             \
+        type& value = stack[stackTop - 1].as<type>(); \
+        value = op::apply(value);                     \
+    }
+
+#define DS_BINOP(op, type)                               \
+    {                                                    \
+        if (stackTop < 2)                                \
+            return false;                                \
+        type const right = stack[--stackTop].as<type>(); \
+        type& left = stack[stackTop - 1].as<type>();     \
+        left = op::apply(left, right);                   \
+    }
+
+#define DS_TERNOP(op, type)                                \
+    {                                                      \
+        if (stackTop < 3)                                  \
+            return false;                                  \
+        stackTop -= 2;                                     \
+        type const second = stack[stackTop].as<type>();    \
+        type const third = stack[stackTop + 1].as<type>(); \
+        type& first = stack[stackTop - 1].as<type>();      \
+        first = op::apply(first, second, third);           \
+    }
+
+// the result of a comparison is a boolean, whatever the type of its operands
+#define DS_CMPOP(op, type)                                                    \
+    {                                                                         \
+        if (stackTop < 2)                                                     \
+            return false;                                                     \
+        type const right = stack[--stackTop].as<type>();                      \
+        bool const result = op::apply(stack[stackTop - 1].as<type>(), right); \
+        stack[stackTop - 1].as<bool>() = result;                              \
+        tags[stackTop - 1] = CellTag::Bool;                                   \
+    }
+
+// leaves ip on the last operand byte of the jump, or of its target if it is taken, as the loop steps past it
+#define DS_JUMP_IF(condition)                                               \
+    {                                                                       \
+        uint16_t offset = 0;                                                \
+        if (!readOperand16(ip, opsEnd, offset) || offset > opsEnd - ip - 1) \
+            return false;                                                   \
+        if (condition)                                                      \
+            ip += offset;                                                   \
+    }
+
+#define DS_READ(index)                                                                         \
+    {                                                                                          \
+        DS_CHECKTOP()                                                                          \
+        CellOut out{.cell = stack[stackTop], .tag = tags[stackTop], .boxed = boxed[stackTop]}; \
+        if (!host.readVariable((index), out.out()))                                            \
+            return false;                                                                      \
+        ++stackTop;                                                                            \
+    }
+
+// superinstructions read their right operand into the slot above the left one, as the fused Read would
+#define DS_BINOP_READ(op, type)                                                                \
+    {                                                                                          \
+        uint16_t index = 0;                                                                    \
+        if (!readOperand16(ip, opsEnd, index) || stackTop == 0)                                \
+            return false;                                                                      \
+        DS_CHECKTOP()                                                                          \
+        CellOut out{.cell = stack[stackTop], .tag = tags[stackTop], .boxed = boxed[stackTop]}; \
+        if (!host.readVariable(index, out.out()))                                              \
+            return false;                                                                      \
+        type& left = stack[stackTop - 1].as<type>();                                           \
+        left = op::apply(left, stack[stackTop].as<type>());                                    \
+    }
+
+#define DS_BINOP_IMM(op)                                                             \
+    {                                                                                \
+        uint16_t operand = 0;                                                        \
+        if (!readOperand16(ip, opsEnd, operand) || stackTop == 0)                    \
+            return false;                                                            \
+        int32_t& left = stack[stackTop - 1].as<int32_t>();                           \
+        left = op::apply(left, static_cast<int32_t>(static_cast<int16_t>(operand))); \
+    }
+
+    /// Evaluates byte code over any host, checking every operand and the stack as dsEvaluate does.
+    /// dsEvaluate is this evaluator instantiated over dsEvaluateHost.
+    template <dsEvaluateHostType HostT>
+    [[nodiscard]] bool dsEvaluateT(HostT& host, uint8_t const* ops, uint32_t opsLen, dsValueOut out_value)
+    {
+        using namespace detail_;
+
+        DS_GUARD_OR(ops != nullptr, false);
+        DS_GUARD_OR(opsLen > 0, false);
+
+        uint8_t const* const opsEnd = ops + opsLen;
+
+        Cell stack[s_stackSize];
+        CellTag tags[s_stackSize];
+        dsTypeMeta const* boxed[s_stackSize];
+        uint32_t stackTop = 0;
+
+        for (uint8_t const* ip = ops; ip != opsEnd; ++ip)
+        {
+            switch (dsOpCode(*ip))
+            {
+            case dsOpCode::Nop: break;
+            case dsOpCode::PushTrue: DS_PUSH(bool, true); break;
+            case dsOpCode::PushFalse: DS_PUSH(bool, false); break;
+            case dsOpCode::PushNil: DS_PUSH(decltype(nullptr), nullptr); break;
+            case dsOpCode::Push0: DS_PUSH(int32_t, 0); break;
+            case dsOpCode::Push1: DS_PUSH(int32_t, 1); break;
+            case dsOpCode::Push2: DS_PUSH(int32_t, 2); break;
+            case dsOpCode::PushNeg1: DS_PUSH(int32_t, -1); break;
+            case dsOpCode::PushS8:
+                if (++ip == opsEnd)
+                    return false;
+                DS_PUSH(int32_t, static_cast<int32_t>(static_cast<int8_t>(*ip)));
+                break;
+            case dsOpCode::PushU8:
+                if (++ip == opsEnd)
+                    return false;
+                DS_PUSH(int32_t, static_cast<int32_t>(*ip));
+                break;
+            case dsOpCode::PushS16: {
+                if (++ip == opsEnd)
+                    return false;
+                uint16_t value = *ip << 8;
+                if (++ip == opsEnd)
+                    return false;
+                value |= *ip;
+                DS_PUSH(int32_t, static_cast<int32_t>(static_cast<int16_t>(value)));
+                break;
+            }
+            case dsOpCode::PushU16: {
+                if (++ip == opsEnd)
+                    return false;
+                uint16_t value = *ip << 8;
+                if (++ip == opsEnd)
+                    return false;
+                value |= *ip;
+                DS_PUSH(int32_t, static_cast<int32_t>(value));
+                break;
+            }
+            case dsOpCode::PushConstant: {
+                if (++ip == opsEnd)
+                    return false;
+                uint16_t index = *ip << 8;
+
+                if (++ip == opsEnd)
+                    return false;
+                index |= *ip;
+                DS_CHECKTOP();
+                CellOut out{.cell = stack[stackTop], .tag = tags[stackTop], .boxed = boxed[stackTop]};
+                if (!host.readConstant(index, out.out()))
+                    return false;
+                ++stackTop;
+                break;
+            }
+            case dsOpCode::Read:
+            case dsOpCode::ReadI32:
+            case dsOpCode::ReadF32:
+            case dsOpCode::ReadB: {
+                if (++ip == opsEnd)
+                    return false;
+                uint16_t index = *ip << 8;
+                if (++ip == opsEnd)
+                    return false;
+                index |= *ip;
+                DS_CHECKTOP();
+                CellOut out{.cell = stack[stackTop], .tag = tags[stackTop], .boxed = boxed[stackTop]};
+                if (!host.readVariable(index, out.out()))
+                    return false;
+                ++stackTop;
+                break;
+            }
+            case dsOpCode::Call: {
+                if (++ip == opsEnd)
+                    return false;
+                uint16_t index = *ip << 8;
+                if (++ip == opsEnd)
+                    return false;
+                index |= *ip;
+                if (++ip == opsEnd)
+                    return false;
+                uint8_t argc = *ip;
+                if (argc > stackTop)
+                    return false;
+
+                dsValueStorage result;
+                uint32_t const stackArgOffset = stackTop - argc;
+                Context<HostT> ctx(host, argc, &stack[stackArgOffset], &tags[stackArgOffset], &boxed[stackArgOffset], result);
+                if (!host.invokeFunction(index, ctx))
+                    return false;
+
+                stackTop -= argc;
+                DS_CHECKTOP();
+                CellOut out{.cell = stack[stackTop], .tag = tags[stackTop], .boxed = boxed[stackTop]};
+                if (!out.accept(result.ref()))
+                    return false;
+                ++stackTop;
+                break;
+            }
+            case dsOpCode::NegI32: DS_UNOP(Neg, int32_t); break;
+            case dsOpCode::NegF32: DS_UNOP(Neg, float); break;
+            case dsOpCode::NotB: DS_UNOP(Not, bool); break;
+            case dsOpCode::AddI32: DS_BINOP(Add, int32_t); break;
+            case dsOpCode::AddF32: DS_BINOP(Add, float); break;
+            case dsOpCode::SubI32: DS_BINOP(Sub, int32_t); break;
+            case dsOpCode::SubF32: DS_BINOP(Sub, float); break;
+            case dsOpCode::MulI32: DS_BINOP(Mul, int32_t); break;
+            case dsOpCode::MulF32: DS_BINOP(Mul, float); break;
+            case dsOpCode::DivI32: DS_BINOP(Div, int32_t); break;
+            case dsOpCode::DivF32: DS_BINOP(Div, float); break;
+            case dsOpCode::AndB: DS_BINOP(And, bool); break;
+            case dsOpCode::OrB: DS_BINOP(Or, bool); break;
+            case dsOpCode::XorB: DS_BINOP(Xor, bool); break;
+            case dsOpCode::MinI32: DS_BINOP(Min, int32_t); break;
+            case dsOpCode::MinF32: DS_BINOP(Min, float); break;
+            case dsOpCode::MaxI32: DS_BINOP(Max, int32_t); break;
+            case dsOpCode::MaxF32: DS_BINOP(Max, float); break;
+            case dsOpCode::AbsI32: DS_UNOP(Abs, int32_t); break;
+            case dsOpCode::AbsF32: DS_UNOP(Abs, float); break;
+            case dsOpCode::FloorF32: DS_UNOP(Floor, float); break;
+            case dsOpCode::SqrtF32: DS_UNOP(Sqrt, float); break;
+            case dsOpCode::ClampI32: DS_TERNOP(Clamp, int32_t); break;
+            case dsOpCode::ClampF32: DS_TERNOP(Clamp, float); break;
+            case dsOpCode::LerpF32: DS_TERNOP(Lerp, float); break;
+            case dsOpCode::EqI32: DS_CMPOP(Equal, int32_t); break;
+            case dsOpCode::EqF32: DS_CMPOP(Equal, float); break;
+            case dsOpCode::EqB: DS_CMPOP(Equal, bool); break;
+            case dsOpCode::NeI32: DS_CMPOP(NotEqual, int32_t); break;
+            case dsOpCode::NeF32: DS_CMPOP(NotEqual, float); break;
+            case dsOpCode::NeB: DS_CMPOP(NotEqual, bool); break;
+            case dsOpCode::LtI32: DS_CMPOP(Less, int32_t); break;
+            case dsOpCode::LtF32: DS_CMPOP(Less, float); break;
+            case dsOpCode::LeI32: DS_CMPOP(LessEqual, int32_t); break;
+            case dsOpCode::LeF32: DS_CMPOP(LessEqual, float); break;
+            case dsOpCode::GtI32: DS_CMPOP(Greater, int32_t); break;
+            case dsOpCode::GtF32: DS_CMPOP(Greater, float); break;
+            case dsOpCode::GeI32: DS_CMPOP(GreaterEqual, int32_t); break;
+            case dsOpCode::GeF32: DS_CMPOP(GreaterEqual, float); break;
+            case dsOpCode::Select: {
+                if (stackTop < 3)
+                    return false;
+                stackTop -= 2;
+                uint32_t const chosen = stack[stackTop - 1].as<bool>() ? stackTop : stackTop + 1;
+                stack[stackTop - 1] = stack[chosen];
+                tags[stackTop - 1] = tags[chosen];
+                if (tags[chosen] == CellTag::Boxed)
+                    boxed[stackTop - 1] = boxed[chosen];
+                break;
+            }
+            case dsOpCode::Jump: DS_JUMP_IF(true); break;
+            case dsOpCode::JumpIfFalse: {
+                if (stackTop == 0)
+                    return false;
+                bool const condition = stack[--stackTop].as<bool>();
+                DS_JUMP_IF(!condition);
+                break;
+            }
+            case dsOpCode::JumpIfFalseOrPop:
+            case dsOpCode::JumpIfTrueOrPop: {
+                if (stackTop == 0)
+                    return false;
+                // a condition which decides the operator is its result, and is discarded otherwise
+                bool const decided = stack[stackTop - 1].as<bool>() == (dsOpCode(*ip) == dsOpCode::JumpIfTrueOrPop);
+                if (!decided)
+                    --stackTop;
+                DS_JUMP_IF(decided);
+                break;
+            }
+            case dsOpCode::ReadRead: {
+                uint16_t first = 0;
+                uint16_t second = 0;
+                if (!readOperand16(ip, opsEnd, first) || !readOperand16(ip, opsEnd, second))
+                    return false;
+                DS_READ(first);
+                DS_READ(second);
+                break;
+            }
+            case dsOpCode::AddReadI32: DS_BINOP_READ(Add, int32_t); break;
+            case dsOpCode::AddReadF32: DS_BINOP_READ(Add, float); break;
+            case dsOpCode::SubReadI32: DS_BINOP_READ(Sub, int32_t); break;
+            case dsOpCode::SubReadF32: DS_BINOP_READ(Sub, float); break;
+            case dsOpCode::MulReadI32: DS_BINOP_READ(Mul, int32_t); break;
+            case dsOpCode::MulReadF32: DS_BINOP_READ(Mul, float); break;
+            case dsOpCode::AddImmI32: DS_BINOP_IMM(Add); break;
+            case dsOpCode::SubImmI32: DS_BINOP_IMM(Sub); break;
+            case dsOpCode::MulImmI32: DS_BINOP_IMM(Mul); break;
+            default: return false;
+            }
+        }
+
+        if (stackTop != 1)
+            return false;
+
+        return out_value.accept(cellMeta(tags[0], boxed[0]), stack[0].storage);
+    }
+
+#undef DS_CHECKTOP
+#undef DS_PUSH
+#undef DS_UNOP
+#undef DS_BINOP
+#undef DS_TERNOP
+#undef DS_CMPOP
+#undef DS_JUMP_IF
+#undef DS_READ
+#undef DS_BINOP_READ
+#undef DS_BINOP_IMM
+} // namespace descript
@@ -2,14 +2,17 @@
 
 #include "descript/expression_compiler.hh"
 
+#include "descript/context.hh"
 #include "descript/evaluate.hh"
 #include "descript/meta.hh"
 #include "descript/value.hh"
 
 #include "array.hh"
+#include "evaluate_t.hh"
 #include "fnv.hh"
 #include "index.hh"
 #include "ops.hh"
+#include "storage.hh"
 #include "string.hh"
 #include "utility.hh"
 
@@ -35,7 +38,8 @@ namespace {
             ++second;
             --maxLen;
         }
-        return maxLen == 0;
+        // the keyword must be matched in full, not just as a prefix of the identifier
+        return maxLen == 0 && *first == '\0';
     }
 } // namespace
 
@@ -46,11 +50,96 @@ namespace descript {
     static constexpr dsTypeId NilTypeId = dsType<decltype(nullptr)>.typeId;
 
     namespace {
+        // collects the byte code of an expression so that it may be rewritten before it reaches the
+        // host's builder; constants, functions, and variables are still resolved by the host's builder
+        class ByteCodeBuffer final : public dsExpressionBuilder
+        {
+        public:
+            ByteCodeBuffer(dsExpressionBuilder& builder, dsArray<uint8_t>& byteCode) noexcept : builder_(builder), byteCode_(byteCode) {}
+
+            void pushOp(uint8_t byte) override { byteCode_.pushBack(byte); }
+
+            uint32_t pushConstant(dsValueRef const& value) override { return builder_.pushConstant(value); }
+            uint32_t pushFunction(dsFunctionId functionId) override { return builder_.pushFunction(functionId); }
+            uint32_t pushVariable(uint64_t nameHash) override { return builder_.pushVariable(nameHash); }
+
+        private:
+            dsExpressionBuilder& builder_;
+            dsArray<uint8_t>& byteCode_;
+        };
+
+        // measures the byte code of a subexpression, so that a jump over it may be emitted ahead of it; constants,
+        // functions, and variables are left for the host's builder to resolve when the code is generated for real
+        class ByteCodeSize final : public dsExpressionBuilder
+        {
+        public:
+            void pushOp(uint8_t byte) override { ++size_; }
+
+            uint32_t pushConstant(dsValueRef const& value) override { return 0; }
+            uint32_t pushFunction(dsFunctionId functionId) override { return 0; }
+            uint32_t pushVariable(uint64_t nameHash) override { return 0; }
+
+            uint32_t size() const noexcept { return size_; }
+
+        private:
+            uint32_t size_ = 0;
+        };
+
+        // math functions compiled to op-codes rather than to host calls, typed by their (homogenous) arguments;
+        // Last marks a type the intrinsic does not accept, and Nop one for which it is the identity
+        struct IntrinsicMap
+        {
+            char const* name = nullptr;
+            uint8_t arity = 0;
+            dsOpCode opI32 = dsOpCode::Last;
+            dsOpCode opF32 = dsOpCode::Last;
+        };
+
+        constexpr IntrinsicMap intrinsics[] = {
+            {"min", 2, dsOpCode::MinI32, dsOpCode::MinF32},
+            {"max", 2, dsOpCode::MaxI32, dsOpCode::MaxF32},
+            {"clamp", 3, dsOpCode::ClampI32, dsOpCode::ClampF32},
+            {"abs", 1, dsOpCode::AbsI32, dsOpCode::AbsF32},
+            {"floor", 1, dsOpCode::Nop, dsOpCode::FloorF32},
+            {"sqrt", 1, dsOpCode::Last, dsOpCode::SqrtF32},
+            {"lerp", 3, dsOpCode::Last, dsOpCode::LerpF32},
+        };
+
+        // calls a pure function with constant arguments during optimization
+        class FoldContext final : public dsFunctionContext
+        {
+        public:
+            static constexpr uint32_t maxArgs = 8;
+
+            FoldContext(dsValueStorage const* args, uint32_t argCount) noexcept : args_(args), argCount_(argCount) {}
+
+            uint32_t getArgCount() const noexcept override { return argCount_; }
+            dsValueRef getArgValueAt(uint32_t index) const noexcept override
+            {
+                DS_ASSERT(index < argCount_);
+                return args_[index].ref();
+            }
+
+            void result(dsValueRef const& result) override { result_ = dsValueStorage{result}; }
+
+            void listen(dsEmitterId emitterId) override { listened_ = true; }
+
+            dsValueStorage const& value() const noexcept { return result_; }
+            bool listened() const noexcept { return listened_; }
+
+        private:
+            dsValueStorage const* args_ = nullptr;
+            uint32_t argCount_ = 0;
+            dsValueStorage result_;
+            bool listened_ = false;
+        };
+
         class ExpressionCompiler final : public dsExpressionCompiler
         {
         public:
             explicit ExpressionCompiler(dsAllocator& alloc, dsExpressionCompilerHost& host) noexcept
-                : allocator_(alloc), host_(host), tokens_(alloc), ast_(alloc), astLinks_(alloc), expression_(alloc)
+                : allocator_(alloc), host_(host), tokens_(alloc), ast_(alloc), astLinks_(alloc), expression_(alloc),
+                  byteCode_(alloc)
             {
             }
 
@@ -62,7 +151,9 @@ namespace descript {
             bool isEmpty() const noexcept override;
             bool isConstant() const noexcept override;
             bool isVariableOnly() const noexcept override;
+            bool isVolatile() const noexcept override;
             dsTypeId resultType() const noexcept override;
+            uint32_t maxStackDepth() const noexcept override;
 
             bool asConstant(dsValueOut out_value) const override;
 
@@ -85,6 +176,12 @@ namespace descript {
                 LParen,
                 RParen,
                 Comma,
+                Equal,
+                NotEqual,
+                Less,
+                LessEqual,
+                Greater,
+                GreaterEqual,
                 LiteralInt,
                 Identifier,
                 KeyTrue,
@@ -116,6 +213,8 @@ namespace descript {
                 Constant,
                 Variable,
                 Function,
+                Intrinsic,
+                Select,
             };
 
             enum class Operator
@@ -133,6 +232,14 @@ namespace descript {
                 Or,
                 Xor,
 
+                // binary comparison
+                Equal,
+                NotEqual,
+                Less,
+                LessEqual,
+                Greater,
+                GreaterEqual,
+
                 // unary arithmetic
                 Negate,
 
@@ -200,9 +307,21 @@ namespace descript {
                     struct Function
                     {
                         dsFunctionId functionId = dsInvalidFunctionId;
+                        AstIndex targetIndex = dsInvalidIndex; // the identifier naming the function
                         AstLinkIndex firstArgIndex = dsInvalidIndex;
                         uint8_t arity = 0;
                     } function;
+                    struct Intrinsic
+                    {
+                        dsOpCode op = dsOpCode::Nop;
+                        AstLinkIndex firstArgIndex = dsInvalidIndex;
+                    } intrinsic;
+                    struct Select
+                    {
+                        AstIndex conditionIndex = dsInvalidIndex;
+                        AstIndex trueIndex = dsInvalidIndex;
+                        AstIndex falseIndex = dsInvalidIndex;
+                    } select;
                 } data;
             };
 
@@ -240,8 +359,22 @@ namespace descript {
             bool tokenize();
             AstIndex parse();
             LowerResult lower(AstIndex astIndex);
+            LowerResult lowerIntrinsic(AstIndex astIndex, IntrinsicMap const& intrinsic, AstLinkIndex firstArgIndex, uint8_t arity);
+            LowerResult lowerSelect(AstIndex astIndex, AstLinkIndex firstArgIndex, uint8_t arity);
             AstIndex optimize(AstIndex astIndex);
+            void fold(AstIndex astIndex);
+            void foldIntrinsic(AstIndex astIndex);
+            static bool compareConstants(Operator op, Ast const& left, Ast const& right, bool& out_result) noexcept;
+            bool isNamed(AstIndex targetIndex, char const* name) const noexcept;
+            IntrinsicMap const* lookupIntrinsic(AstIndex targetIndex) const noexcept;
+            bool lookupFunction(AstIndex targetIndex, dsFunctionCompileMeta& out_functionMeta) const;
+            bool acceptsArguments(dsFunctionSignature const& signature, AstLinkIndex firstArgIndex, uint8_t arity) const;
             bool generate(AstIndex astIndex, dsExpressionBuilder& builder) const;
+            bool generateJump(dsOpCode op, uint32_t offset, dsExpressionBuilder& builder) const;
+            uint32_t measure(AstIndex astIndex) const;
+            bool invokesFunction(AstIndex astIndex) const noexcept;
+            void fuse(dsExpressionBuilder& builder) const;
+            uint32_t stackDepth(AstIndex astIndex) const noexcept;
 
             static Precedence unaryPrecedence(TokenType token) noexcept;
             static Precedence binaryPrecedence(TokenType token) noexcept;
@@ -254,9 +387,11 @@ namespace descript {
             dsArray<Ast, AstIndex> ast_;
             dsArray<AstLink, AstLinkIndex> astLinks_;
             dsString expression_;
+            dsArray<uint8_t> byteCode_;
             TokenIndex nextToken_ = dsInvalidIndex;
             AstIndex astRoot_ = dsInvalidIndex;
             Status status_ = Status::Reset;
+            bool callsVolatile_ = false;
         };
     } // namespace
 
@@ -285,6 +420,7 @@ namespace descript {
         nextToken_ = dsInvalidIndex;
         astRoot_ = dsInvalidIndex;
         status_ = Status::Reset;
+        callsVolatile_ = false;
     }
 
     bool ExpressionCompiler::compile(char const* expression, char const* expressionEnd)
@@ -339,9 +475,16 @@ namespace descript {
         if (astRoot_ == dsInvalidIndex)
             return true;
 
-        if (!generate(astRoot_, builder))
+        if (status_ != Status::Optimized)
+            return generate(astRoot_, builder);
+
+        // optimized byte code goes through the peephole pass before it reaches the builder
+        byteCode_.clear();
+        ByteCodeBuffer buffer(builder, byteCode_);
+        if (!generate(astRoot_, buffer))
             return false;
 
+        fuse(builder);
         return true;
     }
 
@@ -362,6 +505,20 @@ namespace descript {
             {.match = '(', .type = TokenType::LParen},
             {.match = ')', .type = TokenType::RParen},
             {.match = ',', .type = TokenType::Comma},
+            {.match = '<', .type = TokenType::Less},
+            {.match = '>', .type = TokenType::Greater},
+        };
+
+        // matched ahead of the single characters, which are their prefixes
+        constexpr struct PairTokenMap
+        {
+            char const* match;
+            TokenType type;
+        } pairTokenMap[] = {
+            {.match = "==", .type = TokenType::Equal},
+            {.match = "!=", .type = TokenType::NotEqual},
+            {.match = "<=", .type = TokenType::LessEqual},
+            {.match = ">=", .type = TokenType::GreaterEqual},
         };
 
         constexpr struct KeywordMap
@@ -416,6 +573,19 @@ namespace descript {
             // handle operations
             {
                 bool matched = false;
+                for (PairTokenMap const& item : pairTokenMap)
+                {
+                    if (inputEnd - input >= 2 && item.match[0] == input[0] && item.match[1] == input[1])
+                    {
+                        tokens_.pushBack(Token{.offset = offset, .length = 2, .type = item.type});
+                        input += 2;
+                        matched = true;
+                        break;
+                    }
+                }
+                if (matched)
+                    continue;
+
                 for (TokenMap const& item : tokenMap)
                 {
                     if (item.match == *input)
@@ -503,8 +673,8 @@ namespace descript {
     {
         switch (token)
         {
-        case TokenType::Minus: return {.op = Operator::Negate, .power = 5};
-        case TokenType::KeyNot: return {.op = Operator::Not, .power = 5};
+        case TokenType::Minus: return {.op = Operator::Negate, .power = 6};
+        case TokenType::KeyNot: return {.op = Operator::Not, .power = 6};
         case TokenType::LParen: return {.op = Operator::Group, .power = 0};
         default: return {};
         }
@@ -517,11 +687,18 @@ namespace descript {
         case TokenType::KeyOr: return {.op = Operator::Or, .power = 1};
         case TokenType::KeyXor: return {.op = Operator::Xor, .power = 1};
         case TokenType::KeyAnd: return {.op = Operator::And, .power = 2};
-        case TokenType::Plus: return {.op = Operator::Add, .power = 3};
-        case TokenType::Minus: return {.op = Operator::Sub, .power = 3};
-        case TokenType::Star: return {.op = Operator::Mul, .power = 4};
-        case TokenType::Slash: return {.op = Operator::Div, .power = 4};
-        case TokenType::LParen: return {.op = Operator::Call, .power = 6};
+        case TokenType::Equal:
+        case TokenType::KeyIs: return {.op = Operator::Equal, .power = 3};
+        case TokenType::NotEqual: return {.op = Operator::NotEqual, .power = 3};
+        case TokenType::Less: return {.op = Operator::Less, .power = 3};
+        case TokenType::LessEqual: return {.op = Operator::LessEqual, .power = 3};
+        case TokenType::Greater: return {.op = Operator::Greater, .power = 3};
+        case TokenType::GreaterEqual: return {.op = Operator::GreaterEqual, .power = 3};
+        case TokenType::Plus: return {.op = Operator::Add, .power = 4};
+        case TokenType::Minus: return {.op = Operator::Sub, .power = 4};
+        case TokenType::Star: return {.op = Operator::Mul, .power = 5};
+        case TokenType::Slash: return {.op = Operator::Div, .power = 5};
+        case TokenType::LParen: return {.op = Operator::Call, .power = 7};
         default: return {};
         }
     }
@@ -757,7 +934,22 @@ namespace descript {
             case Operator::Or:
             case Operator::Xor:
                 ast.valueType = BoolTypeId;
-                if (ast.valueType != BoolTypeId)
+                if (ast_[leftIndex].valueType != BoolTypeId)
+                    return {false, astIndex}; // FIXME: error on type
+                return {success, astIndex};
+            case Operator::Equal:
+            case Operator::NotEqual:
+                ast.valueType = BoolTypeId;
+                if (ast_[leftIndex].valueType != Float32TypeId && ast_[leftIndex].valueType != Int32TypeId &&
+                    ast_[leftIndex].valueType != BoolTypeId)
+                    return {false, astIndex}; // FIXME: error on type
+                return {success, astIndex};
+            case Operator::Less:
+            case Operator::LessEqual:
+            case Operator::Greater:
+            case Operator::GreaterEqual:
+                ast.valueType = BoolTypeId;
+                if (ast_[leftIndex].valueType != Float32TypeId && ast_[leftIndex].valueType != Int32TypeId)
                     return {false, astIndex}; // FIXME: error on type
                 return {success, astIndex};
             default: DS_GUARD_OR(false, LowerResult(false, astIndex), "Unknown unary operator");
@@ -792,12 +984,16 @@ namespace descript {
                 return {false, astIndex};
             }
 
-            Token const& identToken = tokens_[target.primaryTokenIndex];
-            char const* const identStart = expression_.data() + identToken.offset.value();
-            char const* const identEnd = identStart + identToken.length;
+            AstIndex const targetIndex = ast_[astIndex].data.call.targetIndex;
 
+            // a host function takes precedence over select or an intrinsic of the same name, so that
+            // adding a built-in never changes the meaning of an expression which calls the host's
             dsFunctionCompileMeta meta;
-            if (!host_.lookupFunction(dsName{identStart, identEnd}, meta))
+            bool const isFunction = lookupFunction(targetIndex, meta);
+            bool const isSelect = !isFunction && isNamed(targetIndex, "select");
+            IntrinsicMap const* const intrinsic = isFunction || isSelect ? nullptr : lookupIntrinsic(targetIndex);
+
+            if (!isFunction && !isSelect && intrinsic == nullptr)
             {
                 // FIXME: error, invalid function
                 return {false, astIndex};
@@ -826,16 +1022,127 @@ namespace descript {
                 ++arity;
             }
 
+            if (isSelect)
+            {
+                auto const [selectSuccess, selectIndex] = lowerSelect(astIndex, firstArgIndex, arity);
+                return {success && selectSuccess, selectIndex};
+            }
+
+            if (intrinsic != nullptr)
+            {
+                auto const [intrinsicSuccess, intrinsicIndex] = lowerIntrinsic(astIndex, *intrinsic, firstArgIndex, arity);
+                return {success && intrinsicSuccess, intrinsicIndex};
+            }
+
+            // native adapters read their arguments without checking them, so the signature must be honoured
+            dsTypeId returnType = meta.returnType;
+            if (meta.signature != nullptr)
+            {
+                dsFunctionSignature const* signature = meta.signature;
+                while (signature != nullptr && !acceptsArguments(*signature, firstArgIndex, arity))
+                    signature = signature->next;
+                if (signature == nullptr)
+                    return {false, astIndex}; // FIXME: error on type
+                returnType = signature->returnType;
+            }
+
+            if (meta.isVolatile)
+                callsVolatile_ = true;
+
             Ast& ast = ast_[astIndex];
             ast.type = AstType::Call;
-            ast.valueType = meta.returnType;
+            ast.valueType = returnType;
             ast.data = {.function = {.functionId = meta.functionId, .firstArgIndex = firstArgIndex, .arity = arity}};
+            ast.data.function.targetIndex = targetIndex;
             return {success, astIndex};
         }
         default: DS_GUARD_OR(false, LowerResult(false, dsInvalidIndex), "Unknown ast node type");
         }
     }
 
+    auto ExpressionCompiler::lowerIntrinsic(AstIndex astIndex, IntrinsicMap const& intrinsic, AstLinkIndex firstArgIndex, uint8_t arity)
+        -> LowerResult
+    {
+        if (arity != intrinsic.arity)
+            return {false, astIndex}; // FIXME: error on arity
+
+        // every argument has the type of the first, for which the intrinsic must have an op-code
+        dsTypeId const valueType = ast_[astLinks_[firstArgIndex].childIndex].valueType;
+        for (AstLinkIndex linkIndex = firstArgIndex; linkIndex != dsInvalidIndex; linkIndex = astLinks_[linkIndex].nextIndex)
+            if (ast_[astLinks_[linkIndex].childIndex].valueType != valueType)
+                return {false, astIndex}; // FIXME: error on type
+
+        dsOpCode op = dsOpCode::Last;
+        if (valueType == Int32TypeId)
+            op = intrinsic.opI32;
+        else if (valueType == Float32TypeId)
+            op = intrinsic.opF32;
+        if (op == dsOpCode::Last)
+            return {false, astIndex}; // FIXME: error on type
+
+        Ast& ast = ast_[astIndex];
+        ast.type = AstType::Intrinsic;
+        ast.valueType = valueType;
+        ast.data = {.intrinsic = {.op = op, .firstArgIndex = firstArgIndex}};
+        return {true, astIndex};
+    }
+
+    auto ExpressionCompiler::lowerSelect(AstIndex astIndex, AstLinkIndex firstArgIndex, uint8_t arity) -> LowerResult
+    {
+        if (arity != 3)
+            return {false, astIndex}; // FIXME: error on arity
+
+        AstLinkIndex const trueLinkIndex = astLinks_[firstArgIndex].nextIndex;
+        AstIndex const conditionIndex = astLinks_[firstArgIndex].childIndex;
+        AstIndex const trueIndex = astLinks_[trueLinkIndex].childIndex;
+        AstIndex const falseIndex = astLinks_[astLinks_[trueLinkIndex].nextIndex].childIndex;
+
+        if (ast_[conditionIndex].valueType != BoolTypeId || ast_[trueIndex].valueType != ast_[falseIndex].valueType)
+            return {false, astIndex}; // FIXME: error on type
+
+        Ast& ast = ast_[astIndex];
+        ast.type = AstType::Select;
+        ast.valueType = ast_[trueIndex].valueType;
+        ast.data = {.select = {.conditionIndex = conditionIndex, .trueIndex = trueIndex, .falseIndex = falseIndex}};
+        return {true, astIndex};
+    }
+
+    bool ExpressionCompiler::acceptsArguments(dsFunctionSignature const& signature, AstLinkIndex firstArgIndex, uint8_t arity) const
+    {
+        if (signature.paramCount != arity)
+            return false;
+
+        uint32_t paramIndex = 0;
+        for (AstLinkIndex linkIndex = firstArgIndex; linkIndex != dsInvalidIndex; linkIndex = astLinks_[linkIndex].nextIndex)
+            if (ast_[astLinks_[linkIndex].childIndex].valueType != signature.paramTypes[paramIndex++])
+                return false;
+        return true;
+    }
+
+    // built-in names are matched without regard to case, as keywords are
+    bool ExpressionCompiler::isNamed(AstIndex targetIndex, char const* name) const noexcept
+    {
+        Token const& identToken = tokens_[ast_[targetIndex].primaryTokenIndex];
+        return strCaseEqual(name, expression_.data() + identToken.offset.value(), identToken.length);
+    }
+
+    auto ExpressionCompiler::lookupIntrinsic(AstIndex targetIndex) const noexcept -> IntrinsicMap const*
+    {
+        for (IntrinsicMap const& intrinsic : intrinsics)
+            if (isNamed(targetIndex, intrinsic.name))
+                return &intrinsic;
+        return nullptr;
+    }
+
+    bool ExpressionCompiler::lookupFunction(AstIndex targetIndex, dsFunctionCompileMeta& out_functionMeta) const
+    {
+        Token const& identToken = tokens_[ast_[targetIndex].primaryTokenIndex];
+        char const* const identStart = expression_.data() + identToken.offset.value();
+        char const* const identEnd = identStart + identToken.length;
+
+        return host_.lookupFunction(dsName{identStart, identEnd}, out_functionMeta);
+    }
+
     auto ExpressionCompiler::optimize(AstIndex astIndex) -> AstIndex
     {
         switch (ast_[astIndex].type)
@@ -844,7 +1151,7 @@ namespace descript {
             AstIndex childIndex = optimize(ast_[astIndex].data.unary.childIndex);
 
             // we can only further optimize constants
-            if (ast_[astIndex].type == AstType::Constant)
+            if (ast_[childIndex].type == AstType::Constant)
             {
                 if (ast_[astIndex].data.unary.op == Operator::Negate && ast_[childIndex].valueType == Int32TypeId)
                 {
@@ -946,25 +1253,68 @@ namespace descript {
 
                     return astIndex;
                 }
+
+                // comparisons of numbers or booleans
+                if (bool result = false; compareConstants(op, ast_[leftChildIndex], ast_[rightChildIndex], result))
+                {
+                    ast.type = AstType::Constant;
+                    ast.data = {.constant = {.bool_ = result}};
+                    return astIndex;
+                }
+            }
+
+            // a constant left operand decides and/or alone, or leaves the right operand as the result
+            if (ast_[leftChildIndex].type == AstType::Constant && (op == Operator::And || op == Operator::Or))
+            {
+                bool const left = ast_[leftChildIndex].data.constant.bool_;
+                return left == (op == Operator::Or) ? leftChildIndex : rightChildIndex;
             }
 
             ast_[astIndex].data.binary.leftIndex = leftChildIndex;
             ast_[astIndex].data.binary.rightIndex = rightChildIndex;
             break;
         }
-        case AstType::Function: {
-            AstIndex newCallIndex = astIndex;
-            AstIndex lastArgIndex = dsInvalidIndex;
+        case AstType::Call: {
+            bool constantArgs = true;
 
             for (AstLinkIndex linkIndex = ast_[astIndex].data.function.firstArgIndex; linkIndex != dsInvalidIndex;
                  linkIndex = astLinks_[linkIndex].nextIndex)
             {
                 AstIndex newArgIndex = optimize(astLinks_[linkIndex].childIndex);
                 astLinks_[linkIndex].childIndex = newArgIndex;
+                constantArgs &= ast_[newArgIndex].type == AstType::Constant;
+            }
+
+            if (constantArgs)
+                fold(astIndex);
+            return astIndex;
+        }
+        case AstType::Intrinsic: {
+            bool constantArgs = true;
+
+            for (AstLinkIndex linkIndex = ast_[astIndex].data.intrinsic.firstArgIndex; linkIndex != dsInvalidIndex;
+                 linkIndex = astLinks_[linkIndex].nextIndex)
+            {
+                AstIndex newArgIndex = optimize(astLinks_[linkIndex].childIndex);
+                astLinks_[linkIndex].childIndex = newArgIndex;
+                constantArgs &= ast_[newArgIndex].type == AstType::Constant;
             }
 
-            // this might not be "new" but just a copy of the original index
-            return newCallIndex;
+            if (constantArgs)
+                foldIntrinsic(astIndex);
+            return astIndex;
+        }
+        case AstType::Select: {
+            AstIndex const conditionIndex = optimize(ast_[astIndex].data.select.conditionIndex);
+            AstIndex const trueIndex = optimize(ast_[astIndex].data.select.trueIndex);
+            AstIndex const falseIndex = optimize(ast_[astIndex].data.select.falseIndex);
+
+            // a constant condition leaves only the branch it chooses
+            if (ast_[conditionIndex].type == AstType::Constant)
+                return ast_[conditionIndex].data.constant.bool_ ? trueIndex : falseIndex;
+
+            ast_[astIndex].data.select = {.conditionIndex = conditionIndex, .trueIndex = trueIndex, .falseIndex = falseIndex};
+            return astIndex;
         }
         default: break;
         }
@@ -973,6 +1323,129 @@ namespace descript {
         return astIndex;
     }
 
+    // evaluates a comparison of constants by the same operations as the evaluators, false if op is no comparison
+    bool ExpressionCompiler::compareConstants(Operator op, Ast const& left, Ast const& right, bool& out_result) noexcept
+    {
+        using namespace detail_;
+
+        auto const compare = [op, &out_result]<typename T>(T left, T right) noexcept {
+            switch (op)
+            {
+            case Operator::Equal: out_result = Equal::apply(left, right); return true;
+            case Operator::NotEqual: out_result = NotEqual::apply(left, right); return true;
+            default: break;
+            }
+
+            if constexpr (IsArithmetic<T>)
+            {
+                switch (op)
+                {
+                case Operator::Less: out_result = Less::apply(left, right); return true;
+                case Operator::LessEqual: out_result = LessEqual::apply(left, right); return true;
+                case Operator::Greater: out_result = Greater::apply(left, right); return true;
+                case Operator::GreaterEqual: out_result = GreaterEqual::apply(left, right); return true;
+                default: break;
+                }
+            }
+            return false;
+        };
+
+        if (left.valueType == Int32TypeId)
+            return compare(static_cast<int32_t>(left.data.constant.int64_), static_cast<int32_t>(right.data.constant.int64_));
+        if (left.valueType == Float32TypeId)
+            return compare(static_cast<float>(left.data.constant.float64_), static_cast<float>(right.data.constant.float64_));
+        if (left.valueType == BoolTypeId)
+            return compare(left.data.constant.bool_, right.data.constant.bool_);
+        return false;
+    }
+
+    // evaluates a call with constant arguments, replacing it with its result if the function is pure and can be folded
+    void ExpressionCompiler::fold(AstIndex astIndex)
+    {
+        Ast& ast = ast_[astIndex];
+
+        dsFunctionCompileMeta meta;
+        if (!lookupFunction(ast.data.function.targetIndex, meta) || !meta.isPure || meta.fold == nullptr)
+            return;
+
+        dsValueStorage args[FoldContext::maxArgs];
+        if (ast.data.function.arity > FoldContext::maxArgs)
+            return;
+
+        uint32_t argCount = 0;
+        for (AstLinkIndex linkIndex = ast.data.function.firstArgIndex; linkIndex != dsInvalidIndex;
+             linkIndex = astLinks_[linkIndex].nextIndex)
+        {
+            Ast const& arg = ast_[astLinks_[linkIndex].childIndex];
+            if (arg.valueType == Int32TypeId)
+                args[argCount++] = dsValueStorage{static_cast<int32_t>(arg.data.constant.int64_)};
+            else if (arg.valueType == Float32TypeId)
+                args[argCount++] = dsValueStorage{static_cast<float>(arg.data.constant.float64_)};
+            else if (arg.valueType == BoolTypeId)
+                args[argCount++] = dsValueStorage{arg.data.constant.bool_};
+            else
+                return;
+        }
+
+        FoldContext ctx(args, argCount);
+        meta.fold(ctx, meta.foldUserData);
+
+        // a function which listens to an emitter depends on more than its arguments, whatever it claims
+        dsValueStorage const& result = ctx.value();
+        if (ctx.listened() || result.type() != ast.valueType)
+            return;
+
+        if (result.is<int32_t>())
+            ast.data = {.constant = {.int64_ = result.as<int32_t>()}};
+        else if (result.is<float>())
+            ast.data = {.constant = {.float64_ = result.as<float>()}};
+        else if (result.is<bool>())
+            ast.data = {.constant = {.bool_ = result.as<bool>()}};
+        else
+            return;
+        ast.type = AstType::Constant;
+    }
+
+    // evaluates an intrinsic with constant arguments by the same operations as the evaluators, so that folding
+    // cannot change the result
+    void ExpressionCompiler::foldIntrinsic(AstIndex astIndex)
+    {
+        using namespace detail_;
+
+        Ast& ast = ast_[astIndex];
+
+        int32_t ints[3] = {};
+        float floats[3] = {};
+        uint32_t argCount = 0;
+        for (AstLinkIndex linkIndex = ast.data.intrinsic.firstArgIndex; linkIndex != dsInvalidIndex && argCount != 3;
+             linkIndex = astLinks_[linkIndex].nextIndex)
+        {
+            Ast const& arg = ast_[astLinks_[linkIndex].childIndex];
+            if (ast.valueType == Int32TypeId)
+                ints[argCount++] = static_cast<int32_t>(arg.data.constant.int64_);
+            else
+                floats[argCount++] = static_cast<float>(arg.data.constant.float64_);
+        }
+
+        switch (ast.data.intrinsic.op)
+        {
+        case dsOpCode::Nop: ast.data = {.constant = {.int64_ = ints[0]}}; break;
+        case dsOpCode::MinI32: ast.data = {.constant = {.int64_ = Min::apply(ints[0], ints[1])}}; break;
+        case dsOpCode::MinF32: ast.data = {.constant = {.float64_ = Min::apply(floats[0], floats[1])}}; break;
+        case dsOpCode::MaxI32: ast.data = {.constant = {.int64_ = Max::apply(ints[0], ints[1])}}; break;
+        case dsOpCode::MaxF32: ast.data = {.constant = {.float64_ = Max::apply(floats[0], floats[1])}}; break;
+        case dsOpCode::AbsI32: ast.data = {.constant = {.int64_ = Abs::apply(ints[0])}}; break;
+        case dsOpCode::AbsF32: ast.data = {.constant = {.float64_ = Abs::apply(floats[0])}}; break;
+        case dsOpCode::FloorF32: ast.data = {.constant = {.float64_ = Floor::apply(floats[0])}}; break;
+        case dsOpCode::SqrtF32: ast.data = {.constant = {.float64_ = Sqrt::apply(floats[0])}}; break;
+        case dsOpCode::ClampI32: ast.data = {.constant = {.int64_ = Clamp::apply(ints[0], ints[1], ints[2])}}; break;
+        case dsOpCode::ClampF32: ast.data = {.constant = {.float64_ = Clamp::apply(floats[0], floats[1], floats[2])}}; break;
+        case dsOpCode::LerpF32: ast.data = {.constant = {.float64_ = Lerp::apply(floats[0], floats[1], floats[2])}}; break;
+        default: DS_GUARD_VOID(false, "Unexpected intrinsic op-code");
+        }
+        ast.type = AstType::Constant;
+    }
+
     bool ExpressionCompiler::generate(AstIndex astIndex, dsExpressionBuilder& builder) const
     {
         Ast const& ast = ast_[astIndex];
@@ -1034,7 +1507,7 @@ namespace descript {
                             break;
                         }
 
-                        if (value >= INT16_MAX)
+                        if (value >= INT16_MIN)
                         {
                             uint16_t const value16 = static_cast<int16_t>(value);
 
@@ -1094,30 +1567,59 @@ namespace descript {
             builder.pushOp((uint8_t)(index & 0xff));
             return true;
         }
-        case AstType::BinaryOp:
+        case AstType::BinaryOp: {
             if (!generate(ast.data.binary.leftIndex, builder))
                 return false;
+
+            // and/or skip a right operand which calls a function whenever the left operand decides the result alone;
+            // anything cheaper is evaluated unconditionally, which keeps the code free of branches
+            Operator const op = ast.data.binary.op;
+            if ((op == Operator::And || op == Operator::Or) && invokesFunction(ast.data.binary.rightIndex))
+            {
+                dsOpCode const jump = op == Operator::And ? dsOpCode::JumpIfFalseOrPop : dsOpCode::JumpIfTrueOrPop;
+                return generateJump(jump, measure(ast.data.binary.rightIndex), builder) &&
+                    generate(ast.data.binary.rightIndex, builder);
+            }
+
             if (!generate(ast.data.binary.rightIndex, builder))
                 return false;
-            switch (ast.data.binary.op)
+
+            // lowering has checked that both operands share a type, which is also that of any arithmetic result
+            dsTypeId const operandType = ast_[ast.data.binary.leftIndex].valueType;
+            bool const isFloat = operandType == Float32TypeId;
+            bool const isBool = operandType == BoolTypeId;
+            switch (op)
             {
-            case Operator::Add: builder.pushOp((uint8_t)dsOpCode::Add); break;
-            case Operator::Sub: builder.pushOp((uint8_t)dsOpCode::Sub); break;
-            case Operator::Mul: builder.pushOp((uint8_t)dsOpCode::Mul); break;
-            case Operator::Div: builder.pushOp((uint8_t)dsOpCode::Div); break;
-            case Operator::And: builder.pushOp((uint8_t)dsOpCode::And); break;
-            case Operator::Or: builder.pushOp((uint8_t)dsOpCode::Or); break;
-            case Operator::Xor: builder.pushOp((uint8_t)dsOpCode::Xor); break;
+            case Operator::Add: builder.pushOp((uint8_t)(isFloat ? dsOpCode::AddF32 : dsOpCode::AddI32)); break;
+            case Operator::Sub: builder.pushOp((uint8_t)(isFloat ? dsOpCode::SubF32 : dsOpCode::SubI32)); break;
+            case Operator::Mul: builder.pushOp((uint8_t)(isFloat ? dsOpCode::MulF32 : dsOpCode::MulI32)); break;
+            case Operator::Div: builder.pushOp((uint8_t)(isFloat ? dsOpCode::DivF32 : dsOpCode::DivI32)); break;
+            case Operator::And: builder.pushOp((uint8_t)dsOpCode::AndB); break;
+            case Operator::Or: builder.pushOp((uint8_t)dsOpCode::OrB); break;
+            case Operator::Xor: builder.pushOp((uint8_t)dsOpCode::XorB); break;
+            case Operator::Equal:
+                builder.pushOp((uint8_t)(isBool ? dsOpCode::EqB : isFloat ? dsOpCode::EqF32 : dsOpCode::EqI32));
+                break;
+            case Operator::NotEqual:
+                builder.pushOp((uint8_t)(isBool ? dsOpCode::NeB : isFloat ? dsOpCode::NeF32 : dsOpCode::NeI32));
+                break;
+            case Operator::Less: builder.pushOp((uint8_t)(isFloat ? dsOpCode::LtF32 : dsOpCode::LtI32)); break;
+            case Operator::LessEqual: builder.pushOp((uint8_t)(isFloat ? dsOpCode::LeF32 : dsOpCode::LeI32)); break;
+            case Operator::Greater: builder.pushOp((uint8_t)(isFloat ? dsOpCode::GtF32 : dsOpCode::GtI32)); break;
+            case Operator::GreaterEqual: builder.pushOp((uint8_t)(isFloat ? dsOpCode::GeF32 : dsOpCode::GeI32)); break;
             default: DS_GUARD_OR(false, false, "Unknown binary operator type");
             }
             return true;
+        }
         case AstType::UnaryOp:
             if (!generate(ast.data.unary.childIndex, builder))
                 return false;
             switch (ast.data.unary.op)
             {
-            case Operator::Negate: builder.pushOp((uint8_t)dsOpCode::Neg); break;
-            case Operator::Not: builder.pushOp((uint8_t)dsOpCode::Not); break;
+            case Operator::Negate:
+                builder.pushOp((uint8_t)(ast.valueType == Float32TypeId ? dsOpCode::NegF32 : dsOpCode::NegI32));
+                break;
+            case Operator::Not: builder.pushOp((uint8_t)dsOpCode::NotB); break;
             default: DS_GUARD_OR(false, false, "Unknown unary operator type");
             }
             return true;
@@ -1143,10 +1645,270 @@ namespace descript {
             builder.pushOp(ast.data.function.arity);
             return true;
         }
+        case AstType::Intrinsic:
+            for (AstLinkIndex linkIndex = ast.data.intrinsic.firstArgIndex; linkIndex != dsInvalidIndex;
+                 linkIndex = astLinks_[linkIndex].nextIndex)
+            {
+                if (!generate(astLinks_[linkIndex].childIndex, builder))
+                    return false;
+            }
+
+            // an intrinsic which is the identity for its type, such as the floor of an integer, emits nothing
+            if (ast.data.intrinsic.op != dsOpCode::Nop)
+                builder.pushOp((uint8_t)ast.data.intrinsic.op);
+            return true;
+        case AstType::Select: {
+            if (!generate(ast.data.select.conditionIndex, builder))
+                return false;
+
+            // only the chosen branch is evaluated if either calls a function; otherwise both are, without branching
+            if (invokesFunction(ast.data.select.trueIndex) || invokesFunction(ast.data.select.falseIndex))
+            {
+                uint32_t const trueSize = measure(ast.data.select.trueIndex) + 1 + dsOpOperandBytes(dsOpCode::Jump);
+                return generateJump(dsOpCode::JumpIfFalse, trueSize, builder) && generate(ast.data.select.trueIndex, builder) &&
+                    generateJump(dsOpCode::Jump, measure(ast.data.select.falseIndex), builder) &&
+                    generate(ast.data.select.falseIndex, builder);
+            }
+
+            if (!generate(ast.data.select.trueIndex, builder) || !generate(ast.data.select.falseIndex, builder))
+                return false;
+            builder.pushOp((uint8_t)dsOpCode::Select);
+            return true;
+        }
         default: DS_GUARD_OR(false, false, "Unknown AST node type");
         }
     }
 
+    bool ExpressionCompiler::generateJump(dsOpCode op, uint32_t offset, dsExpressionBuilder& builder) const
+    {
+        if (offset > UINT16_MAX)
+        {
+            // FIXME: error, out of range
+            return false;
+        }
+
+        builder.pushOp((uint8_t)op);
+        builder.pushOp((uint8_t)(offset >> 8));
+        builder.pushOp((uint8_t)(offset & 0xff));
+        return true;
+    }
+
+    // the size of the byte code of a subexpression; one which fails to generate fails again when generated for real
+    uint32_t ExpressionCompiler::measure(AstIndex astIndex) const
+    {
+        ByteCodeSize size;
+        if (!generate(astIndex, size))
+            return 0;
+        return size.size();
+    }
+
+    bool ExpressionCompiler::invokesFunction(AstIndex astIndex) const noexcept
+    {
+        Ast const& ast = ast_[astIndex];
+        switch (ast.type)
+        {
+        case AstType::Call: return true;
+        case AstType::BinaryOp: return invokesFunction(ast.data.binary.leftIndex) || invokesFunction(ast.data.binary.rightIndex);
+        case AstType::UnaryOp: return invokesFunction(ast.data.unary.childIndex);
+        case AstType::Intrinsic:
+            for (AstLinkIndex linkIndex = ast.data.intrinsic.firstArgIndex; linkIndex != dsInvalidIndex;
+                 linkIndex = astLinks_[linkIndex].nextIndex)
+            {
+                if (invokesFunction(astLinks_[linkIndex].childIndex))
+                    return true;
+            }
+            return false;
+        case AstType::Select:
+            return invokesFunction(ast.data.select.conditionIndex) || invokesFunction(ast.data.select.trueIndex) ||
+                invokesFunction(ast.data.select.falseIndex);
+        default: return false;
+        }
+    }
+
+    // the superinstruction fusing a Read with the following operator, or Last if there is none
+    static dsOpCode fusedReadOp(dsOpCode op) noexcept
+    {
+        switch (op)
+        {
+        case dsOpCode::AddI32: return dsOpCode::AddReadI32;
+        case dsOpCode::AddF32: return dsOpCode::AddReadF32;
+        case dsOpCode::SubI32: return dsOpCode::SubReadI32;
+        case dsOpCode::SubF32: return dsOpCode::SubReadF32;
+        case dsOpCode::MulI32: return dsOpCode::MulReadI32;
+        case dsOpCode::MulF32: return dsOpCode::MulReadF32;
+        default: return dsOpCode::Last;
+        }
+    }
+
+    // the superinstruction fusing an integer push with the following operator, or Last if there is none
+    static dsOpCode fusedImmediateOp(dsOpCode op) noexcept
+    {
+        switch (op)
+        {
+        case dsOpCode::AddI32: return dsOpCode::AddImmI32;
+        case dsOpCode::SubI32: return dsOpCode::SubImmI32;
+        case dsOpCode::MulI32: return dsOpCode::MulImmI32;
+        default: return dsOpCode::Last;
+        }
+    }
+
+    // the value of the integer push at ip, if it fits the 16-bit signed operand of a superinstruction
+    static bool fusableImmediate(uint8_t const* ip, int32_t& out_value) noexcept
+    {
+        switch (dsOpCode(*ip))
+        {
+        case dsOpCode::Push0: out_value = 0; return true;
+        case dsOpCode::Push1: out_value = 1; return true;
+        case dsOpCode::Push2: out_value = 2; return true;
+        case dsOpCode::PushNeg1: out_value = -1; return true;
+        case dsOpCode::PushS8: out_value = static_cast<int8_t>(ip[1]); return true;
+        case dsOpCode::PushU8: out_value = ip[1]; return true;
+        case dsOpCode::PushS16: out_value = static_cast<int16_t>(ip[1] << 8 | ip[2]); return true;
+        case dsOpCode::PushU16: out_value = ip[1] << 8 | ip[2]; return out_value <= INT16_MAX;
+        default: return false;
+        }
+    }
+
+    static bool isJump(dsOpCode op) noexcept
+    {
+        return op == dsOpCode::Jump || op == dsOpCode::JumpIfFalse || op == dsOpCode::JumpIfFalseOrPop ||
+            op == dsOpCode::JumpIfTrueOrPop;
+    }
+
+    // the offset of the instruction a jump at ip continues at
+    static uint32_t jumpTarget(uint8_t const* ip, uint8_t const* start) noexcept
+    {
+        return static_cast<uint32_t>(ip - start) + 3 + (ip[1] << 8 | ip[2]);
+    }
+
+    void ExpressionCompiler::fuse(dsExpressionBuilder& builder) const
+    {
+        uint8_t const* const start = byteCode_.data();
+        uint8_t const* const end = start + byteCode_.size();
+
+        // a jump target must remain the start of an instruction, so it is never fused into the instruction before it
+        dsArray<bool> targets(allocator_);
+        targets.resize(byteCode_.size() + 1);
+        for (uint8_t const* ip = start; ip != end; ip += 1 + dsOpOperandBytes(dsOpCode(*ip)))
+        {
+            if (isJump(dsOpCode(*ip)))
+                targets[jumpTarget(ip, start)] = true;
+        }
+        auto const isTarget = [&](uint8_t const* ip) noexcept { return targets[static_cast<uint32_t>(ip - start)]; };
+
+        // the fused offset of each instruction, so that the jumps over it may be relocated
+        dsArray<uint8_t> fused(allocator_);
+        dsArray<uint32_t> offsets(allocator_);
+        offsets.resize(byteCode_.size() + 1);
+
+        uint8_t const* ip = start;
+        while (ip != end)
+        {
+            offsets[static_cast<uint32_t>(ip - start)] = fused.size();
+
+            dsOpCode const op = dsOpCode(*ip);
+            uint8_t const* const next = ip + 1 + dsOpOperandBytes(op);
+            dsOpCode const nextOp = next != end && !isTarget(next) ? dsOpCode(*next) : dsOpCode::Last;
+
+            // Read, operator
+            if (dsOpCode const fusedOp = fusedReadOp(nextOp); op == dsOpCode::Read && fusedOp != dsOpCode::Last)
+            {
+                fused.pushBack((uint8_t)fusedOp);
+                fused.pushBack(ip[1]);
+                fused.pushBack(ip[2]);
+                ip = next + 1;
+                continue;
+            }
+
+            // Read, Read; unless the second Read fuses with the operator after it, which saves as much
+            if (op == dsOpCode::Read && nextOp == dsOpCode::Read)
+            {
+                uint8_t const* const after = next + 3;
+                if (after == end || isTarget(after) || fusedReadOp(dsOpCode(*after)) == dsOpCode::Last)
+                {
+                    fused.pushBack((uint8_t)dsOpCode::ReadRead);
+                    fused.pushBack(ip[1]);
+                    fused.pushBack(ip[2]);
+                    fused.pushBack(next[1]);
+                    fused.pushBack(next[2]);
+                    ip = after;
+                    continue;
+                }
+            }
+
+            // integer push, operator
+            int32_t immediate = 0;
+            if (dsOpCode const fusedOp = fusedImmediateOp(nextOp); fusedOp != dsOpCode::Last && fusableImmediate(ip, immediate))
+            {
+                uint16_t const operand = static_cast<uint16_t>(immediate);
+                fused.pushBack((uint8_t)fusedOp);
+                fused.pushBack((uint8_t)(operand >> 8));
+                fused.pushBack((uint8_t)(operand & 0xff));
+                ip = next + 1;
+                continue;
+            }
+
+            for (; ip != next; ++ip)
+                fused.pushBack(*ip);
+        }
+        offsets[byteCode_.size()] = fused.size();
+
+        // jumps are never fused, so each is still at the fused offset of its instruction
+        for (ip = start; ip != end; ip += 1 + dsOpOperandBytes(dsOpCode(*ip)))
+        {
+            if (!isJump(dsOpCode(*ip)))
+                continue;
+
+            uint32_t const from = offsets[static_cast<uint32_t>(ip - start)];
+            uint32_t const offset = offsets[jumpTarget(ip, start)] - (from + 3);
+            fused[from + 1] = (uint8_t)(offset >> 8);
+            fused[from + 2] = (uint8_t)(offset & 0xff);
+        }
+
+        for (uint8_t const byte : fused)
+            builder.pushOp(byte);
+    }
+
+    uint32_t ExpressionCompiler::stackDepth(AstIndex astIndex) const noexcept
+    {
+        Ast const& ast = ast_[astIndex];
+        switch (ast.type)
+        {
+        case AstType::BinaryOp: {
+            // the left operand is held on the stack while the right operand is evaluated
+            uint32_t const leftDepth = stackDepth(ast.data.binary.leftIndex);
+            uint32_t const rightDepth = 1 + stackDepth(ast.data.binary.rightIndex);
+            return leftDepth > rightDepth ? leftDepth : rightDepth;
+        }
+        case AstType::UnaryOp: return stackDepth(ast.data.unary.childIndex);
+        case AstType::Select: {
+            // as deep as the Select op-code needs, which is at least as deep as the jumps over either branch need
+            uint32_t const conditionDepth = stackDepth(ast.data.select.conditionIndex);
+            uint32_t const trueDepth = 1 + stackDepth(ast.data.select.trueIndex);
+            uint32_t const falseDepth = 2 + stackDepth(ast.data.select.falseIndex);
+            uint32_t const depth = conditionDepth > trueDepth ? conditionDepth : trueDepth;
+            return depth > falseDepth ? depth : falseDepth;
+        }
+        case AstType::Call:
+        case AstType::Intrinsic: {
+            // each argument is evaluated above those preceding it; the result needs one slot even with no arguments
+            uint32_t depth = 1;
+            uint32_t argIndex = 0;
+            AstLinkIndex const firstArgIndex =
+                ast.type == AstType::Call ? ast.data.function.firstArgIndex : ast.data.intrinsic.firstArgIndex;
+            for (AstLinkIndex linkIndex = firstArgIndex; linkIndex != dsInvalidIndex;
+                 linkIndex = astLinks_[linkIndex].nextIndex)
+            {
+                uint32_t const argDepth = argIndex++ + stackDepth(astLinks_[linkIndex].childIndex);
+                if (argDepth > depth)
+                    depth = argDepth;
+            }
+            return depth;
+        }
+        default: return 1;
+        }
+    }
+
     bool ExpressionCompiler::isEmpty() const noexcept
     {
         DS_GUARD_OR(status_ == Status::Lowered || status_ == Status::Optimized, false);
@@ -1169,6 +1931,12 @@ namespace descript {
         return ast_[astRoot_].type == AstType::Variable;
     }
 
+    bool ExpressionCompiler::isVolatile() const noexcept
+    {
+        DS_GUARD_OR(status_ == Status::Lowered || status_ == Status::Optimized, false);
+        return callsVolatile_;
+    }
+
     dsTypeId ExpressionCompiler::resultType() const noexcept
     {
         DS_GUARD_OR(status_ == Status::Lowered || status_ == Status::Optimized, dsType<void>.typeId);
@@ -1177,6 +1945,14 @@ namespace descript {
         return ast_[astRoot_].valueType;
     }
 
+    uint32_t ExpressionCompiler::maxStackDepth() const noexcept
+    {
+        DS_GUARD_OR(status_ == Status::Lowered || status_ == Status::Optimized, 0);
+        if (astRoot_ == dsInvalidIndex)
+            return 0;
+        return stackDepth(astRoot_);
+    }
+
     bool ExpressionCompiler::asConstant(dsValueOut out_value) const
     {
         DS_GUARD_OR(status_ == Status::Lowered || status_ == Status::Optimized, false);
@@ -262,6 +262,8 @@ namespace descript {
                 dsAssemblyExpressionIndex index = dsInvalidIndex;
                 dsAssemblyByteCodeIndex byteCodeStart = dsInvalidIndex;
                 uint32_t byteCodeCount = 0;
+                uint32_t maxStack = 0;
+                bool isVolatile = false;
                 bool live = false;
             };
 
@@ -274,6 +276,8 @@ namespace descript {
             void processWires();
             void compileBindings();
             void allocateIndices();
+            void linkByteCode();
+            Variable const& linkVariable(uint8_t* operand);
 
             // return false, for convenience
             bool error(dsCompileError const& error);
@@ -319,6 +323,18 @@ namespace descript {
             OutputSlotIndex openOutputSlot_ = dsInvalidIndex;
             CompileStatus status_ = CompileStatus::Reset;
         };
+
+        // the order variables are sorted in, so that each built-in type occupies a range of its own; see dsVariableLayout
+        constexpr dsTypeId s_packedTypes[] = {dsType<int32_t>.typeId, dsType<float>.typeId, dsType<bool>.typeId};
+        constexpr uint32_t s_packedRankCount = sizeof(s_packedTypes) / sizeof(s_packedTypes[0]) + 1;
+
+        uint32_t packedRank(dsTypeId type) noexcept
+        {
+            uint32_t rank = 0;
+            while (rank != s_packedRankCount - 1 && s_packedTypes[rank] != type)
+                ++rank;
+            return rank;
+        }
     } // namespace
 
     dsGraphCompiler* dsCreateGraphCompiler(dsAllocator& alloc, dsGraphCompilerHost& host)
@@ -543,6 +559,7 @@ namespace descript {
         updateLiveness();
         compileBindings();
         allocateIndices();
+        linkByteCode();
 
         bool const success = errors_.empty();
         status_ = success ? CompileStatus::Compiled : CompileStatus::Errored;
@@ -632,7 +649,7 @@ namespace descript {
         std::memset(assemblyBytes_.data(), 0xfe, assemblyBytes_.size());
         dsAssemblyHeader* const header = reinterpret_cast<dsAssemblyHeader*>(assemblyBytes_.data());
 
-        header->version = 0;
+        header->version = dsAssemblyVersion;
         header->size = size;
         header->hash = 0;
         header->inputPlugCount = compiledInputPlugCount_;
@@ -751,6 +768,7 @@ namespace descript {
             outVar.nameHash = var.nameHash;
             outVar.dependencyStart = var.dependencyStart;
             outVar.dependencyCount = var.dependencyCount;
+            outVar.typeId = var.type.value();
         }
 
         for (Dependency const& dep : dependencies_)
@@ -768,6 +786,8 @@ namespace descript {
             dsAssemblyExpression& outExpr = header->expressions[expression.index];
             outExpr.codeStart = expression.byteCodeStart;
             outExpr.codeCount = expression.byteCodeCount;
+            outExpr.maxStack = expression.maxStack;
+            outExpr.isVolatile = expression.isVolatile;
         }
 
         for (auto&& [index, value] : dsEnumerate(constants_))
@@ -1164,6 +1184,8 @@ namespace descript {
 
                 expression.live = true;
                 expression.byteCodeCount = byteCode_.size() - expression.byteCodeStart.value();
+                expression.maxStack = exprCompiler_->maxStackDepth();
+                expression.isVolatile = exprCompiler_->isVolatile();
             }
             else if (binding.constantIndex != dsInvalidIndex)
             {
@@ -1206,23 +1228,26 @@ namespace descript {
         compiledDependencyCount_ = 0;
         compiledExpressionCount_ = 0;
 
-        // allocate indices for all live variables
-        for (Variable& var : variables_)
+        // allocate indices for all live variables, sorted by type
+        for (uint32_t rank = 0; rank != s_packedRankCount; ++rank)
         {
-            if (!var.live)
-                continue;
+            for (Variable& var : variables_)
+            {
+                if (!var.live || packedRank(var.type) != rank)
+                    continue;
 
-            var.index = dsAssemblyVariableIndex{compiledVariableCount_++};
+                var.index = dsAssemblyVariableIndex{compiledVariableCount_++};
 
-            // assign indices to dependencies; we already have the count
-            var.dependencyStart = dsAssemblyDependencyIndex{compiledDependencyCount_};
-            for (DependencyIndex depIndex = var.firstDependency; dependencies_.contains(depIndex);
-                 depIndex = dependencies_[depIndex].nextDependency)
-            {
-                Dependency& dep = dependencies_[depIndex];
-                dep.index = dsAssemblyDependencyIndex{compiledDependencyCount_++};
+                // assign indices to dependencies; we already have the count
+                var.dependencyStart = dsAssemblyDependencyIndex{compiledDependencyCount_};
+                for (DependencyIndex depIndex = var.firstDependency; dependencies_.contains(depIndex);
+                     depIndex = dependencies_[depIndex].nextDependency)
+                {
+                    Dependency& dep = dependencies_[depIndex];
+                    dep.index = dsAssemblyDependencyIndex{compiledDependencyCount_++};
+                }
+                DS_ASSERT(var.dependencyCount == compiledDependencyCount_ - var.dependencyStart.value());
             }
-            DS_ASSERT(var.dependencyCount == compiledDependencyCount_ - var.dependencyStart.value());
         }
 
         // allocate indices for all lives nodes and live output plugs
@@ -1339,6 +1364,59 @@ namespace descript {
         }
     }
 
+    void GraphCompiler::linkByteCode()
+    {
+        // the expression compiler refers to variables by their index in the compiler; rewrite those to the
+        // indices of the assembly, and each read of a built-in type to its typed op-code, which keeps op-codes
+        // the same size so that jumps are unaffected
+        for (Expression const& expression : expressions_)
+        {
+            if (!expression.live)
+                continue;
+
+            uint8_t* ip = byteCode_.data() + expression.byteCodeStart.value();
+            uint8_t* const end = ip + expression.byteCodeCount;
+            while (ip < end)
+            {
+                dsOpCode const op = static_cast<dsOpCode>(*ip);
+                switch (op)
+                {
+                case dsOpCode::Read: {
+                    dsTypeId const type = linkVariable(ip + 1).type;
+                    if (type == dsType<int32_t>.typeId)
+                        *ip = static_cast<uint8_t>(dsOpCode::ReadI32);
+                    else if (type == dsType<float>.typeId)
+                        *ip = static_cast<uint8_t>(dsOpCode::ReadF32);
+                    else if (type == dsType<bool>.typeId)
+                        *ip = static_cast<uint8_t>(dsOpCode::ReadB);
+                    break;
+                }
+                case dsOpCode::ReadRead:
+                    linkVariable(ip + 1);
+                    linkVariable(ip + 3);
+                    break;
+                case dsOpCode::AddReadI32:
+                case dsOpCode::AddReadF32:
+                case dsOpCode::SubReadI32:
+                case dsOpCode::SubReadF32:
+                case dsOpCode::MulReadI32:
+                case dsOpCode::MulReadF32: linkVariable(ip + 1); break;
+                default: break;
+                }
+                ip += 1 + dsOpOperandBytes(op);
+            }
+        }
+    }
+
+    GraphCompiler::Variable const& GraphCompiler::linkVariable(uint8_t* operand)
+    {
+        Variable const& variable = variables_[VariableIndex{(uint32_t{operand[0]} << 8) | operand[1]}];
+        DS_ASSERT(variable.live);
+        operand[0] = static_cast<uint8_t>(variable.index.value() >> 8);
+        operand[1] = static_cast<uint8_t>(variable.index.value() & 0xff);
+        return variable;
+    }
+
     bool GraphCompiler::error(dsCompileError const& error)
     {
         errors_.pushBack(error);
@@ -0,0 +1,209 @@
+// descript
+
+#pragma once
+
+#include "descript/alloc.hh"
+
+#include "assert.hh"
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace descript {
+    template <typename KeyT>
+    struct dsHashTraits
+    {
+        static_assert(std::is_integral_v<KeyT>, "dsHashTraits must be specialized for non-integral keys");
+
+        // 64-bit finalizer from MurmurHash3; keys like sequential ids need their bits mixed before masking
+        static constexpr uint64_t hash(KeyT key) noexcept
+        {
+            uint64_t value = static_cast<uint64_t>(key);
+            value ^= value >> 33;
+            value *= 0xff51'afd7'ed55'8ccdull;
+            value ^= value >> 33;
+            value *= 0xc4ce'b9fe'1a85'ec53ull;
+            value ^= value >> 33;
+            return value;
+        }
+    };
+
+    /// Open-addressing hash map with linear probing and backward-shift deletion.
+    ///
+    /// Keys and values must be trivially copyable. Pointers returned by find() and
+    /// insert() are invalidated by any subsequent insert or erase.
+    template <typename KeyT, typename ValueT, typename TraitsT = dsHashTraits<KeyT>>
+    class dsHashMap
+    {
+    public:
+        static_assert(std::is_trivially_copyable_v<KeyT>);
+        static_assert(std::is_trivially_copyable_v<ValueT>);
+
+        explicit dsHashMap(dsAllocator& allocator) noexcept : allocator_(&allocator) {}
+        ~dsHashMap() noexcept { deallocate(); }
+
+        dsHashMap(dsHashMap const&) = delete;
+        dsHashMap& operator=(dsHashMap const&) = delete;
+
+        uint32_t size() const noexcept { return size_; }
+        bool empty() const noexcept { return size_ == 0; }
+
+        ValueT* find(KeyT key) noexcept;
+        ValueT const* find(KeyT key) const noexcept { return const_cast<dsHashMap*>(this)->find(key); }
+
+        bool contains(KeyT key) const noexcept { return find(key) != nullptr; }
+
+        /// Inserts the key with the provided value if the key is not yet present;
+        /// returns the value slot for the key in either case.
+        ValueT& insert(KeyT key, ValueT const& value);
+
+        bool erase(KeyT key) noexcept;
+
+        void clear() noexcept;
+
+        void reserve(uint32_t minimumCapacity);
+
+    private:
+        struct Entry
+        {
+            KeyT key;
+            ValueT value;
+        };
+
+        uint32_t mask() const noexcept { return capacity_ - 1; }
+        uint32_t home(KeyT key) const noexcept { return static_cast<uint32_t>(TraitsT::hash(key)) & mask(); }
+
+        void rehash(uint32_t capacity);
+        void deallocate() noexcept;
+
+        Entry* entries_ = nullptr;
+        bool* used_ = nullptr;
+        uint32_t size_ = 0;
+        uint32_t capacity_ = 0;
+        dsAllocator* allocator_ = nullptr;
+    };
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    ValueT* dsHashMap<KeyT, ValueT, TraitsT>::find(KeyT key) noexcept
+    {
+        if (size_ == 0)
+            return nullptr;
+
+        for (uint32_t index = home(key);; index = (index + 1) & mask())
+        {
+            if (!used_[index])
+                return nullptr;
+            if (entries_[index].key == key)
+                return &entries_[index].value;
+        }
+    }
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    ValueT& dsHashMap<KeyT, ValueT, TraitsT>::insert(KeyT key, ValueT const& value)
+    {
+        // keep the load factor at or below 3/4
+        if ((size_ + 1) * 4 > capacity_ * 3)
+            rehash(capacity_ < 16 ? 16 : capacity_ * 2);
+
+        uint32_t index = home(key);
+        for (; used_[index]; index = (index + 1) & mask())
+            if (entries_[index].key == key)
+                return entries_[index].value;
+
+        used_[index] = true;
+        new (&entries_[index]) Entry{.key = key, .value = value};
+        ++size_;
+        return entries_[index].value;
+    }
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    bool dsHashMap<KeyT, ValueT, TraitsT>::erase(KeyT key) noexcept
+    {
+        if (size_ == 0)
+            return false;
+
+        uint32_t index = home(key);
+        for (;; index = (index + 1) & mask())
+        {
+            if (!used_[index])
+                return false;
+            if (entries_[index].key == key)
+                break;
+        }
+
+        // shift back any following entries that would no longer be reachable from their home slot
+        for (uint32_t next = (index + 1) & mask(); used_[next]; next = (next + 1) & mask())
+        {
+            uint32_t const nextHome = home(entries_[next].key);
+            if (((next - nextHome) & mask()) >= ((next - index) & mask()))
+            {
+                entries_[index] = entries_[next];
+                index = next;
+            }
+        }
+
+        used_[index] = false;
+        --size_;
+        return true;
+    }
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    void dsHashMap<KeyT, ValueT, TraitsT>::clear() noexcept
+    {
+        for (uint32_t index = 0; index != capacity_; ++index)
+            used_[index] = false;
+        size_ = 0;
+    }
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    void dsHashMap<KeyT, ValueT, TraitsT>::reserve(uint32_t minimumCapacity)
+    {
+        uint32_t capacity = capacity_ < 16 ? 16 : capacity_;
+        while (minimumCapacity * 4 > capacity * 3)
+            capacity *= 2;
+        if (capacity != capacity_)
+            rehash(capacity);
+    }
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    void dsHashMap<KeyT, ValueT, TraitsT>::rehash(uint32_t capacity)
+    {
+        DS_ASSERT((capacity & (capacity - 1)) == 0);
+
+        Entry* const oldEntries = entries_;
+        bool* const oldUsed = used_;
+        uint32_t const oldCapacity = capacity_;
+
+        entries_ = static_cast<Entry*>(allocator_->allocate(capacity * sizeof(Entry), alignof(Entry)));
+        used_ = static_cast<bool*>(allocator_->allocate(capacity * sizeof(bool), alignof(bool)));
+        capacity_ = capacity;
+        size_ = 0;
+
+        for (uint32_t index = 0; index != capacity; ++index)
+            used_[index] = false;
+
+        for (uint32_t index = 0; index != oldCapacity; ++index)
+            if (oldUsed[index])
+                insert(oldEntries[index].key, oldEntries[index].value);
+
+        if (oldEntries != nullptr)
+        {
+            allocator_->free(oldEntries, oldCapacity * sizeof(Entry), alignof(Entry));
+            allocator_->free(oldUsed, oldCapacity * sizeof(bool), alignof(bool));
+        }
+    }
+
+    template <typename KeyT, typename ValueT, typename TraitsT>
+    void dsHashMap<KeyT, ValueT, TraitsT>::deallocate() noexcept
+    {
+        if (entries_ != nullptr)
+        {
+            allocator_->free(entries_, capacity_ * sizeof(Entry), alignof(Entry));
+            allocator_->free(used_, capacity_ * sizeof(bool), alignof(bool));
+        }
+        entries_ = nullptr;
+        used_ = nullptr;
+        size_ = capacity_ = 0;
+    }
+} // namespace descript
@@ -6,25 +6,82 @@
 #include "descript/value.hh"
 
 #include "array.hh"
+#include "assembly_internal.hh"
 #include "event.hh"
 #include "rel.hh"
+#include "storage.hh"
 
 #include <cstdint>
 
 namespace descript {
-    class dsAssembly;
+    inline constexpr uint32_t dsInvalidListenerIndex = ~uint32_t{0};
 
     struct alignas(16) dsInstance final
     {
         explicit dsInstance(dsAllocator& alloc, dsInstanceId instanceId) noexcept : events(alloc), instanceId(instanceId) {}
 
+        // copies the header of an assembly's prototype instance; the relative arrays remain
+        // valid so long as the prototype's trailing data has been copied along with it
+        dsInstance(dsAllocator& alloc, dsInstanceId instanceId, dsInstance const& prototype) noexcept
+            : assembly(prototype.assembly),
+              instanceId(instanceId),
+              activeNodes(prototype.activeNodes),
+              activeInputPlugs(prototype.activeInputPlugs),
+              activeOutputPlugs(prototype.activeOutputPlugs),
+              pendingDependencies(prototype.pendingDependencies),
+              int32Values(prototype.int32Values),
+              float32Values(prototype.float32Values),
+              boolValues(prototype.boolValues),
+              values(prototype.values),
+              listeners(prototype.listeners),
+              cachedResults(prototype.cachedResults),
+              results(prototype.results),
+              events(alloc)
+        {
+        }
+
+        /// The variables, as laid out by the assembly.
+        [[nodiscard]] dsPackedVariables packedVariables() noexcept
+        {
+            return dsPackedVariables{.int32s = int32Values.data(),
+                .float32s = float32Values.data(),
+                .boolBits = boolValues.base.get(),
+                .values = values.data(),
+                .layout = assembly->variableLayout};
+        }
+
+        [[nodiscard]] uint32_t variableCount() const noexcept { return assembly->variableLayout.count; }
+
+        [[nodiscard]] dsValueRef variable(dsAssemblyVariableIndex variableIndex) noexcept
+        {
+            return packedVariables().ref(variableIndex.value());
+        }
+
+        /// Fails if the variable is packed and the value is of another type.
+        [[nodiscard]] bool assignVariable(dsAssemblyVariableIndex variableIndex, dsValueRef const& value) noexcept
+        {
+            return packedVariables().assign(variableIndex.value(), value);
+        }
+
         dsAssembly* assembly = nullptr;
         dsInstanceId instanceId;
 
         dsRelativeBitArray<dsAssemblyNodeIndex> activeNodes;
         dsRelativeBitArray<dsAssemblyOutputPlugIndex> activeInputPlugs;
         dsRelativeBitArray<dsAssemblyOutputPlugIndex> activeOutputPlugs;
-        dsRelativeArray<dsValueStorage, dsAssemblyVariableIndex> values;
+        dsRelativeBitArray<dsAssemblyNodeIndex> pendingDependencies;
+
+        // variables, packed by type; see dsPackedVariables
+        dsRelativeArray<int32_t> int32Values;
+        dsRelativeArray<float> float32Values;
+        dsRelativeBitArray<uint32_t> boolValues;
+        dsRelativeArray<dsValueStorage> values;                        // variables of any other type
+        dsRelativeArray<uint32_t, dsAssemblyInputSlotIndex> listeners; // head of each input slot's listener list
+
+        // last result of each expression, valid while its bit is set; cleared when a variable or
+        // emitter the expression depends on changes
+        dsRelativeBitArray<dsAssemblyExpressionIndex> cachedResults;
+        dsRelativeArray<dsValueStorage, dsAssemblyExpressionIndex> results;
 
         struct Event
         {
@@ -33,5 +90,6 @@ namespace descript {
         };
 
         dsArray<Event> events;
+        bool queued = false; // true while the instance is in the runtime's pending list
     };
 } // namespace descript
@@ -0,0 +1,737 @@
+// descript
+
+#include "jit.hh"
+
+#if DS_JIT
+
+#include "descript/meta.hh"
+
+#include "assembly_internal.hh"
+#include "assert.hh"
+#include "evaluate_internal.hh"
+#include "ops.hh"
+#include "storage.hh"
+
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace descript {
+    namespace {
+        // the evaluation stack lives in the red zone below the stack pointer, which the System V ABI
+        // leaves to leaf functions, so the generated code needs no prologue; it holds 32 four-byte slots
+        constexpr uint32_t s_maxSlots = 32;
+
+        // upper bound on the code emitted for any one instruction; a superinstruction emits the code of
+        // the two instructions it fuses
+        constexpr uint32_t s_maxInstructionBytes = 96;
+
+        // the failure path sits in front of the entry point, so guards only ever jump backwards
+        constexpr uint32_t s_entryOffset = 16;
+
+        enum class SlotType : uint8_t
+        {
+            Int32,
+            Float32,
+            Bool,
+        };
+
+        // also the numbers of xmm0 and xmm1 in instructions on floats
+        enum Register : uint8_t
+        {
+            Eax = 0,
+            Ecx = 1,
+        };
+
+        class Emitter
+        {
+        public:
+            explicit Emitter(uint8_t* code) noexcept : code_(code) {}
+
+            uint32_t position() const noexcept { return position_; }
+
+            void bytes(std::initializer_list<uint8_t> bytes) noexcept
+            {
+                for (uint8_t const byte : bytes)
+                    code_[position_++] = byte;
+            }
+
+            void u32(uint32_t value) noexcept
+            {
+                std::memcpy(code_ + position_, &value, sizeof(value));
+                position_ += sizeof(value);
+            }
+
+            // ModRM and SIB addressing [rsp - 4 * (slot + 1)] with the given register or op-code extension
+            void slot(uint8_t reg, uint32_t slot) noexcept
+            {
+                bytes({static_cast<uint8_t>(0x44 | (reg << 3)), 0x24, static_cast<uint8_t>(-4 * static_cast<int32_t>(slot + 1))});
+            }
+
+            // a short jump whose target is bound later
+            uint32_t jump8(uint8_t opCode) noexcept
+            {
+                bytes({opCode, 0x00});
+                return position_ - 1;
+            }
+
+            void bind8(uint32_t jump) noexcept { code_[jump] = static_cast<uint8_t>(position_ - (jump + 1)); }
+
+            // a near conditional jump to an already emitted position
+            void jumpBack32(uint8_t condition, uint32_t target) noexcept
+            {
+                bytes({0x0f, condition});
+                u32(static_cast<uint32_t>(static_cast<int32_t>(target) - static_cast<int32_t>(position_ + 4)));
+            }
+
+        private:
+            uint8_t* code_ = nullptr;
+            uint32_t position_ = 0;
+        };
+
+        bool slotTypeOf(dsTypeId typeId, SlotType& out_type) noexcept
+        {
+            if (typeId == dsType<int32_t>.typeId)
+                out_type = SlotType::Int32;
+            else if (typeId == dsType<float>.typeId)
+                out_type = SlotType::Float32;
+            else if (typeId == dsType<bool>.typeId)
+                out_type = SlotType::Bool;
+            else
+                return false;
+            return true;
+        }
+
+        void emitBinary(Emitter& emit, uint32_t left, std::initializer_list<uint8_t> op) noexcept
+        {
+            // mov eax, [left]; <op> eax, [right]; mov [left], eax
+            emit.bytes({0x8b});
+            emit.slot(Eax, left);
+            emit.bytes(op);
+            emit.slot(Eax, left + 1);
+            emit.bytes({0x89});
+            emit.slot(Eax, left);
+        }
+
+        void emitBinaryF32(Emitter& emit, uint32_t left, uint8_t op) noexcept
+        {
+            // movss xmm0, [left]; <op>ss xmm0, [right]; movss [left], xmm0
+            emit.bytes({0xf3, 0x0f, 0x10});
+            emit.slot(Eax, left);
+            emit.bytes({0xf3, 0x0f, op});
+            emit.slot(Eax, left + 1);
+            emit.bytes({0xf3, 0x0f, 0x11});
+            emit.slot(Eax, left);
+        }
+
+        // <op>ss xmm0, [slot]; also loads with 0x10 and stores with 0x11
+        void emitF32(Emitter& emit, uint8_t op, uint32_t slot) noexcept
+        {
+            emit.bytes({0xf3, 0x0f, op});
+            emit.slot(Eax, slot);
+        }
+
+        // moves the right operand over the left where the comparison of left against right holds
+        void emitSelectI32(Emitter& emit, uint32_t left, uint8_t condition) noexcept
+        {
+            emit.bytes({0x8b}); // mov eax, [left]
+            emit.slot(Eax, left);
+            emit.bytes({0x3b}); // cmp eax, [right]
+            emit.slot(Eax, left + 1);
+            emit.bytes({0x0f, condition}); // cmov<cc> eax, [right]
+            emit.slot(Eax, left + 1);
+            emit.bytes({0x89}); // mov [left], eax
+            emit.slot(Eax, left);
+        }
+
+        // widens the flag in al into a boolean in the slot
+        void emitStoreFlag(Emitter& emit, uint32_t slot) noexcept
+        {
+            emit.bytes({0x0f, 0xb6, 0xc0}); // movzx eax, al
+            emit.bytes({0x89});             // mov [slot], eax
+            emit.slot(Eax, slot);
+        }
+
+        void emitCompareI32(Emitter& emit, uint32_t left, uint8_t condition) noexcept
+        {
+            emit.bytes({0x8b}); // mov eax, [left]
+            emit.slot(Eax, left);
+            emit.bytes({0x3b}); // cmp eax, [right]
+            emit.slot(Eax, left + 1);
+            emit.bytes({0x0f, condition, 0xc0}); // set<cc> al
+            emitStoreFlag(emit, left);
+        }
+
+        // ucomiss sets the flags as an unsigned comparison would, and all of them if either operand is NaN; the
+        // ordered comparisons test the greater operand against the lesser, so that above and above-or-equal are
+        // false for NaN, while equality also needs the parity flag
+        void emitCompareF32(Emitter& emit, uint32_t first, uint32_t second, uint8_t condition) noexcept
+        {
+            emitF32(emit, 0x10, first); // movss xmm0, [first]
+            emit.bytes({0x0f, 0x2e});   // ucomiss xmm0, [second]
+            emit.slot(Eax, second);
+            emit.bytes({0x0f, condition, 0xc0}); // set<cc> al
+        }
+
+        // matches the interpreter, where division by zero results in zero
+        void emitDivI32(Emitter& emit, uint32_t left) noexcept
+        {
+            emit.bytes({0x8b}); // mov ecx, [right]
+            emit.slot(Ecx, left + 1);
+            emit.bytes({0x85, 0xc9}); // test ecx, ecx
+            uint32_t const jumpZero = emit.jump8(0x74);
+            emit.bytes({0x83, 0xf9, 0xff}); // cmp ecx, -1; idiv would fault on INT_MIN / -1
+            uint32_t const jumpNegate = emit.jump8(0x74);
+            emit.bytes({0x8b}); // mov eax, [left]
+            emit.slot(Eax, left);
+            emit.bytes({0x99, 0xf7, 0xf9}); // cdq; idiv ecx
+            emit.bytes({0x89});             // mov [left], eax
+            emit.slot(Eax, left);
+            uint32_t const jumpDone = emit.jump8(0xeb);
+            emit.bind8(jumpZero);
+            emit.bytes({0xc7}); // mov dword [left], 0
+            emit.slot(0, left);
+            emit.u32(0);
+            uint32_t const jumpZeroDone = emit.jump8(0xeb);
+            emit.bind8(jumpNegate);
+            emit.bytes({0xf7}); // neg dword [left]
+            emit.slot(3, left);
+            emit.bind8(jumpDone);
+            emit.bind8(jumpZeroDone);
+        }
+
+        // matches the interpreter, where division by zero results in zero; NaN compares unequal to zero
+        void emitDivF32(Emitter& emit, uint32_t left) noexcept
+        {
+            emit.bytes({0xf3, 0x0f, 0x10}); // movss xmm1, [right]
+            emit.slot(Ecx, left + 1);
+            emit.bytes({0x0f, 0x57, 0xd2}); // xorps xmm2, xmm2
+            emit.bytes({0x0f, 0x2e, 0xca}); // ucomiss xmm1, xmm2
+            uint32_t const jumpUnordered = emit.jump8(0x7a);
+            uint32_t const jumpZero = emit.jump8(0x74);
+            emit.bind8(jumpUnordered);
+            emit.bytes({0xf3, 0x0f, 0x10}); // movss xmm0, [left]
+            emit.slot(Eax, left);
+            emit.bytes({0xf3, 0x0f, 0x5e, 0xc1}); // divss xmm0, xmm1
+            emit.bytes({0xf3, 0x0f, 0x11});       // movss [left], xmm0
+            emit.slot(Eax, left);
+            uint32_t const jumpDone = emit.jump8(0xeb);
+            emit.bind8(jumpZero);
+            emit.bytes({0xc7}); // mov dword [left], 0
+            emit.slot(0, left);
+            emit.u32(0);
+            emit.bind8(jumpDone);
+        }
+
+        // checks the type of the variable against the one the code is specialized to, then loads it
+        bool emitRead(Emitter& emit, dsValueStorage const* variables, uint32_t variableIndex, SlotType& out_type, uint32_t slot) noexcept
+        {
+            dsValueStorage const& variable = variables[variableIndex];
+            if (!slotTypeOf(variable.type(), out_type))
+                return false;
+
+            uint32_t const offset = variableIndex * static_cast<uint32_t>(sizeof(dsValueStorage));
+
+            emit.bytes({0x48, 0x8b, 0x87}); // mov rax, [rdi + meta]
+            emit.u32(offset + dsValueStorage::metaOffset());
+            emit.bytes({0x81, 0x78, static_cast<uint8_t>(offsetof(dsTypeMeta, typeId))}); // cmp dword [rax + typeId], imm32
+            emit.u32(variable.type().value());
+            emit.jumpBack32(0x85, 0); // jne fail
+
+            if (out_type == SlotType::Bool)
+                emit.bytes({0x0f, 0xb6, 0x87}); // movzx eax, byte [rdi + storage]
+            else
+                emit.bytes({0x8b, 0x87}); // mov eax, [rdi + storage]
+            emit.u32(offset + dsValueStorage::storageOffset());
+            emit.bytes({0x89}); // mov [slot], eax
+            emit.slot(Eax, slot);
+            return true;
+        }
+
+        // a packed variable only ever holds its own type, so it is loaded without any check; variables held in
+        // storage are of types the code generator does not support
+        bool emitRead(Emitter& emit, dsPackedVariables const* variables, uint32_t variableIndex, SlotType& out_type, uint32_t slot) noexcept
+        {
+            dsVariableLayout const& layout = variables->layout;
+
+            uint32_t array = 0;
+            uint32_t offset = 0;
+            if (layout.packs<int32_t>(variableIndex))
+            {
+                out_type = SlotType::Int32;
+                array = offsetof(dsPackedVariables, int32s);
+                offset = variableIndex * static_cast<uint32_t>(sizeof(int32_t));
+            }
+            else if (layout.packs<float>(variableIndex))
+            {
+                out_type = SlotType::Float32;
+                array = offsetof(dsPackedVariables, float32s);
+                offset = (variableIndex - layout.float32Start) * static_cast<uint32_t>(sizeof(float));
+            }
+            else if (layout.packs<bool>(variableIndex))
+            {
+                out_type = SlotType::Bool;
+                array = offsetof(dsPackedVariables, boolBits);
+                offset = (variableIndex - layout.boolStart) / 64 * static_cast<uint32_t>(sizeof(uint64_t));
+            }
+            else
+                return false;
+
+            emit.bytes({0x48, 0x8b, 0x87}); // mov rax, [rdi + array]
+            emit.u32(array);
+            if (out_type == SlotType::Bool)
+            {
+                emit.bytes({0x48, 0x8b, 0x80}); // mov rax, [rax + word]
+                emit.u32(offset);
+                emit.bytes({0x48, 0xc1, 0xe8, static_cast<uint8_t>((variableIndex - layout.boolStart) % 64)}); // shr rax, bit
+                emit.bytes({0x83, 0xe0, 0x01});                                                                // and eax, 1
+            }
+            else
+            {
+                emit.bytes({0x8b, 0x80}); // mov eax, [rax + offset]
+                emit.u32(offset);
+            }
+            emit.bytes({0x89}); // mov [slot], eax
+            emit.slot(Eax, slot);
+            return true;
+        }
+
+        void emitImmediate(Emitter& emit, uint32_t slot, uint32_t value) noexcept
+        {
+            emit.bytes({0xc7}); // mov dword [slot], imm32
+            emit.slot(0, slot);
+            emit.u32(value);
+        }
+
+        // splits a superinstruction into the instructions it fuses, which the code generator handles alone;
+        // any other instruction is returned as is
+        uint32_t unfuse(dsAssemblyInstruction const& instruction, dsAssemblyInstruction (&out_parts)[2]) noexcept
+        {
+            // the parts are assigned field by field, as a designated initializer would leave out the operand union
+            out_parts[0] = {};
+            out_parts[1] = {};
+
+            switch (instruction.op)
+            {
+            case dsOpCode::ReadRead:
+                out_parts[0].op = dsOpCode::Read;
+                out_parts[0].variableIndex = instruction.variableIndices[0];
+                out_parts[1].op = dsOpCode::Read;
+                out_parts[1].variableIndex = instruction.variableIndices[1];
+                return 2;
+            case dsOpCode::AddReadI32: out_parts[1].op = dsOpCode::AddI32; break;
+            case dsOpCode::AddReadF32: out_parts[1].op = dsOpCode::AddF32; break;
+            case dsOpCode::SubReadI32: out_parts[1].op = dsOpCode::SubI32; break;
+            case dsOpCode::SubReadF32: out_parts[1].op = dsOpCode::SubF32; break;
+            case dsOpCode::MulReadI32: out_parts[1].op = dsOpCode::MulI32; break;
+            case dsOpCode::MulReadF32: out_parts[1].op = dsOpCode::MulF32; break;
+            case dsOpCode::AddImmI32:
+            case dsOpCode::SubImmI32:
+            case dsOpCode::MulImmI32:
+                out_parts[0].op = dsOpCode::PushS16;
+                out_parts[0].immediate = instruction.immediate;
+                if (instruction.op == dsOpCode::AddImmI32)
+                    out_parts[1].op = dsOpCode::AddI32;
+                else if (instruction.op == dsOpCode::SubImmI32)
+                    out_parts[1].op = dsOpCode::SubI32;
+                else
+                    out_parts[1].op = dsOpCode::MulI32;
+                return 2;
+            default: out_parts[0] = instruction; return 1;
+            }
+
+            out_parts[0].op = dsOpCode::Read;
+            out_parts[0].variableIndex = instruction.variableIndex;
+            return 2;
+        }
+
+        // generates code for the expression into the buffer, which must hold s_maxInstructionBytes per instruction
+        // plus the entry offset and epilogue; fails on operations or types which are not supported
+        template <typename VariableT>
+        bool generate(dsAssembly const& assembly, dsAssemblyDecodedExpression const& expression, VariableT const* variables,
+            uint8_t* code, uint32_t& out_size, dsTypeMeta const*& out_resultMeta) noexcept
+        {
+            if (expression.maxStack > s_maxSlots)
+                return false;
+
+            Emitter emit(code);
+
+            // fail: xor eax, eax; ret
+            emit.bytes({0x31, 0xc0, 0xc3});
+            while (emit.position() != s_entryOffset)
+                emit.bytes({0xcc});
+
+            SlotType types[s_maxSlots];
+            uint32_t top = 0;
+
+            // operands must have the types the op-code is specialized for, as the interpreter does not check either
+            auto const operands = [&types, &top](uint32_t count, SlotType type) {
+                for (uint32_t index = top - count; index != top; ++index)
+                    if (types[index] != type)
+                        return false;
+                return true;
+            };
+
+            dsAssemblyInstruction const* const instructions = assembly.instructions.data() + expression.instructionStart;
+            for (dsAssemblyInstruction const* instruction = instructions; instruction != instructions + expression.instructionCount;
+                 ++instruction)
+            {
+                dsAssemblyInstruction parts[2];
+                uint32_t const partCount = unfuse(*instruction, parts);
+                for (dsAssemblyInstruction const* ip = parts; ip != parts + partCount; ++ip)
+                {
+                    switch (ip->op)
+                    {
+                    case dsOpCode::Nop: break;
+                    case dsOpCode::PushTrue:
+                    case dsOpCode::PushFalse:
+                        emitImmediate(emit, top, ip->op == dsOpCode::PushTrue ? 1 : 0);
+                        types[top++] = SlotType::Bool;
+                        break;
+                    case dsOpCode::Push0:
+                    case dsOpCode::Push1:
+                    case dsOpCode::Push2:
+                    case dsOpCode::PushNeg1:
+                    case dsOpCode::PushS8:
+                    case dsOpCode::PushU8:
+                    case dsOpCode::PushS16:
+                    case dsOpCode::PushU16:
+                        emitImmediate(emit, top, static_cast<uint32_t>(ip->immediate));
+                        types[top++] = SlotType::Int32;
+                        break;
+                    case dsOpCode::PushConstant: {
+                        dsValueStorage const& constant = *ip->constant;
+                        if (!slotTypeOf(constant.type(), types[top]))
+                            return false;
+                        uint32_t bits = 0;
+                        if (types[top] == SlotType::Bool)
+                            bits = constant.as<bool>() ? 1 : 0;
+                        else
+                            std::memcpy(&bits, constant.pointer(), sizeof(bits));
+                        emitImmediate(emit, top++, bits);
+                        break;
+                    }
+                    case dsOpCode::Read:
+                    case dsOpCode::ReadI32:
+                    case dsOpCode::ReadF32:
+                    case dsOpCode::ReadB:
+                        if (!emitRead(emit, variables, ip->variableIndex, types[top], top))
+                            return false;
+                        ++top;
+                        break;
+                    case dsOpCode::NegI32:
+                        if (!operands(1, SlotType::Int32))
+                            return false;
+                        emit.bytes({0xf7}); // neg dword [top]
+                        emit.slot(3, top - 1);
+                        break;
+                    case dsOpCode::NegF32:
+                        if (!operands(1, SlotType::Float32))
+                            return false;
+                        emit.bytes({0x81}); // xor dword [top], sign
+                        emit.slot(6, top - 1);
+                        emit.u32(0x8000'0000u);
+                        break;
+                    case dsOpCode::NotB:
+                        if (!operands(1, SlotType::Bool))
+                            return false;
+                        emit.bytes({0x83}); // xor dword [top], 1
+                        emit.slot(6, top - 1);
+                        emit.bytes({0x01});
+                        break;
+                    case dsOpCode::AddI32:
+                    case dsOpCode::SubI32:
+                    case dsOpCode::MulI32:
+                        if (!operands(2, SlotType::Int32))
+                            return false;
+                        --top;
+                        if (ip->op == dsOpCode::AddI32)
+                            emitBinary(emit, top - 1, {0x03});
+                        else if (ip->op == dsOpCode::SubI32)
+                            emitBinary(emit, top - 1, {0x2b});
+                        else
+                            emitBinary(emit, top - 1, {0x0f, 0xaf});
+                        break;
+                    case dsOpCode::DivI32:
+                        if (!operands(2, SlotType::Int32))
+                            return false;
+                        --top;
+                        emitDivI32(emit, top - 1);
+                        break;
+                    case dsOpCode::AddF32:
+                    case dsOpCode::SubF32:
+                    case dsOpCode::MulF32:
+                        if (!operands(2, SlotType::Float32))
+                            return false;
+                        --top;
+                        if (ip->op == dsOpCode::AddF32)
+                            emitBinaryF32(emit, top - 1, 0x58);
+                        else if (ip->op == dsOpCode::SubF32)
+                            emitBinaryF32(emit, top - 1, 0x5c);
+                        else
+                            emitBinaryF32(emit, top - 1, 0x59);
+                        break;
+                    case dsOpCode::DivF32:
+                        if (!operands(2, SlotType::Float32))
+                            return false;
+                        --top;
+                        emitDivF32(emit, top - 1);
+                        break;
+                    case dsOpCode::AndB:
+                    case dsOpCode::OrB:
+                    case dsOpCode::XorB:
+                        if (!operands(2, SlotType::Bool))
+                            return false;
+                        --top;
+                        if (ip->op == dsOpCode::AndB)
+                            emitBinary(emit, top - 1, {0x23});
+                        else if (ip->op == dsOpCode::OrB)
+                            emitBinary(emit, top - 1, {0x0b});
+                        else
+                            emitBinary(emit, top - 1, {0x33});
+                        break;
+                    case dsOpCode::MinI32:
+                    case dsOpCode::MaxI32:
+                        if (!operands(2, SlotType::Int32))
+                            return false;
+                        --top;
+                        emitSelectI32(emit, top - 1, ip->op == dsOpCode::MinI32 ? 0x4f : 0x4c); // cmovg or cmovl
+                        break;
+                    case dsOpCode::MinF32:
+                    case dsOpCode::MaxF32:
+                        if (!operands(2, SlotType::Float32))
+                            return false;
+                        --top;
+                        emitBinaryF32(emit, top - 1, ip->op == dsOpCode::MinF32 ? 0x5d : 0x5f);
+                        break;
+                    case dsOpCode::AbsI32:
+                        if (!operands(1, SlotType::Int32))
+                            return false;
+                        emit.bytes({0x8b}); // mov eax, [top]
+                        emit.slot(Eax, top - 1);
+                        emit.bytes({0x99, 0x31, 0xd0, 0x29, 0xd0}); // cdq; xor eax, edx; sub eax, edx
+                        emit.bytes({0x89});                         // mov [top], eax
+                        emit.slot(Eax, top - 1);
+                        break;
+                    case dsOpCode::AbsF32:
+                        if (!operands(1, SlotType::Float32))
+                            return false;
+                        emit.bytes({0x81}); // and dword [top], ~sign
+                        emit.slot(4, top - 1);
+                        emit.u32(0x7fff'ffffu);
+                        break;
+                    case dsOpCode::SqrtF32:
+                        if (!operands(1, SlotType::Float32))
+                            return false;
+                        emitF32(emit, 0x51, top - 1); // sqrtss xmm0, [top]
+                        emitF32(emit, 0x11, top - 1); // movss [top], xmm0
+                        break;
+                    case dsOpCode::ClampI32:
+                        if (!operands(3, SlotType::Int32))
+                            return false;
+                        top -= 2;
+                        emit.bytes({0x8b}); // mov eax, [value]
+                        emit.slot(Eax, top - 1);
+                        emit.bytes({0x3b}); // cmp eax, [low]
+                        emit.slot(Eax, top);
+                        emit.bytes({0x0f, 0x4c}); // cmovl eax, [low]
+                        emit.slot(Eax, top);
+                        emit.bytes({0x3b}); // cmp eax, [high]
+                        emit.slot(Eax, top + 1);
+                        emit.bytes({0x0f, 0x4f}); // cmovg eax, [high]
+                        emit.slot(Eax, top + 1);
+                        emit.bytes({0x89}); // mov [value], eax
+                        emit.slot(Eax, top - 1);
+                        break;
+                    case dsOpCode::ClampF32:
+                        if (!operands(3, SlotType::Float32))
+                            return false;
+                        top -= 2;
+                        emitF32(emit, 0x10, top - 1); // movss xmm0, [value]
+                        emitF32(emit, 0x5f, top);     // maxss xmm0, [low]
+                        emitF32(emit, 0x5d, top + 1); // minss xmm0, [high]
+                        emitF32(emit, 0x11, top - 1); // movss [value], xmm0
+                        break;
+                    case dsOpCode::LerpF32:
+                        if (!operands(3, SlotType::Float32))
+                            return false;
+                        top -= 2;
+                        emitF32(emit, 0x10, top);     // movss xmm0, [to]
+                        emitF32(emit, 0x5c, top - 1); // subss xmm0, [from]
+                        emitF32(emit, 0x59, top + 1); // mulss xmm0, [t]
+                        emitF32(emit, 0x58, top - 1); // addss xmm0, [from]
+                        emitF32(emit, 0x11, top - 1); // movss [from], xmm0
+                        break;
+                    case dsOpCode::EqI32:
+                    case dsOpCode::NeI32:
+                    case dsOpCode::LtI32:
+                    case dsOpCode::LeI32:
+                    case dsOpCode::GtI32:
+                    case dsOpCode::GeI32:
+                    case dsOpCode::EqB:
+                    case dsOpCode::NeB: {
+                        bool const isBool = ip->op == dsOpCode::EqB || ip->op == dsOpCode::NeB;
+                        if (!operands(2, isBool ? SlotType::Bool : SlotType::Int32))
+                            return false;
+                        --top;
+                        uint8_t condition = 0x94; // sete
+                        switch (ip->op)
+                        {
+                        case dsOpCode::NeI32:
+                        case dsOpCode::NeB: condition = 0x95; break;   // setne
+                        case dsOpCode::LtI32: condition = 0x9c; break; // setl
+                        case dsOpCode::LeI32: condition = 0x9e; break; // setle
+                        case dsOpCode::GtI32: condition = 0x9f; break; // setg
+                        case dsOpCode::GeI32: condition = 0x9d; break; // setge
+                        default: break;
+                        }
+                        emitCompareI32(emit, top - 1, condition);
+                        types[top - 1] = SlotType::Bool;
+                        break;
+                    }
+                    case dsOpCode::EqF32:
+                    case dsOpCode::NeF32:
+                    case dsOpCode::LtF32:
+                    case dsOpCode::LeF32:
+                    case dsOpCode::GtF32:
+                    case dsOpCode::GeF32:
+                        if (!operands(2, SlotType::Float32))
+                            return false;
+                        --top;
+                        if (ip->op == dsOpCode::EqF32)
+                        {
+                            emitCompareF32(emit, top - 1, top, 0x94);   // sete al
+                            emit.bytes({0x0f, 0x9b, 0xc1, 0x20, 0xc8}); // setnp cl; and al, cl
+                        }
+                        else if (ip->op == dsOpCode::NeF32)
+                        {
+                            emitCompareF32(emit, top - 1, top, 0x95);   // setne al
+                            emit.bytes({0x0f, 0x9a, 0xc1, 0x08, 0xc8}); // setp cl; or al, cl
+                        }
+                        else if (ip->op == dsOpCode::LtF32)
+                            emitCompareF32(emit, top, top - 1, 0x97); // seta
+                        else if (ip->op == dsOpCode::LeF32)
+                            emitCompareF32(emit, top, top - 1, 0x93); // setae
+                        else if (ip->op == dsOpCode::GtF32)
+                            emitCompareF32(emit, top - 1, top, 0x97); // seta
+                        else
+                            emitCompareF32(emit, top - 1, top, 0x93); // setae
+                        emitStoreFlag(emit, top - 1);
+                        types[top - 1] = SlotType::Bool;
+                        break;
+                    case dsOpCode::Select:
+                        if (types[top - 3] != SlotType::Bool || types[top - 2] != types[top - 1])
+                            return false;
+                        top -= 2;
+                        emit.bytes({0x8b}); // mov eax, [ifTrue]
+                        emit.slot(Eax, top);
+                        emit.bytes({0x83}); // cmp dword [condition], 0
+                        emit.slot(7, top - 1);
+                        emit.bytes({0x00});
+                        emit.bytes({0x0f, 0x44}); // cmove eax, [ifFalse]
+                        emit.slot(Eax, top + 1);
+                        emit.bytes({0x89}); // mov [condition], eax
+                        emit.slot(Eax, top - 1);
+                        types[top - 1] = types[top];
+                        break;
+                    // nil has no native representation, functions are only invoked through the interpreter,
+                    // rounding instructions are not part of the SSE2 baseline, and the compiler only emits jumps
+                    // to skip calls, which are not compiled anyway
+                    case dsOpCode::PushNil:
+                    case dsOpCode::Call:
+                    case dsOpCode::FloorF32:
+                    case dsOpCode::Jump:
+                    case dsOpCode::JumpIfFalse:
+                    case dsOpCode::JumpIfFalseOrPop:
+                    case dsOpCode::JumpIfTrueOrPop:
+                    default: return false;
+                    }
+                }
+            }
+
+            DS_ASSERT(top == 1);
+
+            emit.bytes({0x8b}); // mov eax, [0]
+            emit.slot(Eax, 0);
+            if (types[0] == SlotType::Bool)
+                emit.bytes({0x88, 0x06}); // mov [rsi], al
+            else
+                emit.bytes({0x89, 0x06});               // mov [rsi], eax
+            emit.bytes({0xb8, 0x01, 0x00, 0x00, 0x00}); // mov eax, 1
+            emit.bytes({0xc3});                         // ret
+
+            out_size = emit.position();
+            switch (types[0])
+            {
+            case SlotType::Int32: out_resultMeta = &dsType<int32_t>; break;
+            case SlotType::Float32: out_resultMeta = &dsType<float>; break;
+            case SlotType::Bool: out_resultMeta = &dsType<bool>; break;
+            }
+            return true;
+        }
+    } // namespace
+
+    template <typename VariableT>
+    static bool compile(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex, VariableT const* variables,
+        dsJitExpression& jit) noexcept
+    {
+        DS_GUARD_OR(jit.code == nullptr, false);
+
+        dsAssemblyDecodedExpression const& expression = assembly.decodedExpressions[expressionIndex];
+
+        uint32_t const pageSize = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+        uint32_t const maxSize = s_entryOffset + (expression.instructionCount + 1) * s_maxInstructionBytes;
+        uint32_t const codeSize = (maxSize + pageSize - 1) / pageSize * pageSize;
+
+        // code is written while the pages are writable and only then made executable, never both at once
+        void* const code = mmap(nullptr, codeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED)
+            return false;
+
+        uint32_t size = 0;
+        dsTypeMeta const* resultMeta = nullptr;
+        if (!generate(assembly, expression, variables, static_cast<uint8_t*>(code), size, resultMeta) ||
+            mprotect(code, codeSize, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(code, codeSize);
+            return false;
+        }
+        DS_ASSERT(size <= maxSize);
+
+        jit.code = code;
+        jit.codeSize = codeSize;
+        jit.resultMeta = resultMeta;
+        jit.packed = std::is_same_v<VariableT, dsPackedVariables>;
+        jit.function.store(reinterpret_cast<dsJitFunction>(static_cast<uint8_t*>(code) + s_entryOffset), std::memory_order_release);
+        return true;
+    }
+
+    bool dsJitCompile(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex, dsValueStorage const* variables,
+        dsJitExpression& jit) noexcept
+    {
+        return compile(assembly, expressionIndex, variables, jit);
+    }
+
+    bool dsJitCompile(dsAssembly const& assembly, dsAssemblyExpressionIndex expressionIndex, dsPackedVariables const* variables,
+        dsJitExpression& jit) noexcept
+    {
+        return compile(assembly, expressionIndex, variables, jit);
+    }
+
+    void dsJitRelease(dsJitExpression& jit) noexcept
+    {
+        if (jit.code == nullptr)
+            return;
+
+        jit.function.store(nullptr, std::memory_order_relaxed);
+        munmap(jit.code, jit.codeSize);
+        jit.code = nullptr;
+        jit.codeSize = 0;
+    }
+} // namespace descript
+
+#endif // DS_JIT
@@ -0,0 +1,39 @@
+// descript
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// native code generation is only implemented for the System V x86-64 ABI
+#if !defined(DS_JIT)
+#if defined(__x86_64__) && defined(__linux__)
+#define DS_JIT 1
+#else
+#define DS_JIT 0
+#endif
+#endif
+
+namespace descript {
+    struct dsTypeMeta;
+
+    /// Compiled form of an expression, reading variables held in the form it was compiled for. Fails,
+    /// without writing a result, if a variable does not hold the type the code was specialized to; the
+    /// caller then falls back to the interpreter.
+    using dsJitFunction = bool (*)(void const* variables, void* out_result) noexcept;
+
+    /// Expressions are compiled once they have been evaluated this many times.
+    inline constexpr uint32_t dsJitPromotionThreshold = 256;
+
+    /// Native code tier of a single expression. The function is published last, so a reader
+    /// which observes it may also read the other members.
+    struct dsJitExpression
+    {
+        std::atomic<dsJitFunction> function = nullptr;
+        std::atomic<uint32_t> evaluations = 0;
+        dsTypeMeta const* resultMeta = nullptr;
+        void* code = nullptr;
+        uint32_t codeSize = 0;
+        bool packed = false; // variables are read as dsPackedVariables rather than an array of dsValueStorage
+    };
+} // namespace descript
@@ -0,0 +1,113 @@
+// descript
+
+#pragma once
+
+#include "descript/alloc.hh"
+
+#include "assert.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace descript {
+    /// Bounded lock-free queue accepting values from any number of threads,
+    /// drained by a single consumer thread.
+    ///
+    /// Each cell carries a sequence number which tells producers and the consumer
+    /// whether the cell is free to write or ready to read for a given position.
+    template <typename T>
+    class dsMpscRing
+    {
+    public:
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        /// capacity must be a power of two
+        dsMpscRing(dsAllocator& allocator, uint32_t capacity) noexcept;
+        ~dsMpscRing() noexcept;
+
+        dsMpscRing(dsMpscRing const&) = delete;
+        dsMpscRing& operator=(dsMpscRing const&) = delete;
+
+        /// Returns false without blocking if the ring is full.
+        [[nodiscard]] bool tryPush(T const& value) noexcept;
+
+        /// Must only be called from the consumer thread.
+        [[nodiscard]] bool tryPop(T& out_value) noexcept;
+
+    private:
+        struct Cell
+        {
+            std::atomic<uint64_t> sequence;
+            T value;
+        };
+
+        Cell* cells_ = nullptr;
+        uint32_t mask_ = 0;
+        dsAllocator& allocator_;
+        alignas(64) std::atomic<uint64_t> pushPosition_ = 0;
+        alignas(64) uint64_t popPosition_ = 0;
+    };
+
+    template <typename T>
+    dsMpscRing<T>::dsMpscRing(dsAllocator& allocator, uint32_t capacity) noexcept : mask_(capacity - 1), allocator_(allocator)
+    {
+        DS_ASSERT(capacity != 0 && (capacity & (capacity - 1)) == 0);
+
+        cells_ = static_cast<Cell*>(allocator_.allocate(capacity * sizeof(Cell), alignof(Cell)));
+        for (uint32_t index = 0; index != capacity; ++index)
+            new (&cells_[index].sequence) std::atomic<uint64_t>(index);
+    }
+
+    template <typename T>
+    dsMpscRing<T>::~dsMpscRing() noexcept
+    {
+        allocator_.free(cells_, (mask_ + 1) * sizeof(Cell), alignof(Cell));
+    }
+
+    template <typename T>
+    bool dsMpscRing<T>::tryPush(T const& value) noexcept
+    {
+        uint64_t position = pushPosition_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells_[position & mask_];
+            uint64_t const sequence = cell.sequence.load(std::memory_order_acquire);
+            int64_t const diff = static_cast<int64_t>(sequence - position);
+
+            if (diff == 0)
+            {
+                // the cell is free for this position; claim it
+                if (pushPosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // the cell still holds a value from the previous lap
+                return false;
+            }
+            else
+            {
+                position = pushPosition_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template <typename T>
+    bool dsMpscRing<T>::tryPop(T& out_value) noexcept
+    {
+        Cell& cell = cells_[popPosition_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != popPosition_ + 1)
+            return false;
+
+        out_value = cell.value;
+        cell.sequence.store(popPosition_ + mask_ + 1, std::memory_order_release);
+        ++popPosition_;
+        return true;
+    }
+} // namespace descript
@@ -27,25 +27,119 @@ namespace descript {
         // generic constant push
         PushConstant,
 
-        // variable access
+        // variable access; the typed reads are only emitted for variables declared with their type, so that
+        // they can read packed variables without checking the type held
         Read,
+        ReadI32,
+        ReadF32,
+        ReadB,
 
         // function access
         Call,
 
-        // unary operators
-        Neg,
-        Not,
+        // unary operators, typed by their operand
+        NegI32,
+        NegF32,
+        NotB,
 
-        // binary operators
-        Add,
-        Sub,
-        Mul,
-        Div,
-        And,
-        Or,
-        Xor,
+        // binary operators, typed by their (homogenous) operands
+        AddI32,
+        AddF32,
+        SubI32,
+        SubF32,
+        MulI32,
+        MulF32,
+        DivI32,
+        DivF32,
+        AndB,
+        OrB,
+        XorB,
+
+        // math intrinsics, typed by their (homogenous) operands; min, max and clamp follow the
+        // operand order of the SSE instructions, so every evaluator agrees on the result for NaN
+        MinI32,
+        MinF32,
+        MaxI32,
+        MaxF32,
+        AbsI32,
+        AbsF32,
+        FloorF32,
+        SqrtF32,
+        ClampI32, // value, low, high
+        ClampF32, // value, low, high
+        LerpF32,  // from, to, t
+
+        // comparisons, typed by their (homogenous) operands and resulting in a boolean
+        EqI32,
+        EqF32,
+        EqB,
+        NeI32,
+        NeF32,
+        NeB,
+        LtI32,
+        LtF32,
+        LeI32,
+        LeF32,
+        GtI32,
+        GtF32,
+        GeI32,
+        GeF32,
+
+        // condition, value if true, value if false; evaluates both values, so it cannot skip a call
+        Select,
+
+        // forward jumps by the 16-bit byte offset which follows them, measured from the next op-code
+        Jump,
+        JumpIfFalse,      // pops the condition
+        JumpIfFalseOrPop, // keeps the condition as the result if jumping, so that it implements and
+        JumpIfTrueOrPop,  // keeps the condition as the result if jumping, so that it implements or
+
+        // superinstructions, each fusing a frequent sequence of the op-codes above into one dispatch;
+        // only emitted by the peephole pass of optimized builds
+        ReadRead,   // Read, Read
+        AddReadI32, // Read, AddI32
+        AddReadF32, // Read, AddF32
+        SubReadI32, // Read, SubI32
+        SubReadF32, // Read, SubF32
+        MulReadI32, // Read, MulI32
+        MulReadF32, // Read, MulF32
+        AddImmI32,  // PushS16, AddI32
+        SubImmI32,  // PushS16, SubI32
+        MulImmI32,  // PushS16, MulI32
 
         Last,
     };
+
+    /// Number of operand bytes which follow the op-code in byte code.
+    constexpr uint32_t dsOpOperandBytes(dsOpCode op) noexcept
+    {
+        switch (op)
+        {
+        case dsOpCode::PushS8:
+        case dsOpCode::PushU8: return 1;
+        case dsOpCode::PushS16:
+        case dsOpCode::PushU16:
+        case dsOpCode::PushConstant:
+        case dsOpCode::Read:
+        case dsOpCode::ReadI32:
+        case dsOpCode::ReadF32:
+        case dsOpCode::ReadB:
+        case dsOpCode::AddReadI32:
+        case dsOpCode::AddReadF32:
+        case dsOpCode::SubReadI32:
+        case dsOpCode::SubReadF32:
+        case dsOpCode::MulReadI32:
+        case dsOpCode::MulReadF32:
+        case dsOpCode::AddImmI32:
+        case dsOpCode::SubImmI32:
+        case dsOpCode::MulImmI32:
+        case dsOpCode::Jump:
+        case dsOpCode::JumpIfFalse:
+        case dsOpCode::JumpIfFalseOrPop:
+        case dsOpCode::JumpIfTrueOrPop: return 2;
+        case dsOpCode::Call: return 3;
+        case dsOpCode::ReadRead: return 4;
+        default: return 0;
+        }
+    }
 } // namespace descript
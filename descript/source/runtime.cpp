@@ -9,8 +9,15 @@
 
 #include "array.hh"
 #include "assembly_internal.hh"
+#include "evaluate_internal.hh"
 #include "fnv.hh"
+#include "hash_map.hh"
 #include "instance.hh"
+#include "mpsc_ring.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
 
 namespace descript {
     namespace {
@@ -29,10 +36,21 @@ namespace descript {
             bool writeVariable(dsInstanceId instanceId, dsName name, dsValueRef const& value) override;
             bool readVariable(dsInstanceId instanceId, dsName name, dsValueOut out_value) override;
 
+            dsVariableHandle lookupVariable(dsAssembly* assembly, dsName name) const noexcept override;
+            bool writeVariable(dsInstanceId instanceId, dsVariableHandle variable, dsValueRef const& value) override;
+            bool readVariable(dsInstanceId instanceId, dsVariableHandle variable, dsValueOut out_value) override;
+
+            bool readInputSlot(dsAssembly* assembly, dsNodeIndex nodeIndex, dsInputSlot inputSlot, dsInstanceId const* instanceIds,
+                uint32_t count, dsValueOut const* out_values) override;
+
             void processEvents() override;
+            void setProcessMode(dsProcessMode mode) noexcept override { mode_ = mode; }
 
             dsEmitterId makeEmitterId() override;
             void notifyChange(dsEmitterId emitterId) override;
+            bool postChange(dsEmitterId emitterId) noexcept override;
+
+            dsRuntimeStats stats() const noexcept override;
 
             dsAllocator& allocator() noexcept { return allocator_; }
 
@@ -40,20 +58,133 @@ namespace descript {
             class Context;
             class EvaluateHost;
 
+            struct InstanceSlot
+            {
+                dsInstance* instance = nullptr;
+                uint32_t generation = 0;
+                uint32_t nextFree = invalidSlot;
+            };
+
+            // listeners are linked into a list per emitter, so notifyChange only visits subscribers,
+            // and into a list per instance input slot, so a slot's listeners can be forgotten at once
             struct Listener
             {
                 dsInstanceId instanceId = dsInvalidInstanceId;
                 dsEmitterId emitterId = dsInvalidEmitterId;
                 uint32_t inputSlotIndex = 0;
+                uint32_t prevEmitterListener = invalidListener;
+                uint32_t nextEmitterListener = invalidListener;
+                uint32_t nextSlotListener = invalidListener; // doubles as the free list link
+            };
+
+            // changes to runtime-wide state made while instances are processed in parallel;
+            // these are recorded per worker (or per chunk, when deterministic) and applied afterwards
+            struct DeferredOp
+            {
+                enum class Kind : uint8_t
+                {
+                    AddListener,
+                    ForgetListener,
+                    NotifyChange,
+                };
+
+                Kind kind = Kind::NotifyChange;
+                dsInstanceId instanceId = dsInvalidInstanceId;
+                dsAssemblyInputSlotIndex inputSlotIndex = dsInvalidIndex;
+                dsEmitterId emitterId = dsInvalidEmitterId;
+            };
+
+            struct Batch
+            {
+                explicit Batch(dsAllocator& alloc) noexcept : deferred(alloc), scratch(alloc) {}
+
+                dsArray<DeferredOp> deferred;
+                dsEvaluateScratch scratch;
+                dsRuntimeStats stats;
+                uint64_t emitterCount = 0;
+            };
+
+            struct WorkerRange
+            {
+                alignas(64) std::atomic<uint32_t> nextChunk = 0;
+                uint32_t endChunk = 0;
             };
 
+            struct ParallelPass
+            {
+                Runtime* runtime = nullptr;
+                uint32_t instanceCount = 0;
+                uint32_t chunkCount = 0;
+                uint32_t workerCount = 0;
+                WorkerRange ranges[64];
+            };
+
+            // identifies the chunk the current thread is processing, if any
+            struct WorkerState
+            {
+                Runtime const* runtime = nullptr;
+                Batch* batch = nullptr;
+                uint32_t chunkIndex = 0;
+            };
+
+            static constexpr uint32_t invalidSlot = ~uint32_t{0};
+            static constexpr uint32_t invalidListener = dsInvalidListenerIndex;
+            static constexpr uint32_t maxGeneration = ~uint32_t{0} - 1;
+            static constexpr uint32_t parallelChunkSize = 64;
+            static constexpr uint32_t slotGroupSize = 64;
+            static constexpr uint32_t maxWorkers = sizeof(ParallelPass::ranges) / sizeof(ParallelPass::ranges[0]);
+            static constexpr uint32_t maxPostedChangeCapacity = uint32_t{1} << 24;
+
+            static thread_local WorkerState* currentWorker;
+
+            static constexpr dsInstanceId makeInstanceId(uint32_t slotIndex, uint32_t generation) noexcept
+            {
+                return dsInstanceId{(uint64_t{generation} << 32) | slotIndex};
+            }
+            static uint32_t postedChangeCapacity(dsRuntimeHost const& host) noexcept
+            {
+                return std::bit_ceil(std::clamp(host.postedChangeCapacity(), uint32_t{1}, maxPostedChangeCapacity));
+            }
+            static constexpr uint32_t instanceSlotIndex(dsInstanceId instanceId) noexcept
+            {
+                return static_cast<uint32_t>(instanceId.value());
+            }
+            static constexpr uint32_t instanceGeneration(dsInstanceId instanceId) noexcept
+            {
+                return static_cast<uint32_t>(instanceId.value() >> 32);
+            }
+
             dsInstance* findInstance(dsInstanceId instanceId) noexcept;
 
+            uint32_t allocateSlot();
+            void releaseSlot(uint32_t slotIndex) noexcept;
+
             void deleteInstance(dsInstance* instance);
 
             void sendLocalEvent(dsInstance& instance, dsAssemblyNodeIndex nodeIndex, dsEvent const& event);
+            void sendDependencyEvent(dsInstance& instance, dsAssemblyNodeIndex nodeIndex);
 
+            void drainPostedChanges();
             void processEvents(dsInstance& instance);
+            void processEventsParallel(dsRuntimeScheduler& scheduler);
+            static void runWorker(void* userData, uint32_t workerIndex);
+            void applyDeferred(Batch& batch);
+
+            Batch* deferredBatch() const noexcept
+            {
+                return parallel_ && currentWorker != nullptr && currentWorker->runtime == this ? currentWorker->batch : nullptr;
+            }
+            dsRuntimeStats& localStats() noexcept
+            {
+                Batch* const batch = deferredBatch();
+                return batch != nullptr ? batch->stats : stats_;
+            }
+            // a batch is only processed by one thread at a time, so its scratch memory is never shared
+            dsEvaluateScratch& localScratch() noexcept
+            {
+                Batch* const batch = deferredBatch();
+                return batch != nullptr ? batch->scratch : scratch_;
+            }
             void processEvent(dsInstance& instance, dsAssemblyNodeIndex, dsEvent const& event);
             void dispatchEvent(dsInstance& instance, dsAssemblyNodeIndex nodeIndex, dsEvent const& event);
 
@@ -67,29 +198,65 @@ namespace descript {
             bool writeSlot(dsInstance& instance, dsAssemblyNodeIndex nodeIndex, dsOutputSlot outputSlot, dsValueRef const& value);
 
             bool writeVariable(dsInstance& instance, uint64_t nameHash, dsValueRef const& value);
-            void writeVariable(dsInstance& instance, dsAssemblyVariableIndex variableIndex, dsAssemblyNodeIndex sourceNodeIndex,
+            bool writeVariable(dsInstance& instance, dsAssemblyVariableIndex variableIndex, dsAssemblyNodeIndex sourceNodeIndex,
                 dsValueRef const& value);
 
-            void addListener(dsInstanceId instanceId, uint32_t inputSlotIndex, dsEmitterId emitterId);
-            void forgetListener(dsInstanceId instanceId, uint32_t inputSlotIndex);
-            void forgetListener(dsInstanceId instanceId);
+            void addListener(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex, dsEmitterId emitterId);
+            void updateListeners(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex, uint64_t const* emitterIds,
+                uint32_t emitterCount);
+            void linkListener(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex, dsEmitterId emitterId);
+            void releaseListener(uint32_t listenerIndex) noexcept;
+            void forgetListener(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex);
+            void forgetListener(dsInstance& instance);
+            void unlinkEmitterListener(uint32_t listenerIndex) noexcept;
 
             void triggerDependencies(dsInstance& instance, dsAssemblyVariableIndex variableIndex, dsAssemblyNodeIndex sourceNodeIndex);
             void triggerChange(dsInstanceId instanceId, uint32_t inputSlotIndex);
 
             dsAllocator& allocator_;
-            dsArray<dsInstance*> instances_;
+            dsRuntimeHost& host_;
+            dsArray<InstanceSlot> instances_;
             dsArray<Listener> listeners_;
-            uint32_t nextInstanceId_ = 0;
-            uint64_t nextEmitterId_ = 0;
+            dsArray<dsInstanceId> pending_;
+            dsArray<dsInstanceId> processing_;
+            dsArray<Batch> batches_;
+            dsHashMap<uint64_t, uint32_t> emitterListeners_;
+            dsHashMap<uint64_t, bool> drainedChanges_;
+            uint32_t postedChangeCapacity_ = 0;
+            dsMpscRing<uint64_t> postedChanges_;
+            dsEvaluateScratch scratch_;
+            uint32_t freeSlot_ = invalidSlot;
+            uint32_t freeListener_ = invalidListener;
+            uint32_t chunkCount_ = 0;
+            std::atomic<uint64_t> nextEmitterId_ = 0;
+            std::atomic<uint64_t> rejectedPostedChanges_ = 0;
+            dsRuntimeStats stats_;
+            dsProcessMode mode_ = dsProcessMode::Serial;
+            bool parallel_ = false;
         };
 
-        Runtime::Runtime(dsAllocator& alloc, dsRuntimeHost& host) noexcept : allocator_(alloc), instances_(alloc), listeners_(alloc) {}
+        thread_local Runtime::WorkerState* Runtime::currentWorker = nullptr;
+
+        Runtime::Runtime(dsAllocator& alloc, dsRuntimeHost& host) noexcept
+            : allocator_(alloc),
+              host_(host),
+              instances_(alloc),
+              listeners_(alloc),
+              pending_(alloc),
+              processing_(alloc),
+              batches_(alloc),
+              emitterListeners_(alloc),
+              drainedChanges_(alloc),
+              postedChangeCapacity_(postedChangeCapacity(host)),
+              postedChanges_(alloc, postedChangeCapacity_),
+              scratch_(alloc)
+        {
+        }
 
         Runtime::~Runtime()
         {
-            for (dsInstance* instance : instances_)
-                deleteInstance(instance);
+            for (InstanceSlot& slot : instances_)
+                deleteInstance(slot.instance);
         }
     } // namespace
 
@@ -113,31 +280,40 @@ namespace descript {
     {
         DS_GUARD_OR(assembly != nullptr, dsInvalidInstanceId);
         DS_GUARD_OR(params != nullptr || paramCount == 0, dsInvalidInstanceId);
+        DS_GUARD_OR(!parallel_, dsInvalidInstanceId);
 
         dsAcquireAssembly(assembly);
 
         dsAssemblyHeader const& header = *assembly->header;
 
-        void* const memory = allocator_.allocate(assembly->instanceSize, alignof(dsInstance));
-        std::memset(memory, 0, assembly->instanceSize);
-
-        dsInstanceId const instanceId{nextInstanceId_++};
+        void* const memory = dsAllocateInstanceMemory(*assembly);
+        if (memory == nullptr)
+        {
+            dsReleaseAssembly(assembly);
+            return dsInvalidInstanceId;
+        }
 
-        dsInstance& instance = *instances_.pushBack(new (memory) dsInstance(allocator_, instanceId));
-        instance.assembly = assembly;
+        // the prototype's trailing data holds initialized values and bitsets, and its
+        // relative arrays are position independent, so a copy is all that is needed
+        auto const* const image = static_cast<uint8_t const*>(assembly->instanceImage);
+        std::memcpy(static_cast<uint8_t*>(memory) + sizeof(dsInstance), image + sizeof(dsInstance),
+            assembly->instanceSize - sizeof(dsInstance));
 
-        instance.activeNodes.assign(reinterpret_cast<uintptr_t>(&instance), assembly->instanceStatesOffset, header.nodes.count);
-        instance.activeInputPlugs.assign(reinterpret_cast<uintptr_t>(&instance), assembly->instanceInputPlugsOffset, header.inputPlugCount);
-        instance.activeOutputPlugs.assign(reinterpret_cast<uintptr_t>(&instance), assembly->instanceOutputPlugsOffset,
-            header.outputPlugs.count);
-        instance.values.assign(reinterpret_cast<uintptr_t>(&instance), assembly->instanceValuesOffset, header.variables.count);
+        uint32_t const slotIndex = allocateSlot();
+        InstanceSlot& slot = instances_[slotIndex];
 
-        // reset all variables, since the memset will leave them in an invalid state
-        for (uint32_t index = 0; index != instance.values.count; ++index)
-            instance.values[dsAssemblyVariableIndex(index)] = {};
+        dsInstance& instance = *new (memory)
+            dsInstance(allocator_, makeInstanceId(slotIndex, slot.generation), *reinterpret_cast<dsInstance const*>(image));
+        slot.instance = &instance;
 
+        // no nodes are active yet, so there are no dependencies to trigger
         for (uint32_t index = 0; index != paramCount; ++index)
-            writeVariable(instance, dsHashFnv1a64(params[index].name.name, params[index].name.nameEnd), dsValueRef{params[index].value});
+        {
+            dsAssemblyVariableIndex const variableIndex =
+                dsFindAssemblyVariable(*assembly, dsHashFnv1a64(params[index].name.name, params[index].name.nameEnd));
+            if (variableIndex != dsInvalidIndex)
+                static_cast<void>(instance.assignVariable(variableIndex, dsValueRef{params[index].value}));
+        }
 
         for (dsAssemblyNodeIndex nodeIndex : header.entryNodes)
             sendLocalEvent(instance, nodeIndex, {.type = dsEventType::Activate});
@@ -147,20 +323,19 @@ namespace descript {
 
     void Runtime::destroyInstance(dsInstanceId instanceId)
     {
-        for (dsInstance*& instance : instances_)
-        {
-            if (instance != nullptr && instance->instanceId == instanceId)
-            {
-                // immediately deactivate all nodes
-                for (dsAssemblyNodeIndex nodeIndex{0}; nodeIndex != instance->activeNodes.count; ++nodeIndex)
-                    if (instance->activeNodes[nodeIndex])
-                        dispatchEvent(*instance, nodeIndex, {.type = dsEventType::Deactivate});
+        DS_GUARD_VOID(!parallel_);
 
-                deleteInstance(instance);
-                instance = nullptr;
-                break;
-            }
-        }
+        dsInstance* const instance = findInstance(instanceId);
+        if (instance == nullptr)
+            return;
+
+        // immediately deactivate all nodes
+        for (dsAssemblyNodeIndex nodeIndex{0}; nodeIndex != instance->activeNodes.count; ++nodeIndex)
+            if (instance->activeNodes[nodeIndex])
+                dispatchEvent(*instance, nodeIndex, {.type = dsEventType::Deactivate});
+
+        releaseSlot(instanceSlotIndex(instanceId));
+        deleteInstance(instance);
     }
 
     bool Runtime::writeVariable(dsInstanceId instanceId, dsName name, dsValueRef const& value)
@@ -182,80 +357,509 @@ namespace descript {
 
         uint64_t const variableHash = dsHashFnv1a64(variable.name, variable.nameEnd);
 
-        dsAssemblyHeader const& header = *instance->assembly->header;
-        for (dsAssemblyVariableIndex variableIndex{0}; variableIndex != header.variables.count; ++variableIndex)
-            if (header.variables[variableIndex].nameHash == variableHash)
-                return out_value.accept(instance->values[variableIndex].ref());
+        dsAssemblyVariableIndex const variableIndex = dsFindAssemblyVariable(*instance->assembly, variableHash);
+        if (variableIndex == dsInvalidIndex)
+            return false;
 
-        return false;
+        return out_value.accept(instance->variable(variableIndex));
+    }
+
+    dsVariableHandle Runtime::lookupVariable(dsAssembly* assembly, dsName name) const noexcept
+    {
+        DS_GUARD_OR(assembly != nullptr, dsInvalidVariableHandle);
+
+        dsAssemblyVariableIndex const variableIndex = dsFindAssemblyVariable(*assembly, dsHashFnv1a64(name.name, name.nameEnd));
+        if (variableIndex == dsInvalidIndex)
+            return dsInvalidVariableHandle;
+
+        return dsMakeVariableHandle(*assembly, variableIndex);
+    }
+
+    bool Runtime::writeVariable(dsInstanceId instanceId, dsVariableHandle variable, dsValueRef const& value)
+    {
+        dsInstance* const instance = findInstance(instanceId);
+        if (instance == nullptr)
+            return false;
+
+        dsAssemblyVariableIndex const variableIndex = dsResolveVariableHandle(*instance->assembly, variable);
+        if (variableIndex == dsInvalidIndex)
+            return false;
+
+        return writeVariable(*instance, variableIndex, dsInvalidIndex, value);
+    }
+
+    bool Runtime::readVariable(dsInstanceId instanceId, dsVariableHandle variable, dsValueOut out_value)
+    {
+        dsInstance* const instance = findInstance(instanceId);
+        if (instance == nullptr)
+            return false;
+
+        dsAssemblyVariableIndex const variableIndex = dsResolveVariableHandle(*instance->assembly, variable);
+        if (variableIndex == dsInvalidIndex)
+            return false;
+
+        return out_value.accept(instance->variable(variableIndex));
+    }
+
+    bool Runtime::readInputSlot(dsAssembly* assembly, dsNodeIndex nodeIndex, dsInputSlot inputSlot, dsInstanceId const* instanceIds,
+        uint32_t count, dsValueOut const* out_values)
+    {
+        DS_GUARD_OR(assembly != nullptr, false);
+        DS_GUARD_OR(count == 0 || (instanceIds != nullptr && out_values != nullptr), false);
+
+        dsAssemblyHeader const& header = *assembly->header;
+        if (nodeIndex.value() >= header.nodes.count)
+            return false;
+
+        dsAssemblyNodeIndex const assemblyNodeIndex{nodeIndex.value()};
+        dsAssemblyNode const& node = header.nodes[assemblyNodeIndex];
+        if (inputSlot.value() >= node.inputSlotCount)
+            return false;
+
+        dsAssemblyExpressionIndex const expressionIndex = header.inputSlots[node.inputSlotStart + inputSlot.value()].expressionIndex;
+
+        // instances are gathered in groups, so that their variable blocks need not be allocated
+        dsInstance* instances[slotGroupSize];
+        dsPackedVariables variables[slotGroupSize];
+        dsPackedVariables const* blocks[slotGroupSize];
+        dsValueStorage results[slotGroupSize];
+
+        for (uint32_t first = 0; first < count; first += slotGroupSize)
+        {
+            uint32_t const groupCount = count - first < slotGroupSize ? count - first : slotGroupSize;
+            for (uint32_t index = 0; index != groupCount; ++index)
+            {
+                instances[index] = findInstance(instanceIds[first + index]);
+                if (instances[index] == nullptr || instances[index]->assembly != assembly)
+                    return false;
+                variables[index] = instances[index]->packedVariables();
+                blocks[index] = &variables[index];
+            }
+
+            // expressions which are not carried in lanes, and slots bound to variables or constants, are read one
+            // instance at a time, with the instance's own listeners and result cache
+            uint32_t const laned =
+                expressionIndex != dsInvalidIndex ? dsEvaluateLanes(*assembly, expressionIndex, blocks, groupCount, results) : 0;
+            for (uint32_t index = 0; index != laned; ++index)
+            {
+                dsValueOut out_value = out_values[first + index];
+                if (!out_value.accept(results[index].ref()))
+                    return false;
+            }
+            for (uint32_t index = laned; index != groupCount; ++index)
+            {
+                if (!readSlot(*instances[index], assemblyNodeIndex, inputSlot, out_values[first + index]))
+                    return false;
+            }
+        }
+        return true;
     }
 
     void Runtime::processEvents()
     {
-        for (dsInstance* const instance : instances_)
-            if (instance != nullptr)
+        DS_GUARD_VOID(!parallel_);
+
+        drainPostedChanges();
+
+        if (mode_ != dsProcessMode::Serial)
+        {
+            if (dsRuntimeScheduler* const scheduler = host_.scheduler(); scheduler != nullptr)
+            {
+                processEventsParallel(*scheduler);
+                return;
+            }
+        }
+
+        // instances may be queued while processing, which are handled in this same pass;
+        // instances destroyed after being queued will fail the lookup and be skipped
+        for (uint32_t pendingIndex = 0; pendingIndex != pending_.size(); ++pendingIndex)
+            if (dsInstance* const instance = findInstance(pending_[pendingIndex]); instance != nullptr)
                 processEvents(*instance);
+
+        pending_.clear();
+    }
+
+    dsRuntimeStats Runtime::stats() const noexcept
+    {
+        dsRuntimeStats stats = stats_;
+        stats.rejectedPostedChanges = rejectedPostedChanges_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    bool Runtime::postChange(dsEmitterId emitterId) noexcept
+    {
+        DS_GUARD_OR(emitterId != dsInvalidEmitterId, false);
+
+        if (postedChanges_.tryPush(emitterId.value()))
+            return true;
+
+        rejectedPostedChanges_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void Runtime::drainPostedChanges()
+    {
+        // bounded, so producers that never stop posting cannot stall processing
+        uint64_t emitterId = 0;
+        for (uint32_t count = 0; count != postedChangeCapacity_ && postedChanges_.tryPop(emitterId); ++count)
+        {
+            if (drainedChanges_.contains(emitterId))
+            {
+                ++stats_.coalescedPostedChanges;
+                continue;
+            }
+
+            drainedChanges_.insert(emitterId, true);
+            notifyChange(dsEmitterId{emitterId});
+        }
+
+        drainedChanges_.clear();
+    }
+
+    dsEmitterId Runtime::makeEmitterId()
+    {
+        // deterministic ids are interleaved by chunk: base + chunk + k * chunkCount
+        if (Batch* const batch = deferredBatch(); batch != nullptr && mode_ == dsProcessMode::Deterministic)
+        {
+            uint64_t const base = nextEmitterId_.load(std::memory_order_relaxed);
+            return dsEmitterId{base + currentWorker->chunkIndex + batch->emitterCount++ * chunkCount_};
+        }
+
+        return dsEmitterId{nextEmitterId_.fetch_add(1, std::memory_order_relaxed)};
+    }
+
+    void Runtime::processEventsParallel(dsRuntimeScheduler& scheduler)
+    {
+        // each round processes the instances queued so far; applying deferred notifications
+        // may queue more, which are processed by a following round
+        while (!pending_.empty())
+        {
+            dsArray<dsInstanceId> swap = static_cast<dsArray<dsInstanceId>&&>(processing_);
+            processing_ = static_cast<dsArray<dsInstanceId>&&>(pending_);
+            pending_ = static_cast<dsArray<dsInstanceId>&&>(swap);
+
+            ParallelPass pass;
+            pass.runtime = this;
+            pass.instanceCount = processing_.size();
+            pass.chunkCount = (pass.instanceCount + parallelChunkSize - 1) / parallelChunkSize;
+            pass.workerCount = scheduler.workerCount();
+            if (pass.workerCount > maxWorkers)
+                pass.workerCount = maxWorkers;
+            if (pass.workerCount > pass.chunkCount)
+                pass.workerCount = pass.chunkCount;
+            if (pass.workerCount == 0)
+                pass.workerCount = 1;
+
+            // each worker starts on its own contiguous range of chunks, and steals from others once it runs dry
+            for (uint32_t workerIndex = 0; workerIndex != pass.workerCount; ++workerIndex)
+            {
+                pass.ranges[workerIndex].nextChunk.store(
+                    static_cast<uint32_t>(uint64_t{pass.chunkCount} * workerIndex / pass.workerCount), std::memory_order_relaxed);
+                pass.ranges[workerIndex].endChunk = static_cast<uint32_t>(uint64_t{pass.chunkCount} * (workerIndex + 1) / pass.workerCount);
+            }
+
+            uint32_t const batchCount = mode_ == dsProcessMode::Deterministic ? pass.chunkCount : pass.workerCount;
+            while (batches_.size() < batchCount)
+                batches_.emplaceBack(allocator_);
+
+            chunkCount_ = pass.chunkCount;
+            parallel_ = true;
+            if (pass.workerCount == 1)
+                runWorker(&pass, 0);
+            else
+                scheduler.dispatch(runWorker, &pass, pass.workerCount);
+            parallel_ = false;
+
+            uint64_t emitterCount = 0;
+            for (uint32_t batchIndex = 0; batchIndex != batchCount; ++batchIndex)
+            {
+                Batch& batch = batches_[batchIndex];
+                if (batch.emitterCount > emitterCount)
+                    emitterCount = batch.emitterCount;
+                applyDeferred(batch);
+            }
+
+            if (mode_ == dsProcessMode::Deterministic)
+                nextEmitterId_.fetch_add(emitterCount * pass.chunkCount, std::memory_order_relaxed);
+
+            processing_.clear();
+        }
+    }
+
+    void Runtime::runWorker(void* userData, uint32_t workerIndex)
+    {
+        ParallelPass& pass = *static_cast<ParallelPass*>(userData);
+        Runtime& runtime = *pass.runtime;
+        bool const deterministic = runtime.mode_ == dsProcessMode::Deterministic;
+
+        WorkerState state{.runtime = &runtime};
+        WorkerState* const previous = currentWorker;
+        currentWorker = &state;
+
+        for (uint32_t offset = 0; offset != pass.workerCount; ++offset)
+        {
+            WorkerRange& range = pass.ranges[(workerIndex + offset) % pass.workerCount];
+
+            for (uint32_t chunkIndex = range.nextChunk.fetch_add(1, std::memory_order_relaxed); chunkIndex < range.endChunk;
+                 chunkIndex = range.nextChunk.fetch_add(1, std::memory_order_relaxed))
+            {
+                state.batch = &runtime.batches_[deterministic ? chunkIndex : workerIndex];
+                state.chunkIndex = chunkIndex;
+
+                uint32_t const first = chunkIndex * parallelChunkSize;
+                uint32_t const last = first + parallelChunkSize < pass.instanceCount ? first + parallelChunkSize : pass.instanceCount;
+                for (uint32_t index = first; index != last; ++index)
+                    if (dsInstance* const instance = runtime.findInstance(runtime.processing_[index]); instance != nullptr)
+                        runtime.processEvents(*instance);
+            }
+        }
+
+        currentWorker = previous;
     }
 
-    dsEmitterId Runtime::makeEmitterId() { return dsEmitterId{nextEmitterId_++}; }
+    void Runtime::applyDeferred(Batch& batch)
+    {
+        for (DeferredOp const& op : batch.deferred)
+        {
+            switch (op.kind)
+            {
+            case DeferredOp::Kind::AddListener:
+                if (dsInstance* const instance = findInstance(op.instanceId); instance != nullptr)
+                    addListener(*instance, op.inputSlotIndex, op.emitterId);
+                break;
+            case DeferredOp::Kind::ForgetListener:
+                if (dsInstance* const instance = findInstance(op.instanceId); instance != nullptr)
+                    forgetListener(*instance, op.inputSlotIndex);
+                break;
+            case DeferredOp::Kind::NotifyChange: notifyChange(op.emitterId); break;
+            }
+        }
+        batch.deferred.clear();
+
+        stats_.queuedEvents += batch.stats.queuedEvents;
+        stats_.coalescedDependencyEvents += batch.stats.coalescedDependencyEvents;
+        stats_.coalescedPostedChanges += batch.stats.coalescedPostedChanges;
+        stats_.cachedSlotReads += batch.stats.cachedSlotReads;
+        stats_.listenerChanges += batch.stats.listenerChanges;
+        batch.stats = {};
+        batch.emitterCount = 0;
+    }
 
-    void Runtime::addListener(dsInstanceId instanceId, uint32_t inputSlotIndex, dsEmitterId emitterId)
+    void Runtime::addListener(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex, dsEmitterId emitterId)
     {
-        DS_GUARD_VOID(instanceId != dsInvalidInstanceId);
         DS_GUARD_VOID(emitterId != dsInvalidEmitterId);
+        DS_GUARD_VOID(inputSlotIndex.value() < instance.listeners.count);
 
-        for (Listener& listener : listeners_)
-            if (listener.instanceId == instanceId && listener.emitterId == emitterId && listener.inputSlotIndex == inputSlotIndex)
+        if (Batch* const batch = deferredBatch(); batch != nullptr)
+        {
+            batch->deferred.pushBack(DeferredOp{.kind = DeferredOp::Kind::AddListener,
+                .instanceId = instance.instanceId,
+                .inputSlotIndex = inputSlotIndex,
+                .emitterId = emitterId});
+            return;
+        }
+
+        // a slot rarely listens to more than a handful of emitters, so scanning its own list is cheap
+        for (uint32_t listenerIndex = instance.listeners[inputSlotIndex]; listenerIndex != invalidListener;
+             listenerIndex = listeners_[listenerIndex].nextSlotListener)
+        {
+            if (listeners_[listenerIndex].emitterId == emitterId)
                 return;
+        }
 
-        for (Listener& listener : listeners_)
+        linkListener(instance, inputSlotIndex, emitterId);
+    }
+
+    void Runtime::updateListeners(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex, uint64_t const* emitterIds,
+        uint32_t emitterCount)
+    {
+        DS_GUARD_VOID(inputSlotIndex.value() < instance.listeners.count);
+        DS_GUARD_VOID(emitterCount <= 32);
+        DS_ASSERT(deferredBatch() == nullptr);
+
+        // unlink the listeners whose emitter was not listened to again, remembering which emitters are already registered
+        uint32_t registered = 0;
+        for (uint32_t* link = &instance.listeners[inputSlotIndex]; *link != invalidListener;)
         {
-            if (listener.instanceId == dsInvalidInstanceId || listener.emitterId == dsInvalidEmitterId)
+            uint32_t const listenerIndex = *link;
+            Listener const& listener = listeners_[listenerIndex];
+
+            uint32_t emitterIndex = 0;
+            while (emitterIndex != emitterCount && emitterIds[emitterIndex] != listener.emitterId.value())
+                ++emitterIndex;
+
+            if (emitterIndex != emitterCount)
             {
-                listener.instanceId = instanceId;
-                listener.emitterId = emitterId;
-                listener.inputSlotIndex = inputSlotIndex;
-                return;
+                registered |= 1u << emitterIndex;
+                link = &listeners_[listenerIndex].nextSlotListener;
+                continue;
             }
+
+            *link = listener.nextSlotListener;
+            releaseListener(listenerIndex);
         }
 
-        listeners_.pushBack(Listener{.instanceId = instanceId, .emitterId = emitterId, .inputSlotIndex = inputSlotIndex});
+        for (uint32_t emitterIndex = 0; emitterIndex != emitterCount; ++emitterIndex)
+            if ((registered & (1u << emitterIndex)) == 0)
+                linkListener(instance, inputSlotIndex, dsEmitterId{emitterIds[emitterIndex]});
     }
 
-    void Runtime::forgetListener(dsInstanceId instanceId, uint32_t inputSlotIndex)
+    void Runtime::linkListener(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex, dsEmitterId emitterId)
     {
-        DS_GUARD_VOID(instanceId != dsInvalidInstanceId);
+        ++localStats().listenerChanges;
+
+        uint32_t listenerIndex = freeListener_;
+        if (listenerIndex != invalidListener)
+        {
+            freeListener_ = listeners_[listenerIndex].nextSlotListener;
+        }
+        else
+        {
+            listenerIndex = listeners_.size();
+            listeners_.pushBack(Listener{});
+        }
 
-        for (Listener& listener : listeners_)
-            if (listener.instanceId == instanceId && listener.inputSlotIndex == inputSlotIndex)
-                listener = Listener{};
+        uint32_t& emitterHead = emitterListeners_.insert(emitterId.value(), invalidListener);
+        uint32_t& slotHead = instance.listeners[inputSlotIndex];
+
+        listeners_[listenerIndex] = Listener{.instanceId = instance.instanceId,
+            .emitterId = emitterId,
+            .inputSlotIndex = inputSlotIndex.value(),
+            .nextEmitterListener = emitterHead,
+            .nextSlotListener = slotHead};
+
+        if (emitterHead != invalidListener)
+            listeners_[emitterHead].prevEmitterListener = listenerIndex;
+
+        emitterHead = listenerIndex;
+        slotHead = listenerIndex;
     }
 
-    void Runtime::forgetListener(dsInstanceId instanceId)
+    void Runtime::forgetListener(dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex)
     {
-        DS_GUARD_VOID(instanceId != dsInvalidInstanceId);
+        DS_GUARD_VOID(inputSlotIndex.value() < instance.listeners.count);
 
-        for (Listener& listener : listeners_)
-            if (listener.instanceId == instanceId)
-                listener = Listener{};
+        if (Batch* const batch = deferredBatch(); batch != nullptr)
+        {
+            batch->deferred.pushBack(
+                DeferredOp{.kind = DeferredOp::Kind::ForgetListener, .instanceId = instance.instanceId, .inputSlotIndex = inputSlotIndex});
+            return;
+        }
+
+        uint32_t& slotHead = instance.listeners[inputSlotIndex];
+        for (uint32_t listenerIndex = slotHead; listenerIndex != invalidListener;)
+        {
+            uint32_t const nextIndex = listeners_[listenerIndex].nextSlotListener;
+            releaseListener(listenerIndex);
+            listenerIndex = nextIndex;
+        }
+        slotHead = invalidListener;
+    }
+
+    // unlinks the listener from its emitter and returns it to the free list; the caller unlinks it from its slot
+    void Runtime::releaseListener(uint32_t listenerIndex) noexcept
+    {
+        ++localStats().listenerChanges;
+
+        unlinkEmitterListener(listenerIndex);
+
+        listeners_[listenerIndex] = Listener{.nextSlotListener = freeListener_};
+        freeListener_ = listenerIndex;
+    }
+
+    void Runtime::forgetListener(dsInstance& instance)
+    {
+        for (dsAssemblyInputSlotIndex inputSlotIndex{0}; inputSlotIndex != instance.listeners.count; ++inputSlotIndex)
+            if (instance.listeners[inputSlotIndex] != invalidListener)
+                forgetListener(instance, inputSlotIndex);
+    }
+
+    void Runtime::unlinkEmitterListener(uint32_t listenerIndex) noexcept
+    {
+        Listener const& listener = listeners_[listenerIndex];
+
+        if (listener.nextEmitterListener != invalidListener)
+            listeners_[listener.nextEmitterListener].prevEmitterListener = listener.prevEmitterListener;
+
+        if (listener.prevEmitterListener != invalidListener)
+        {
+            listeners_[listener.prevEmitterListener].nextEmitterListener = listener.nextEmitterListener;
+        }
+        else if (listener.nextEmitterListener != invalidListener)
+        {
+            uint32_t* const emitterHead = emitterListeners_.find(listener.emitterId.value());
+            DS_ASSERT(emitterHead != nullptr && *emitterHead == listenerIndex);
+            *emitterHead = listener.nextEmitterListener;
+        }
+        else
+        {
+            // last listener of the emitter; drop the entry so the index does not accumulate dead emitters
+            emitterListeners_.erase(listener.emitterId.value());
+        }
     }
 
     void Runtime::notifyChange(dsEmitterId emitterId)
     {
         DS_GUARD_VOID(emitterId != dsInvalidEmitterId);
 
-        for (Listener& listener : listeners_)
-            if (listener.emitterId == emitterId && listener.instanceId != dsInvalidInstanceId)
-                triggerChange(listener.instanceId, listener.inputSlotIndex);
+        if (Batch* const batch = deferredBatch(); batch != nullptr)
+        {
+            batch->deferred.pushBack(DeferredOp{.kind = DeferredOp::Kind::NotifyChange, .emitterId = emitterId});
+            return;
+        }
+
+        uint32_t const* const emitterHead = emitterListeners_.find(emitterId.value());
+        if (emitterHead == nullptr)
+            return;
+
+        for (uint32_t listenerIndex = *emitterHead; listenerIndex != invalidListener;
+             listenerIndex = listeners_[listenerIndex].nextEmitterListener)
+        {
+            Listener const& listener = listeners_[listenerIndex];
+            triggerChange(listener.instanceId, listener.inputSlotIndex);
+        }
     }
 
     dsInstance* Runtime::findInstance(dsInstanceId instanceId) noexcept
     {
-        for (dsInstance* const instance : instances_)
-            if (instance != nullptr && instance->instanceId == instanceId)
-                return instance;
+        uint32_t const slotIndex = instanceSlotIndex(instanceId);
+        if (slotIndex >= instances_.size())
+            return nullptr;
 
-        return nullptr;
+        // a stale id will have an older generation than the slot
+        InstanceSlot const& slot = instances_[slotIndex];
+        if (slot.generation != instanceGeneration(instanceId))
+            return nullptr;
+
+        return slot.instance;
+    }
+
+    uint32_t Runtime::allocateSlot()
+    {
+        if (freeSlot_ != invalidSlot)
+        {
+            uint32_t const slotIndex = freeSlot_;
+            freeSlot_ = instances_[slotIndex].nextFree;
+            instances_[slotIndex].nextFree = invalidSlot;
+            return slotIndex;
+        }
+
+        uint32_t const slotIndex = instances_.size();
+        instances_.pushBack(InstanceSlot{});
+        return slotIndex;
+    }
+
+    void Runtime::releaseSlot(uint32_t slotIndex) noexcept
+    {
+        InstanceSlot& slot = instances_[slotIndex];
+        slot.instance = nullptr;
+
+        // retire slots whose generation would overflow, so a stale id can never alias a new instance
+        if (++slot.generation > maxGeneration)
+            return;
+
+        slot.nextFree = freeSlot_;
+        freeSlot_ = slotIndex;
     }
 
     class Runtime::Context final : public dsNodeContext
@@ -335,24 +939,67 @@ namespace descript {
     {
     public:
         EvaluateHost(Runtime& runtime, dsInstance& instance, dsAssemblyInputSlotIndex inputSlotIndex) noexcept
-            : runtime_(runtime), instance_(instance), inputSlotIndex_(inputSlotIndex)
+            : runtime_(runtime), instance_(instance), inputSlotIndex_(inputSlotIndex), direct_(runtime.deferredBatch() != nullptr)
         {
+            // deferred listener changes cannot be diffed against the registry until they are applied
+            if (direct_)
+                runtime_.forgetListener(instance_, inputSlotIndex_);
         }
 
-        void listen(dsEmitterId emitterId) override { runtime_.addListener(instance_.instanceId, inputSlotIndex_.value(), emitterId); }
+        void listen(dsEmitterId emitterId) override;
 
         bool readConstant(uint32_t constantIndex, dsValueOut out_value) override;
         bool readVariable(uint32_t variableIndex, dsValueOut out_value) override;
         bool invokeFunction(uint32_t functionIndex, dsFunctionContext& ctx) override;
 
+        /// Brings the slot's listeners in line with the emitters listened to by the evaluation.
+        void commitListeners();
+
     private:
+        static constexpr uint32_t maxEmitters = 8;
+
         Runtime& runtime_;
         dsInstance& instance_;
         dsSpan<dsValueStorage const> constants_;
         dsSpan<dsValueStorage const> variables_;
         dsAssemblyInputSlotIndex inputSlotIndex_ = dsInvalidIndex;
+        uint32_t emitterCount_ = 0;
+        uint64_t emitterIds_[maxEmitters] = {}; // raw ids, as keyed by the emitter registry
+        bool direct_ = false;                   // listeners are registered as they are heard rather than diffed afterwards
     };
 
+    void Runtime::EvaluateHost::listen(dsEmitterId emitterId)
+    {
+        if (direct_)
+        {
+            runtime_.addListener(instance_, inputSlotIndex_, emitterId);
+            return;
+        }
+
+        for (uint32_t index = 0; index != emitterCount_; ++index)
+            if (emitterIds_[index] == emitterId.value())
+                return;
+
+        if (emitterCount_ != maxEmitters)
+        {
+            emitterIds_[emitterCount_++] = emitterId.value();
+            return;
+        }
+
+        // too many emitters to diff; replace the slot's listeners wholesale
+        runtime_.forgetListener(instance_, inputSlotIndex_);
+        for (uint32_t index = 0; index != emitterCount_; ++index)
+            runtime_.addListener(instance_, inputSlotIndex_, dsEmitterId{emitterIds_[index]});
+        runtime_.addListener(instance_, inputSlotIndex_, emitterId);
+        direct_ = true;
+    }
+
+    void Runtime::EvaluateHost::commitListeners()
+    {
+        if (!direct_)
+            runtime_.updateListeners(instance_, inputSlotIndex_, emitterIds_, emitterCount_);
+    }
+
     bool Runtime::EvaluateHost::readConstant(uint32_t constantIndex, dsValueOut out_value)
     {
         if (constantIndex < instance_.assembly->constants.count)
@@ -362,8 +1009,8 @@ namespace descript {
 
     bool Runtime::EvaluateHost::readVariable(uint32_t variableIndex, dsValueOut out_value)
     {
-        if (variableIndex < instance_.values.count)
-            return out_value.accept(instance_.values[dsAssemblyVariableIndex{variableIndex}].ref());
+        if (variableIndex < instance_.variableCount())
+            return out_value.accept(instance_.variable(dsAssemblyVariableIndex{variableIndex}));
         return false;
     }
 
@@ -382,13 +1029,15 @@ namespace descript {
     {
         if (instance != nullptr)
         {
-            uint32_t const size = instance->assembly->instanceSize;
+            dsAssembly* const assembly = instance->assembly;
 
-            dsReleaseAssembly(instance->assembly);
-            forgetListener(instance->instanceId);
+            forgetListener(*instance);
 
             instance->~dsInstance();
-            allocator_.free(instance, size, alignof(dsInstance));
+            dsFreeInstanceMemory(*assembly, instance);
+
+            // may free the assembly and its instance pool, so must come last
+            dsReleaseAssembly(assembly);
         }
     }
 
@@ -397,6 +1046,31 @@ namespace descript {
         DS_ASSERT(nodeIndex.value() < instance.assembly->header->nodes.count);
 
         instance.events.pushBack(dsInstance::Event{.nodeIndex = nodeIndex, .event = event});
+        ++localStats().queuedEvents;
+
+        if (!instance.queued)
+        {
+            // instances being processed in parallel are already queued
+            DS_ASSERT(!parallel_);
+
+            instance.queued = true;
+            pending_.pushBack(instance.instanceId);
+        }
+    }
+
+    void Runtime::sendDependencyEvent(dsInstance& instance, dsAssemblyNodeIndex nodeIndex)
+    {
+        DS_ASSERT(nodeIndex.value() < instance.pendingDependencies.count);
+
+        // a node only needs to re-read its slots once, no matter how many of its inputs changed
+        if (instance.pendingDependencies[nodeIndex])
+        {
+            ++localStats().coalescedDependencyEvents;
+            return;
+        }
+
+        instance.pendingDependencies.set(nodeIndex);
+        sendLocalEvent(instance, nodeIndex, {.type = dsEventType::Dependency});
     }
 
     void Runtime::processEvents(dsInstance& instance)
@@ -410,6 +1084,7 @@ namespace descript {
         }
 
         instance.events.clear();
+        instance.queued = false;
     }
 
     void Runtime::processEvent(dsInstance& instance, dsAssemblyNodeIndex nodeIndex, dsEvent const& event)
@@ -447,6 +1122,8 @@ namespace descript {
             break;
         }
         case dsEventType::Dependency:
+            // cleared before dispatch, so that changes made during the dispatch queue a new event
+            instance.pendingDependencies.clear(nodeIndex);
             if (!instance.activeNodes[nodeIndex])
                 break;
             dispatchEvent(instance, nodeIndex, event);
@@ -535,21 +1212,33 @@ namespace descript {
         dsAssemblyInputSlot const& slot = header.inputSlots[inputSlotIndex];
 
         if (slot.variableIndex != dsInvalidIndex)
-            return out_value.accept(instance.values[slot.variableIndex].ref());
+            return out_value.accept(instance.variable(slot.variableIndex));
 
         if (slot.constantIndex != dsInvalidIndex)
             return out_value.accept(assembly.constants[slot.constantIndex].ref());
 
         if (slot.expressionIndex != dsInvalidIndex)
         {
-            dsAssemblyExpression const& expression = header.expressions[slot.expressionIndex];
+            // the listeners registered by the evaluation which produced a cached result are still in place
+            if (instance.cachedResults[slot.expressionIndex])
+            {
+                ++localStats().cachedSlotReads;
+                return out_value.accept(instance.results[slot.expressionIndex].ref());
+            }
 
-            forgetListener(instance.instanceId, inputSlotIndex.value());
+            bool const isVolatile = header.expressions[slot.expressionIndex].isVolatile;
+            dsValueStorage& result = instance.results[slot.expressionIndex];
 
             EvaluateHost host(*this, instance, inputSlotIndex);
-            if (!dsEvaluate(host, header.byteCode.base.get() + expression.codeStart.value(), expression.codeCount, out_value))
-                return false;
-            return true;
+            dsValueOut const target = isVolatile ? out_value : result.out();
+            dsPackedVariables const variables = instance.packedVariables();
+            bool const evaluated = dsEvaluateExpression(host, localScratch(), assembly, slot.expressionIndex, &variables, target);
+            host.commitListeners();
+
+            if (!evaluated || isVolatile)
+                return evaluated;
+            instance.cachedResults.set(slot.expressionIndex);
+            return out_value.accept(result.ref());
         }
 
         return false;
@@ -566,7 +1255,7 @@ namespace descript {
 
         dsAssemblyOutputSlot const& slot = header.outputSlots[node.outputSlotStart + outputSlot.value()];
         if (slot.variableIndex != dsInvalidIndex)
-            return out_value.accept(instance.values[slot.variableIndex].ref());
+            return out_value.accept(instance.variable(slot.variableIndex));
 
         return false;
     }
@@ -584,41 +1273,35 @@ namespace descript {
         if (slot.variableIndex == dsInvalidIndex)
             return false;
 
-        writeVariable(instance, slot.variableIndex, nodeIndex, value);
-        return true;
+        return writeVariable(instance, slot.variableIndex, nodeIndex, value);
     }
 
     bool Runtime::writeVariable(dsInstance& instance, uint64_t nameHash, dsValueRef const& value)
     {
-        dsAssemblyHeader const& header = *instance.assembly->header;
-        for (dsAssemblyVariableIndex variableIndex{0}; variableIndex != header.variables.count; ++variableIndex)
-        {
-            if (header.variables[variableIndex].nameHash == nameHash)
-            {
-                writeVariable(instance, variableIndex, dsInvalidIndex, value);
-                return true;
-            }
-        }
+        dsAssemblyVariableIndex const variableIndex = dsFindAssemblyVariable(*instance.assembly, nameHash);
+        if (variableIndex == dsInvalidIndex)
+            return false;
 
-        return false;
+        return writeVariable(instance, variableIndex, dsInvalidIndex, value);
     }
 
-    void Runtime::writeVariable(dsInstance& instance, dsAssemblyVariableIndex variableIndex, dsAssemblyNodeIndex sourceNodeIndex,
+    bool Runtime::writeVariable(dsInstance& instance, dsAssemblyVariableIndex variableIndex, dsAssemblyNodeIndex sourceNodeIndex,
         dsValueRef const& value)
     {
-        DS_ASSERT(variableIndex.value() < instance.values.count);
+        DS_ASSERT(variableIndex.value() < instance.variableCount());
 
-        dsAssemblyHeader const& header = *instance.assembly->header;
-        if (instance.values[variableIndex] != value)
-        {
-            instance.values[variableIndex] = dsValueStorage{value};
-            triggerDependencies(instance, variableIndex, sourceNodeIndex);
-        }
+        if (instance.variable(variableIndex) == value)
+            return true;
+        if (!instance.assignVariable(variableIndex, value))
+            return false;
+
+        triggerDependencies(instance, variableIndex, sourceNodeIndex);
+        return true;
     }
 
     void Runtime::triggerDependencies(dsInstance& instance, dsAssemblyVariableIndex variableIndex, dsAssemblyNodeIndex sourceNodeIndex)
     {
-        DS_ASSERT(variableIndex.value() < instance.values.count);
+        DS_ASSERT(variableIndex.value() < instance.variableCount());
 
         dsAssemblyHeader const& header = *instance.assembly->header;
         dsAssemblyVariable const& var = header.variables[variableIndex];
@@ -628,6 +1311,11 @@ namespace descript {
         {
             dsAssemblyDependency const& dependency = header.dependencies[depIndex];
 
+            // the cached result is stale even if the node is not notified below
+            dsAssemblyInputSlot const& slot = header.inputSlots[dependency.slotIndex];
+            if (slot.expressionIndex != dsInvalidIndex)
+                instance.cachedResults.clear(slot.expressionIndex);
+
             // avoid a write from a node triggering itself
             if (dependency.nodeIndex == sourceNodeIndex)
                 continue;
@@ -637,7 +1325,7 @@ namespace descript {
             if (!instance.activeNodes[dependency.nodeIndex])
                 continue;
 
-            sendLocalEvent(instance, dependency.nodeIndex, {.type = dsEventType::Dependency});
+            sendDependencyEvent(instance, dependency.nodeIndex);
         }
     }
 
@@ -650,8 +1338,11 @@ namespace descript {
         DS_GUARD_VOID(inputSlotIndex < instance->assembly->header->inputSlots.count);
         dsAssemblyInputSlot const& inputSlot = instance->assembly->header->inputSlots[dsAssemblyInputSlotIndex{inputSlotIndex}];
 
+        if (inputSlot.expressionIndex != dsInvalidIndex)
+            instance->cachedResults.clear(inputSlot.expressionIndex);
+
         DS_GUARD_VOID(inputSlot.nodeIndex != dsInvalidIndex);
-        sendLocalEvent(*instance, inputSlot.nodeIndex, dsEvent{.type = dsEventType::Dependency});
+        sendDependencyEvent(*instance, inputSlot.nodeIndex);
     }
 
 } // namespace descript
@@ -5,6 +5,12 @@
 #include "descript/meta.hh"
 #include "descript/value.hh"
 
+#include "assert.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
 namespace descript {
     class dsValueStorage final
     {
@@ -22,13 +28,13 @@ namespace descript {
         /*implicit*/ dsValueStorage(T const& value)
         noexcept : meta_(&dsType<T>) { new (&storage_) T(value); }
 
-        constexpr [[nodiscard]] dsTypeId type() const noexcept { return dsTypeId{meta_->typeId}; }
+        [[nodiscard]] constexpr dsTypeId type() const noexcept { return dsTypeId{meta_->typeId}; }
 
         [[nodiscard]] void const* pointer() const noexcept { return &storage_; }
 
         template <typename T>
         requires dsIsValue<T>
-        constexpr [[nodiscard]] bool is() const noexcept { return meta_->typeId == dsType<T>.typeId; }
+        [[nodiscard]] constexpr bool is() const noexcept { return meta_->typeId == dsType<T>.typeId; }
 
         template <typename T>
         requires dsIsValue<T>
@@ -38,11 +44,15 @@ namespace descript {
 
         [[nodiscard]] dsValueOut out() noexcept { return dsValueOut(&sink, this); }
 
-        constexpr [[nodiscard]] bool operator==(dsValueStorage const& right) const noexcept
+        [[nodiscard]] constexpr bool operator==(dsValueStorage const& right) const noexcept
         {
             return meta_->typeId == right.meta_->typeId && meta_->opEquality != nullptr && meta_->opEquality(&storage_, &right.storage_);
         }
 
+        // for generated code, which reads values in place
+        static constexpr uint32_t metaOffset() noexcept { return offsetof(dsValueStorage, meta_); }
+        static constexpr uint32_t storageOffset() noexcept { return offsetof(dsValueStorage, storage_); }
+
     private:
         static bool sink(dsTypeMeta const& typeMeta, void const* pointer, void* userData)
         {
@@ -58,4 +68,107 @@ namespace descript {
         friend class dsValueRef;
         friend class dsValueOut;
     };
+
+    /// Where each type's variables start, once the graph compiler has sorted them by type: int32
+    /// variables from zero, then float32, then bool, then variables of any other type.
+    struct dsVariableLayout
+    {
+        uint32_t float32Start = 0;
+        uint32_t boolStart = 0;
+        uint32_t valueStart = 0;
+        uint32_t count = 0;
+
+        [[nodiscard]] constexpr uint32_t int32Count() const noexcept { return float32Start; }
+        [[nodiscard]] constexpr uint32_t float32Count() const noexcept { return boolStart - float32Start; }
+        [[nodiscard]] constexpr uint32_t boolCount() const noexcept { return valueStart - boolStart; }
+        [[nodiscard]] constexpr uint32_t valueCount() const noexcept { return count - valueStart; }
+
+        /// Whether the variable is packed as exactly T, rather than held in storage.
+        template <typename T>
+        [[nodiscard]] constexpr bool packs(uint32_t variableIndex) const noexcept
+        {
+            if constexpr (std::is_same_v<T, int32_t>)
+                return variableIndex < float32Start;
+            else if constexpr (std::is_same_v<T, float>)
+                return variableIndex >= float32Start && variableIndex < boolStart;
+            else if constexpr (std::is_same_v<T, bool>)
+                return variableIndex >= boolStart && variableIndex < valueStart;
+            else
+                return false;
+        }
+    };
+
+    /// Variables packed by type, each built-in type into an array of its own with bools as a bitset,
+    /// and any other type into storage. A packed variable can only hold a value of its own type, which
+    /// is what lets it be read and written without checking the type it holds.
+    struct dsPackedVariables
+    {
+        int32_t* int32s = nullptr;
+        float* float32s = nullptr;
+        uint64_t* boolBits = nullptr;
+        dsValueStorage* values = nullptr;
+        dsVariableLayout layout;
+
+        template <typename T>
+        requires(std::is_same_v<T, int32_t> || std::is_same_v<T, float> || std::is_same_v<T, bool>)
+        [[nodiscard]] T read(uint32_t variableIndex) const noexcept
+        {
+            DS_ASSERT(layout.packs<T>(variableIndex));
+            if constexpr (std::is_same_v<T, int32_t>)
+                return int32s[variableIndex];
+            else if constexpr (std::is_same_v<T, float>)
+                return float32s[variableIndex - layout.float32Start];
+            else
+                return ((boolBits[(variableIndex - layout.boolStart) / 64] >> ((variableIndex - layout.boolStart) % 64)) & 1) != 0;
+        }
+
+        [[nodiscard]] dsValueRef ref(uint32_t variableIndex) const noexcept
+        {
+            // a bit cannot be referenced, so a bool is referenced as one of two constants
+            static constexpr bool s_bools[] = {false, true};
+
+            DS_ASSERT(variableIndex < layout.count);
+            if (variableIndex < layout.float32Start)
+                return dsValueRef(int32s[variableIndex]);
+            if (variableIndex < layout.boolStart)
+                return dsValueRef(float32s[variableIndex - layout.float32Start]);
+            if (variableIndex < layout.valueStart)
+                return dsValueRef(s_bools[read<bool>(variableIndex)]);
+            return values[variableIndex - layout.valueStart].ref();
+        }
+
+        /// Fails, leaving the variable unchanged, if it is packed and the value is of another type.
+        [[nodiscard]] bool assign(uint32_t variableIndex, dsValueRef const& value) noexcept
+        {
+            DS_ASSERT(variableIndex < layout.count);
+            if (variableIndex >= layout.valueStart)
+            {
+                values[variableIndex - layout.valueStart] = dsValueStorage{value};
+                return true;
+            }
+
+            if (variableIndex < layout.float32Start)
+                return assignPacked(int32s[variableIndex], value);
+            if (variableIndex < layout.boolStart)
+                return assignPacked(float32s[variableIndex - layout.float32Start], value);
+
+            if (value.type() != dsType<bool>.typeId)
+                return false;
+            uint32_t const bit = variableIndex - layout.boolStart;
+            uint64_t const mask = uint64_t{1} << (bit % 64);
+            uint64_t& word = boolBits[bit / 64];
+            word = (word & ~mask) | ((0ull - static_cast<uint64_t>(value.as<bool>())) & mask);
+            return true;
+        }
+
+    private:
+        template <typename T>
+        static bool assignPacked(T& target, dsValueRef const& value) noexcept
+        {
+            if (value.type() != dsType<T>.typeId)
+                return false;
+            target = value.as<T>();
+            return true;
+        }
+    };
 } // namespace descript
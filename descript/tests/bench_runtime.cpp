@@ -0,0 +1,784 @@
+// descript
+
+#include <catch_amalgamated.hpp>
+
+#include "descript/alloc.hh"
+#include "descript/assembly.hh"
+#include "descript/bind.hh"
+#include "descript/context.hh"
+#include "descript/evaluate.hh"
+#include "descript/expression_compiler.hh"
+#include "descript/graph_compiler.hh"
+#include "descript/runtime.hh"
+#include "descript/value.hh"
+
+#include "array.hh"
+#include "evaluate_internal.hh"
+#include "evaluate_t.hh"
+#include "fnv.hh"
+#include "storage.hh"
+#include "utility.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace descript;
+
+namespace {
+    constexpr dsNodeTypeId entryNodeTypeId{dsHashFnv1a64("Entry")};
+    constexpr dsNodeTypeId stateNodeTypeId{dsHashFnv1a64("State")};
+    constexpr dsNodeTypeId sensorNodeTypeId{dsHashFnv1a64("Sensor")};
+    constexpr dsFunctionId sensorFunctionId{dsHashFnv1a64("Sensor")};
+    constexpr dsFunctionId mixFunctionId{dsHashFnv1a64("Mix")};
+    constexpr dsFunctionId mixGenericFunctionId{dsHashFnv1a64("MixGeneric")};
+    constexpr dsFunctionId limitFunctionId{dsHashFnv1a64("Limit")};
+
+    static constexpr dsNodeCompileMeta nodes[] = {
+        {.typeId = entryNodeTypeId, .kind = dsNodeKind::Entry},
+        {.typeId = stateNodeTypeId, .kind = dsNodeKind::State},
+        {.typeId = sensorNodeTypeId, .kind = dsNodeKind::State},
+    };
+
+    // each evaluation of Sensor() listens to the next emitter in the list, so that every
+    // instance created in sequence ends up subscribed to its own emitter
+    std::vector<dsEmitterId> sensorEmitterIds;
+    uint32_t sensorCursor = 0;
+
+    void sensorFunction(dsFunctionContext& ctx, void*)
+    {
+        if (!sensorEmitterIds.empty())
+            ctx.listen(sensorEmitterIds[sensorCursor++ % sensorEmitterIds.size()]);
+        ctx.result(int32_t{1});
+    }
+
+    // bound twice: Mix is registered with its native adapter, MixGeneric only with the dsFunctionContext one
+    int32_t mix(int32_t a, int32_t b, int32_t c) noexcept { return a * b + c; }
+
+    constexpr dsFunctionBinding mixBinding = dsBindFunction<&mix>();
+
+    // the host function equivalent of the clamp intrinsic
+    int32_t limit(int32_t value, int32_t low, int32_t high) noexcept { return value < low ? low : value > high ? high : value; }
+
+    constexpr dsFunctionBinding limitBinding = dsBindFunction<&limit>();
+
+    void sensorNode(dsNodeContext& ctx, dsEventType eventType, void*)
+    {
+        if (eventType == dsEventType::Activate || eventType == dsEventType::Dependency)
+        {
+            dsValueStorage value;
+            (void)ctx.readSlot(dsInputSlot{0}, value.out());
+        }
+    }
+
+    static constexpr dsFunctionCompileMeta functions[] = {
+        {.name = "Sensor", .functionId = sensorFunctionId, .returnType = dsType<int32_t>.typeId},
+        {.name = "Mix", .functionId = mixFunctionId, .returnType = dsType<int32_t>.typeId, .signature = mixBinding.signature},
+        {.name = "MixGeneric", .functionId = mixGenericFunctionId, .returnType = dsType<int32_t>.typeId, .signature = mixBinding.signature},
+        {.name = "Limit", .functionId = limitFunctionId, .returnType = dsType<int32_t>.typeId, .signature = limitBinding.signature},
+    };
+
+    class BenchCompilerHost final : public dsGraphCompilerHost
+    {
+    public:
+        bool lookupNodeType(dsNodeTypeId typeId, dsNodeCompileMeta& out_nodeMeta) const noexcept override
+        {
+            for (dsNodeCompileMeta const& meta : nodes)
+            {
+                if (meta.typeId == typeId)
+                {
+                    out_nodeMeta = meta;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool lookupFunction(dsName name, dsFunctionCompileMeta& out_functionMeta) const noexcept override
+        {
+            for (dsFunctionCompileMeta const& meta : functions)
+            {
+                if (dsNameLen(name) == std::strlen(meta.name) && std::strncmp(name.name, meta.name, dsNameLen(name)) == 0)
+                {
+                    out_functionMeta = meta;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    class BenchRuntimeHost final : public dsRuntimeHost
+    {
+    public:
+        bool lookupNode(dsNodeTypeId typeId, dsNodeRuntimeMeta& out_meta) const noexcept override
+        {
+            if (typeId == stateNodeTypeId)
+            {
+                out_meta = dsNodeRuntimeMeta{.typeId = typeId, .function = [](dsNodeContext&, dsEventType, void*) {}};
+                return true;
+            }
+            if (typeId == sensorNodeTypeId)
+            {
+                out_meta = dsNodeRuntimeMeta{.typeId = typeId, .function = sensorNode};
+                return true;
+            }
+            return false;
+        }
+
+        bool lookupFunction(dsFunctionId functionId, dsFunctionRuntimeMeta& out_meta) const noexcept override
+        {
+            if (functionId == sensorFunctionId)
+                out_meta = dsFunctionRuntimeMeta{.functionId = functionId, .function = sensorFunction};
+            else if (functionId == mixFunctionId)
+                out_meta = dsFunctionRuntimeMeta{.functionId = functionId,
+                    .function = mixBinding.function,
+                    .native = mixBinding.native,
+                    .nativeResult = mixBinding.nativeResult};
+            else if (functionId == mixGenericFunctionId)
+                out_meta = dsFunctionRuntimeMeta{.functionId = functionId, .function = mixBinding.function};
+            else if (functionId == limitFunctionId)
+                out_meta = dsFunctionRuntimeMeta{.functionId = functionId,
+                    .function = limitBinding.function,
+                    .native = limitBinding.native,
+                    .nativeResult = limitBinding.nativeResult};
+            else
+                return false;
+            return true;
+        }
+        bool lookupType(dsTypeId typeId, dsTypeMeta const*& out_meta) const noexcept override { return false; }
+    };
+
+    // compiles and evaluates standalone expressions over the variables X, Y and Z, all of one type
+    class BenchExpressionHost final : public dsExpressionCompilerHost, public dsExpressionBuilder, public dsEvaluateHost
+    {
+    public:
+        template <typename T>
+        BenchExpressionHost(dsAllocator& alloc, T x, T y, T z) : compiler_(dsCreateExpressionCompiler(alloc, *this))
+        {
+            variables_[0] = x;
+            variables_[1] = y;
+            variables_[2] = z;
+        }
+        ~BenchExpressionHost() { dsDestroyExpressionCompiler(compiler_); }
+
+        bool build(char const* expression)
+        {
+            byteCode_.clear();
+            constants_.clear();
+            return compiler_->compile(expression) && compiler_->optimize() && compiler_->build(*this);
+        }
+
+        bool evaluate(dsValueStorage& out_result)
+        {
+            return dsEvaluate(*this, byteCode_.data(), static_cast<uint32_t>(byteCode_.size()), out_result.out());
+        }
+
+        bool evaluateConcrete(dsValueStorage& out_result)
+        {
+            return dsEvaluateT(*this, byteCode_.data(), static_cast<uint32_t>(byteCode_.size()), out_result.out());
+        }
+
+        bool countOpCodes(dsOpHistogram& histogram) const
+        {
+            return dsCountOpCodes(byteCode_.data(), static_cast<uint32_t>(byteCode_.size()), histogram);
+        }
+
+        bool lookupVariable(dsName name, dsVariableCompileMeta& out_meta) const noexcept override
+        {
+            if (dsNameLen(name) != 1 || name.name[0] < 'X' || name.name[0] > 'Z')
+                return false;
+            out_meta.type = variables_[name.name[0] - 'X'].type();
+            return true;
+        }
+        bool lookupFunction(dsName, dsFunctionCompileMeta&) const noexcept override { return false; }
+
+        void pushOp(uint8_t byte) override { byteCode_.push_back(byte); }
+        uint32_t pushConstant(dsValueRef const& value) override
+        {
+            constants_.emplace_back(value);
+            return static_cast<uint32_t>(constants_.size() - 1);
+        }
+        uint32_t pushFunction(dsFunctionId) override { return 0; }
+        uint32_t pushVariable(uint64_t nameHash) override
+        {
+            for (uint32_t index = 0; index != 3; ++index)
+                if (nameHash == dsHashFnv1a64(variableNames[index]))
+                    return index;
+            return 0;
+        }
+
+        void listen(dsEmitterId) override {}
+        bool readConstant(uint32_t constantIndex, dsValueOut out_value) override
+        {
+            return out_value.accept(constants_[constantIndex].ref());
+        }
+        bool readVariable(uint32_t variableIndex, dsValueOut out_value) override
+        {
+            return out_value.accept(variables_[variableIndex].ref());
+        }
+        bool invokeFunction(uint32_t, dsFunctionContext&) override { return false; }
+
+    private:
+        static constexpr char const* variableNames[] = {"X", "Y", "Z"};
+
+        dsExpressionCompiler* compiler_ = nullptr;
+        std::vector<uint8_t> byteCode_;
+        std::vector<dsValueStorage> constants_;
+        dsValueStorage variables_[3];
+    };
+
+    // builds an assembly with a single state node writing to a single variable named Value
+    std::vector<uint8_t> buildValueAssembly(dsAllocator& alloc)
+    {
+        BenchCompilerHost host;
+        dsGraphCompiler* compiler = dsCreateGraphCompiler(alloc, host);
+
+        constexpr dsNodeId entryNodeId{0};
+        constexpr dsNodeId stateNodeId{1};
+
+        compiler->addVariable(dsType<int32_t>.typeId, "Value");
+
+        compiler->beginNode(entryNodeId, entryNodeTypeId);
+        compiler->addOutputPlug(dsDefaultOutputPlugIndex);
+
+        compiler->beginNode(stateNodeId, stateNodeTypeId);
+        compiler->addInputPlug(dsBeginPlugIndex);
+        compiler->beginOutputSlot(dsOutputSlot{0}, dsType<int32_t>.typeId);
+        compiler->bindVariable("Value");
+
+        compiler->addWire(entryNodeId, dsDefaultOutputPlugIndex, stateNodeId, dsBeginPlugIndex);
+
+        std::vector<uint8_t> blob;
+        if (compiler->compile() && compiler->build())
+            blob.assign(compiler->assemblyBytes(), compiler->assemblyBytes() + compiler->assemblySize());
+
+        dsDestroyGraphCompiler(compiler);
+        return blob;
+    }
+
+    // builds an assembly with a single state node whose input slot reads Sensor()
+    std::vector<uint8_t> buildSensorAssembly(dsAllocator& alloc)
+    {
+        BenchCompilerHost host;
+        dsGraphCompiler* compiler = dsCreateGraphCompiler(alloc, host);
+
+        constexpr dsNodeId entryNodeId{0};
+        constexpr dsNodeId sensorNodeId{1};
+
+        compiler->beginNode(entryNodeId, entryNodeTypeId);
+        compiler->addOutputPlug(dsDefaultOutputPlugIndex);
+
+        compiler->beginNode(sensorNodeId, sensorNodeTypeId);
+        compiler->addInputPlug(dsBeginPlugIndex);
+        compiler->beginInputSlot(dsInputSlot{0}, dsType<int32_t>.typeId);
+        compiler->bindExpression("Sensor()");
+
+        compiler->addWire(entryNodeId, dsDefaultOutputPlugIndex, sensorNodeId, dsBeginPlugIndex);
+
+        std::vector<uint8_t> blob;
+        if (compiler->compile() && compiler->build())
+            blob.assign(compiler->assemblyBytes(), compiler->assemblyBytes() + compiler->assemblySize());
+
+        dsDestroyGraphCompiler(compiler);
+        return blob;
+    }
+
+    // builds an assembly with a single state node whose input slot evaluates the expression over int32 variables X, Y and Z
+    std::vector<uint8_t> buildExpressionAssembly(dsAllocator& alloc, char const* expression)
+    {
+        BenchCompilerHost host;
+        dsGraphCompiler* compiler = dsCreateGraphCompiler(alloc, host);
+
+        constexpr dsNodeId entryNodeId{0};
+        constexpr dsNodeId sensorNodeId{1};
+
+        compiler->addVariable(dsType<int32_t>.typeId, "X");
+        compiler->addVariable(dsType<int32_t>.typeId, "Y");
+        compiler->addVariable(dsType<int32_t>.typeId, "Z");
+
+        compiler->beginNode(entryNodeId, entryNodeTypeId);
+        compiler->addOutputPlug(dsDefaultOutputPlugIndex);
+
+        compiler->beginNode(sensorNodeId, sensorNodeTypeId);
+        compiler->addInputPlug(dsBeginPlugIndex);
+        compiler->beginInputSlot(dsInputSlot{0}, dsType<int32_t>.typeId);
+        compiler->bindExpression(expression);
+
+        compiler->addWire(entryNodeId, dsDefaultOutputPlugIndex, sensorNodeId, dsBeginPlugIndex);
+
+        std::vector<uint8_t> blob;
+        if (compiler->compile() && compiler->build())
+            blob.assign(compiler->assemblyBytes(), compiler->assemblyBytes() + compiler->assemblySize());
+
+        dsDestroyGraphCompiler(compiler);
+        return blob;
+    }
+} // namespace
+
+TEST_CASE("Instance lookup scaling", "[.][benchmark][runtime]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+
+    std::vector<uint8_t> const blob = buildValueAssembly(alloc);
+    REQUIRE_FALSE(blob.empty());
+
+    dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+    REQUIRE(assembly != nullptr);
+
+    for (uint32_t const count : {100u, 10'000u, 1'000'000u})
+    {
+        dsRuntime* const runtime = dsCreateRuntime(alloc, host);
+
+        std::vector<dsInstanceId> instanceIds;
+        instanceIds.reserve(count);
+        for (uint32_t index = 0; index != count; ++index)
+            instanceIds.push_back(runtime->createInstance(assembly));
+        runtime->processEvents();
+
+        // stride through the population so lookups are not biased towards the front of the instance table
+        uint32_t cursor = 0;
+        auto const nextId = [&]() {
+            cursor = (cursor + 7919) % count;
+            return instanceIds[cursor];
+        };
+
+        BENCHMARK(std::string("writeVariable x") + std::to_string(count))
+        {
+            return runtime->writeVariable(nextId(), dsName{"Value"}, dsValueRef{static_cast<int32_t>(cursor)});
+        };
+
+        BENCHMARK(std::string("readVariable x") + std::to_string(count))
+        {
+            dsValueStorage value;
+            return runtime->readVariable(nextId(), dsName{"Value"}, value.out());
+        };
+
+        dsVariableHandle const valueHandle = runtime->lookupVariable(assembly, dsName{"Value"});
+
+        BENCHMARK(std::string("writeVariable (handle) x") + std::to_string(count))
+        {
+            return runtime->writeVariable(nextId(), valueHandle, dsValueRef{static_cast<int32_t>(cursor)});
+        };
+
+        BENCHMARK(std::string("readVariable (handle) x") + std::to_string(count))
+        {
+            dsValueStorage value;
+            return runtime->readVariable(nextId(), valueHandle, value.out());
+        };
+
+        BENCHMARK(std::string("destroy+create x") + std::to_string(count))
+        {
+            dsInstanceId& slot = instanceIds[(cursor = (cursor + 7919) % count)];
+            runtime->destroyInstance(slot);
+            slot = runtime->createInstance(assembly);
+            return slot;
+        };
+
+        dsDestroyRuntime(runtime);
+    }
+
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Listener registry scaling", "[.][benchmark][runtime]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+
+    std::vector<uint8_t> const blob = buildSensorAssembly(alloc);
+    REQUIRE_FALSE(blob.empty());
+
+    dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+    REQUIRE(assembly != nullptr);
+
+    for (uint32_t const count : {100u, 10'000u, 100'000u})
+    {
+        dsRuntime* const runtime = dsCreateRuntime(alloc, host);
+
+        sensorEmitterIds.clear();
+        sensorCursor = 0;
+        for (uint32_t index = 0; index != count; ++index)
+            sensorEmitterIds.push_back(runtime->makeEmitterId());
+
+        for (uint32_t index = 0; index != count; ++index)
+            runtime->createInstance(assembly);
+        runtime->processEvents();
+
+        uint32_t cursor = 0;
+        auto const nextEmitterId = [&]() {
+            cursor = (cursor + 7919) % count;
+            return sensorEmitterIds[cursor];
+        };
+
+        BENCHMARK(std::string("notifyChange x") + std::to_string(count))
+        {
+            runtime->notifyChange(nextEmitterId());
+        };
+
+        // re-evaluating the slot listens to the same emitter, so its listener is kept in place
+        BENCHMARK(std::string("notifyChange+processEvents x") + std::to_string(count))
+        {
+            runtime->notifyChange(nextEmitterId());
+            runtime->processEvents();
+        };
+
+        dsDestroyRuntime(runtime);
+    }
+
+    sensorEmitterIds.clear();
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Expression evaluation", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+
+    // arithmetic-heavy, so that the cost of dispatching each operation dominates
+    char const* const expression = "X * Y + Z * X - Y * Z + X / Y - (X + Y) * (Z - X)";
+
+    BenchExpressionHost int32Host(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    REQUIRE(int32Host.build(expression));
+
+    dsValueStorage int32Result;
+    REQUIRE(int32Host.evaluate(int32Result));
+    CHECK(int32Result.is<int32_t>());
+
+    BENCHMARK("dsEvaluate int32")
+    {
+        dsValueStorage result;
+        return int32Host.evaluate(result);
+    };
+
+    BENCHMARK("dsEvaluateT int32")
+    {
+        dsValueStorage result;
+        return int32Host.evaluateConcrete(result);
+    };
+
+    BenchExpressionHost float32Host(alloc, 7.f, 3.f, 11.f);
+    REQUIRE(float32Host.build(expression));
+
+    dsValueStorage float32Result;
+    REQUIRE(float32Host.evaluate(float32Result));
+    CHECK(float32Result.is<float>());
+
+    BENCHMARK("dsEvaluate float32")
+    {
+        dsValueStorage result;
+        return float32Host.evaluate(result);
+    };
+
+    BENCHMARK("dsEvaluateT float32")
+    {
+        dsValueStorage result;
+        return float32Host.evaluateConcrete(result);
+    };
+}
+
+TEST_CASE("Slot expression evaluation", "[.][benchmark][runtime]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+
+    std::vector<uint8_t> const blob = buildExpressionAssembly(alloc, "X * Y + Z * X - Y * Z + X / Y - (X + Y) * (Z - X)");
+    REQUIRE_FALSE(blob.empty());
+
+    dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, host);
+
+    dsParam const params[] = {
+        {.name = dsName{"X"}, .value = 7},
+        {.name = dsName{"Y"}, .value = 3},
+        {.name = dsName{"Z"}, .value = 11},
+    };
+    dsInstanceId const instanceId = runtime->createInstance(assembly, params, sizeof(params) / sizeof(params[0]));
+    runtime->processEvents();
+
+    dsVariableHandle const handle = runtime->lookupVariable(assembly, dsName{"Z"});
+
+    // each write re-evaluates the slot expression once
+    int32_t value = 0;
+    BENCHMARK("writeVariable+processEvents")
+    {
+        runtime->writeVariable(instanceId, handle, dsValueRef{++value});
+        runtime->processEvents();
+    };
+
+    dsDestroyRuntime(runtime);
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Expression dispatch", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+    BenchExpressionHost evaluateHost(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    dsEvaluateScratch scratch(alloc);
+
+    // short slot expressions are dominated by entering the interpreter, long ones by dispatching each op-code
+    char const* const expressions[] = {
+        "X + 1",
+        "(X + Y) * (Z - 1) / (Y + 2)",
+        "X * Y + Z * X - Y * Z + X / Y - (X + Y) * (Z - X)",
+    };
+
+    // in the assembly's variable order
+    dsValueStorage const variables[] = {dsValueStorage{int32_t{7}}, dsValueStorage{int32_t{3}}, dsValueStorage{int32_t{11}}};
+
+    for (char const* const expression : expressions)
+    {
+        std::vector<uint8_t> const blob = buildExpressionAssembly(alloc, expression);
+        REQUIRE_FALSE(blob.empty());
+
+        dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage switchResult;
+        dsValueStorage threadedResult;
+        REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, switchResult.out(),
+            dsEvaluateDispatch::Switch));
+        REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, threadedResult.out(),
+            dsEvaluateDispatch::Threaded));
+        CHECK(switchResult.as<int32_t>() == threadedResult.as<int32_t>());
+
+        BENCHMARK(std::string("switch: ") + expression)
+        {
+            dsValueStorage result;
+            return dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out(),
+                dsEvaluateDispatch::Switch);
+        };
+
+        BENCHMARK(std::string("threaded: ") + expression)
+        {
+            dsValueStorage result;
+            return dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out(),
+                dsEvaluateDispatch::Threaded);
+        };
+
+#if DS_JIT
+        dsJitExpression jit;
+        REQUIRE(dsJitCompile(*assembly, dsAssemblyExpressionIndex{0}, variables, jit));
+        dsJitFunction const function = jit.function.load();
+
+        BENCHMARK(std::string("jit: ") + expression)
+        {
+            alignas(uint32_t) char result[sizeof(uint32_t)];
+            return function(variables, result);
+        };
+
+        dsJitRelease(jit);
+#endif
+
+        dsReleaseAssembly(assembly);
+    }
+}
+
+TEST_CASE("Native function calls", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+    BenchExpressionHost evaluateHost(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    dsEvaluateScratch scratch(alloc);
+
+    dsValueStorage const variables[] = {dsValueStorage{int32_t{7}}, dsValueStorage{int32_t{3}}, dsValueStorage{int32_t{11}}};
+
+    for (char const* const expression : {"MixGeneric(X, Y, Z) + MixGeneric(Z, Y, X)", "Mix(X, Y, Z) + Mix(Z, Y, X)"})
+    {
+        std::vector<uint8_t> const blob = buildExpressionAssembly(alloc, expression);
+        REQUIRE_FALSE(blob.empty());
+
+        dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage result;
+        REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out()));
+        CHECK(result.as<int32_t>() == 7 * 3 + 11 + 11 * 3 + 7);
+
+        BENCHMARK(expression)
+        {
+            dsValueStorage result;
+            return dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out());
+        };
+
+        dsReleaseAssembly(assembly);
+    }
+}
+
+TEST_CASE("Math intrinsics", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+    BenchExpressionHost evaluateHost(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    dsEvaluateScratch scratch(alloc);
+
+    dsValueStorage const variables[] = {dsValueStorage{int32_t{7}}, dsValueStorage{int32_t{3}}, dsValueStorage{int32_t{11}}};
+
+    // the same clamp, as a call to a natively bound host function and as an op-code
+    for (char const* const expression : {"Limit(X * Z, Y, Z) + Limit(Y - X, Y, Z)", "clamp(X * Z, Y, Z) + clamp(Y - X, Y, Z)"})
+    {
+        std::vector<uint8_t> const blob = buildExpressionAssembly(alloc, expression);
+        REQUIRE_FALSE(blob.empty());
+
+        dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage result;
+        REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out()));
+        CHECK(result.as<int32_t>() == 11 + 3);
+
+        BENCHMARK(expression)
+        {
+            dsValueStorage result;
+            return dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out());
+        };
+
+        dsReleaseAssembly(assembly);
+    }
+}
+
+TEST_CASE("Short circuit", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+    BenchExpressionHost evaluateHost(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    dsEvaluateScratch scratch(alloc);
+
+    dsValueStorage const variables[] = {dsValueStorage{int32_t{7}}, dsValueStorage{int32_t{3}}, dsValueStorage{int32_t{11}}};
+
+    // the same result, with the call jumped over by the false condition and with the call made
+    for (char const* const expression : {"select(X > Z, Limit(X * Z, Y, Z), Y)", "Limit(X * Z, Y, Y)"})
+    {
+        std::vector<uint8_t> const blob = buildExpressionAssembly(alloc, expression);
+        REQUIRE_FALSE(blob.empty());
+
+        dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage result;
+        REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out()));
+        CHECK(result.as<int32_t>() == 3);
+
+        BENCHMARK(expression)
+        {
+            dsValueStorage result;
+            return dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out());
+        };
+
+        dsReleaseAssembly(assembly);
+    }
+}
+
+TEST_CASE("Batch expression evaluation", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+    BenchRuntimeHost host;
+    BenchExpressionHost evaluateHost(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    dsEvaluateScratch scratch(alloc);
+
+    std::vector<uint8_t> const blob = buildExpressionAssembly(alloc, "X * Y + Z * X - Y * Z + X / Y - (X + Y) * (Z - X)");
+    REQUIRE_FALSE(blob.empty());
+
+    dsAssembly* const assembly = dsLoadAssembly(alloc, host, blob.data(), blob.size());
+    REQUIRE(assembly != nullptr);
+
+    // one variable block per instance, as a shared emitter would re-evaluate for a crowd
+    constexpr uint32_t blockCount = 1024;
+    std::vector<dsValueStorage> blocks(blockCount * 3);
+    std::vector<dsValueStorage const*> variables(blockCount);
+    for (uint32_t index = 0; index != blockCount; ++index)
+    {
+        blocks[index * 3 + 0] = dsValueStorage{static_cast<int32_t>(index)};
+        blocks[index * 3 + 1] = dsValueStorage{static_cast<int32_t>(index % 7 + 1)};
+        blocks[index * 3 + 2] = dsValueStorage{static_cast<int32_t>(index * 3)};
+        variables[index] = &blocks[index * 3];
+    }
+
+    std::vector<dsValueStorage> results(blockCount);
+
+    BENCHMARK("dsEvaluateInstructions x1024")
+    {
+        for (uint32_t index = 0; index != blockCount; ++index)
+        {
+            dsValueOut const out = results[index].out();
+            if (!dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables[index], out))
+                return false;
+        }
+        return true;
+    };
+
+    BENCHMARK("dsEvaluateInstructionsBatch x1024")
+    {
+        return dsEvaluateInstructionsBatch(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables.data(), blockCount,
+            results.data());
+    };
+
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Op-code histogram", "[.][benchmark][expression]")
+{
+    dsDefaultAllocator alloc;
+
+    // indexed by op-code, so the order must match dsOpCode
+    static constexpr char const* opNames[] = {"Nop", "PushTrue", "PushFalse", "PushNil", "Push0", "Push1", "Push2", "PushNeg1", "PushS8",
+        "PushU8", "PushS16", "PushU16", "PushConstant", "Read", "ReadI32", "ReadF32", "ReadB", "Call", "NegI32", "NegF32", "NotB", "AddI32",
+        "AddF32", "SubI32", "SubF32", "MulI32", "MulF32", "DivI32", "DivF32", "AndB", "OrB", "XorB", "MinI32", "MinF32", "MaxI32", "MaxF32",
+        "AbsI32", "AbsF32", "FloorF32", "SqrtF32", "ClampI32", "ClampF32", "LerpF32", "EqI32", "EqF32", "EqB", "NeI32", "NeF32", "NeB",
+        "LtI32", "LtF32", "LeI32", "LeF32", "GtI32", "GtF32", "GeI32", "GeF32", "Select", "Jump", "JumpIfFalse", "JumpIfFalseOrPop",
+        "JumpIfTrueOrPop", "ReadRead", "AddReadI32", "AddReadF32", "SubReadI32", "SubReadF32", "MulReadI32", "MulReadF32", "AddImmI32",
+        "SubImmI32", "MulImmI32"};
+    static_assert(sizeof(opNames) / sizeof(opNames[0]) == dsOpHistogram::opCount);
+
+    // representative slot expressions; the pairs which dominate are the candidates for superinstructions
+    char const* const int32Expressions[] = {
+        "X + 1",
+        "X * 2 + Y",
+        "Z - X * 3",
+        "-X + Y * Z",
+        "(X + Y) * (Z - 1) / (Y + 2)",
+        "X * Y + Z * X - Y * Z + X / Y - (X + Y) * (Z - X)",
+    };
+    // the language has no float literals, so these only combine variables
+    char const* const float32Expressions[] = {
+        "X * Y + Z",
+        "-X + Y * Z",
+        "(X - Y) * (X - Y) + (Z - Y) * (Z - Y)",
+        "X * Y + Z * X - Y * Z + X / Y - (X + Y) * (Z - X)",
+    };
+
+    dsOpHistogram histogram;
+    BenchExpressionHost int32Host(alloc, int32_t{7}, int32_t{3}, int32_t{11});
+    for (char const* const expression : int32Expressions)
+    {
+        REQUIRE(int32Host.build(expression));
+        REQUIRE(int32Host.countOpCodes(histogram));
+    }
+    BenchExpressionHost float32Host(alloc, 7.f, 3.f, 11.f);
+    for (char const* const expression : float32Expressions)
+    {
+        REQUIRE(float32Host.build(expression));
+        REQUIRE(float32Host.countOpCodes(histogram));
+    }
+
+    struct Pair
+    {
+        uint32_t first = 0;
+        uint32_t second = 0;
+        uint32_t count = 0;
+    };
+    std::vector<Pair> pairs;
+    for (uint32_t first = 0; first != dsOpHistogram::opCount; ++first)
+        for (uint32_t second = 0; second != dsOpHistogram::opCount; ++second)
+            if (histogram.pairs[first][second] != 0)
+                pairs.push_back({.first = first, .second = second, .count = histogram.pairs[first][second]});
+    std::sort(pairs.begin(), pairs.end(), [](Pair const& left, Pair const& right) { return left.count > right.count; });
+
+    for (Pair const& pair : pairs)
+        std::printf("%4u  %s %s\n", pair.count, opNames[pair.first], opNames[pair.second]);
+}
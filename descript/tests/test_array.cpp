@@ -0,0 +1,28 @@
+// descript
+
+#include <catch_amalgamated.hpp>
+
+#include "array.hh"
+#include "leak_alloc.hh"
+#include "string.hh"
+
+#include <string>
+
+using namespace descript;
+
+TEST_CASE("Array", "[array]")
+{
+    test::LeakTestAllocator alloc;
+
+    SECTION("Growth")
+    {
+        // grows several times past the initial capacity, moving strings that own allocations
+        dsArray<dsString> strings(alloc);
+        for (int index = 0; index != 100; ++index)
+            strings.pushBack(dsString(alloc, std::to_string(index).c_str()));
+
+        REQUIRE(strings.size() == 100);
+        for (int index = 0; index != 100; ++index)
+            CHECK(std::string(strings[index].cStr()) == std::to_string(index));
+    }
+}
@@ -2,15 +2,26 @@
 
 #include "test_expression.hh"
 
+#include "descript/bind.hh"
 #include "descript/context.hh"
 #include "descript/evaluate.hh"
 #include "descript/value.hh"
 
 #include "assembly_internal.hh"
+#include "evaluate_internal.hh"
 #include "leak_alloc.hh"
+#include "ops.hh"
 
 #include <catch_amalgamated.hpp>
 
+#include <initializer_list>
+
+namespace {
+    float lerp(float from, float to, float t) { return from + (to - from) * t; }
+
+    int touchCount = 0;
+} // namespace
+
 TEST_CASE("Virtual Machine", "[vm]")
 {
     using namespace descript;
@@ -20,6 +31,9 @@ TEST_CASE("Virtual Machine", "[vm]")
     static const Variable variables[] = {
         Variable{.name = "Seven", .value = dsValueStorage{7}},
         Variable{.name = "Eleven", .value = dsValueStorage{11}},
+        Variable{.name = "Half", .value = dsValueStorage{0.5f}},
+        Variable{.name = "A", .value = dsValueStorage{3}},
+        Variable{.name = "Off", .value = dsValueStorage{false}},
     };
 
     static constexpr Function functions[] = {
@@ -32,6 +46,26 @@ TEST_CASE("Virtual Machine", "[vm]")
                         result += ctx.getArgAt<int32_t>(i);
                     ctx.result(result);
                 }},
+        Function{.name = "Larger",
+            .returnType = dsType<int32_t>.typeId,
+            .function =
+                [](dsFunctionContext& ctx, void* userData) {
+                    int32_t const left = ctx.getArgAt<int32_t>(0);
+                    int32_t const right = ctx.getArgAt<int32_t>(1);
+                    ctx.result(left > right ? left : right);
+                },
+            .isPure = true},
+        Function{.name = "Blend",
+            .returnType = dsType<float>.typeId,
+            .function = dsBindFunction<&lerp>().function,
+            .signature = dsBindFunction<&lerp>().signature},
+        Function{.name = "Touch",
+            .returnType = dsType<bool>.typeId,
+            .function =
+                [](dsFunctionContext& ctx, void* userData) {
+                    ++touchCount;
+                    ctx.result(true);
+                }},
     };
 
     LeakTestAllocator alloc;
@@ -86,6 +120,16 @@ TEST_CASE("Virtual Machine", "[vm]")
         CHECK(tester.run("-Eleven", -11));
         CHECK(tester.run("Seven + Eleven", 18));
         CHECK(tester.run("Seven + 1", 8));
+        CHECK(tester.run("A + Seven", 10));
+    }
+
+    SECTION("Float")
+    {
+        CHECK(tester.run("Half", 0.5f));
+        CHECK(tester.run("-Half", -0.5f));
+        CHECK(tester.run("Half + Half", 1.f));
+        CHECK(tester.run("Half - Half * Half", 0.25f));
+        CHECK(tester.run("Half / Half", 1.f));
     }
 
     SECTION("Call")
@@ -100,7 +144,11 @@ TEST_CASE("Virtual Machine", "[vm]")
         CHECK(tester.run("Add(Seven, 0, Eleven)", 18));
     }
 
-    SECTION("Type errors") { CHECK_FALSE(tester.compile("1 + true", dsType<void>.typeId)); }
+    SECTION("Type errors")
+    {
+        CHECK_FALSE(tester.compile("1 + true", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("Half + 1", dsType<void>.typeId));
+    }
 
     SECTION("Constant optimization")
     {
@@ -115,4 +163,304 @@ TEST_CASE("Virtual Machine", "[vm]")
         CHECK(tester.variable("Seven", dsType<int32_t>.typeId));
         CHECK_FALSE(tester.variable("7", dsType<int32_t>.typeId));
     }
+
+    SECTION("Superinstructions")
+    {
+        // run() compares the fused byte code of the optimized build against the plain byte code
+        CHECK(tester.run("Seven * Eleven - A", 74));
+        CHECK(tester.run("Seven * 300 + 2", 2'102));
+        CHECK(tester.run("Seven - 40000", -39'993));
+        CHECK(tester.run("Half * Half - Half + Half", 0.25f));
+        CHECK(tester.run("Add(Seven, Eleven) * -3", -54));
+
+        auto const count = [](dsOpHistogram const& histogram, dsOpCode op) { return histogram.ops[static_cast<uint8_t>(op)]; };
+        dsOpHistogram histogram;
+
+        REQUIRE(tester.countOpCodes("Seven * Eleven - A", histogram));
+        CHECK(count(histogram, dsOpCode::Read) == 1);
+        CHECK(count(histogram, dsOpCode::MulReadI32) == 1);
+        CHECK(count(histogram, dsOpCode::SubReadI32) == 1);
+
+        REQUIRE(tester.countOpCodes("Seven * 300 - 2", histogram));
+        CHECK(count(histogram, dsOpCode::MulImmI32) == 1);
+        CHECK(count(histogram, dsOpCode::SubImmI32) == 1);
+
+        // the immediate does not fit the operand of the superinstruction
+        REQUIRE(tester.countOpCodes("Seven - 40000", histogram));
+        CHECK(count(histogram, dsOpCode::PushU16) == 1);
+        CHECK(count(histogram, dsOpCode::SubI32) == 1);
+
+        REQUIRE(tester.countOpCodes("Add(Seven, Eleven)", histogram));
+        CHECK(count(histogram, dsOpCode::ReadRead) == 1);
+        CHECK(count(histogram, dsOpCode::Read) == 0);
+    }
+
+    SECTION("Bound function")
+    {
+        CHECK(tester.run("Blend(Half, Half + Half, Half)", 0.75f));
+        CHECK(tester.run("Blend(Half, -Half, Half) + Half", 0.5f));
+
+        // the signature is generated from the C++ parameter types
+        CHECK_FALSE(tester.compile("Blend(Half, Half, 1)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("Blend(Half, Half)", dsType<void>.typeId));
+    }
+
+    SECTION("Pure function folding")
+    {
+        CHECK(tester.run("Larger(2, 3)", 3));
+        CHECK(tester.run("Larger(Seven, 3)", 7));
+        CHECK(tester.run("Larger(Seven, Larger(2, 30))", 30));
+
+        CHECK(tester.constant("Larger(2, 3)", 3));
+        CHECK(tester.constant("Larger(1 + 1, -4) * Larger(5, 5)", 10));
+        CHECK_FALSE(tester.constant("Larger(Seven, 3)", 7));
+        CHECK_FALSE(tester.constant("Add(1, 2)", 3));
+
+        auto const count = [](dsOpHistogram const& histogram, dsOpCode op) { return histogram.ops[static_cast<uint8_t>(op)]; };
+        dsOpHistogram histogram;
+
+        // the inner call is folded even though the outer one reads a variable
+        REQUIRE(tester.countOpCodes("Larger(Seven, Larger(2, 30))", histogram));
+        CHECK(count(histogram, dsOpCode::Call) == 1);
+    }
+
+    SECTION("Intrinsics")
+    {
+        CHECK(tester.run("min(Seven, Eleven)", 7));
+        CHECK(tester.run("max(Seven, Eleven)", 11));
+        CHECK(tester.run("abs(-Seven) + abs(A)", 10));
+        CHECK(tester.run("clamp(Eleven, 0, Seven)", 7));
+        CHECK(tester.run("clamp(-Seven, 0, Seven)", 0));
+        CHECK(tester.run("floor(Seven)", 7));
+        CHECK(tester.run("MAX(A, 2) * Min(A, 2)", 6));
+
+        CHECK(tester.run("min(Half, -Half)", -0.5f));
+        CHECK(tester.run("abs(-Half)", 0.5f));
+        CHECK(tester.run("floor(-Half)", -1.f));
+        CHECK(tester.run("sqrt(Half * Half)", 0.5f));
+        CHECK(tester.run("clamp(Half + Half, -Half, Half)", 0.5f));
+        CHECK(tester.run("lerp(Half, Half + Half, Half)", 0.75f));
+
+        CHECK(tester.constant("max(2, 3) * abs(-4)", 12));
+        CHECK(tester.constant("clamp(20, 0, 10) + floor(1)", 11));
+        CHECK_FALSE(tester.constant("min(Seven, 3)", 3));
+
+        // every argument must have the same type, and integers have no square root
+        CHECK_FALSE(tester.compile("min(Seven, Half)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("sqrt(Seven)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("abs(1, 2)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("lerp(Half, Half)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("min(true, false)", dsType<void>.typeId));
+
+        auto const count = [](dsOpHistogram const& histogram, dsOpCode op) { return histogram.ops[static_cast<uint8_t>(op)]; };
+        dsOpHistogram histogram;
+
+        REQUIRE(tester.countOpCodes("max(Seven, Eleven)", histogram));
+        CHECK(count(histogram, dsOpCode::MaxI32) == 1);
+        CHECK(count(histogram, dsOpCode::Call) == 0);
+
+        // the floor of an integer is the integer itself
+        REQUIRE(tester.countOpCodes("floor(Seven)", histogram));
+        CHECK(count(histogram, dsOpCode::Read) == 1);
+        CHECK(count(histogram, dsOpCode::Nop) == 0);
+    }
+
+    SECTION("Comparison")
+    {
+        CHECK(tester.run("Seven < Eleven", true));
+        CHECK(tester.run("Seven >= Eleven", false));
+        CHECK(tester.run("Seven == 7", true));
+        CHECK(tester.run("Seven is A", false));
+        CHECK(tester.run("Seven != A", true));
+        CHECK(tester.run("Half <= Half", true));
+        CHECK(tester.run("-Half > Half", false));
+        CHECK(tester.run("Off == not true", true));
+        CHECK(tester.run("A + 4 == Seven and Seven * 2 > Eleven", true));
+
+        CHECK(tester.constant("1 + 1 == 2", true));
+        CHECK(tester.constant("-1 > 0 or 2 <= 2", true));
+
+        // both operands must have the same type, and only numbers are ordered
+        CHECK_FALSE(tester.compile("Seven < Half", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("Off < true", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("Seven == Off", dsType<void>.typeId));
+    }
+
+    SECTION("Select")
+    {
+        CHECK(tester.run("select(Seven < A, Seven, A)", 3));
+        CHECK(tester.run("select(Off, Half, -Half)", -0.5f));
+        CHECK(tester.run("SELECT(not Off, Seven, A) + 1", 8));
+        CHECK(tester.run("select(Off, Add(1), 2) * Seven", 14));
+        CHECK(tester.run("Seven + select(Off, Add(1), A)", 10));
+        CHECK(tester.run("select(A < Seven, Add(Seven, Eleven), Larger(A, 2)) - Eleven", 7));
+
+        CHECK(tester.constant("select(1 < 2, 10, 20)", 10));
+        CHECK_FALSE(tester.constant("select(Off, 10, 20)", 20));
+
+        CHECK_FALSE(tester.compile("select(Seven, 1, 2)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("select(Off, 1, Half)", dsType<void>.typeId));
+        CHECK_FALSE(tester.compile("select(Off, 1)", dsType<void>.typeId));
+
+        auto const count = [](dsOpHistogram const& histogram, dsOpCode op) { return histogram.ops[static_cast<uint8_t>(op)]; };
+        dsOpHistogram histogram;
+
+        // both branches are evaluated unless one of them calls a function
+        REQUIRE(tester.countOpCodes("select(Seven < A, Seven, A)", histogram));
+        CHECK(count(histogram, dsOpCode::Select) == 1);
+        CHECK(count(histogram, dsOpCode::JumpIfFalse) == 0);
+
+        REQUIRE(tester.countOpCodes("select(Off, Add(1), 2)", histogram));
+        CHECK(count(histogram, dsOpCode::Select) == 0);
+        CHECK(count(histogram, dsOpCode::JumpIfFalse) == 1);
+        CHECK(count(histogram, dsOpCode::Jump) == 1);
+
+        // a jump target is never fused into the instruction before it
+        REQUIRE(tester.countOpCodes("Seven * select(Off, Add(1), A)", histogram));
+        CHECK(count(histogram, dsOpCode::MulReadI32) == 0);
+        CHECK(count(histogram, dsOpCode::MulI32) == 1);
+    }
+
+    SECTION("Host functions named as built-ins")
+    {
+        static constexpr Function shadowing[] = {
+            Function{.name = "max",
+                .returnType = dsType<int32_t>.typeId,
+                .function =
+                    [](dsFunctionContext& ctx, void* userData) {
+                        int32_t result = 0;
+                        for (uint32_t i = 0; i != ctx.getArgCount(); ++i)
+                            result += ctx.getArgAt<int32_t>(i);
+                        ctx.result(result);
+                    }},
+            Function{.name = "select",
+                .returnType = dsType<int32_t>.typeId,
+                .function = [](dsFunctionContext& ctx, void* userData) { ctx.result(ctx.getArgAt<int32_t>(2)); }},
+        };
+        ExpressionTester shadowed(alloc, variables, shadowing);
+
+        // the host's functions are called, rather than the built-ins they share a name with
+        CHECK(shadowed.run("max(Seven, Eleven)", 18));
+        CHECK(shadowed.run("select(1, Seven, A)", 3));
+
+        // built-ins the host does not define are unaffected, as are other spellings of the host's names
+        CHECK(shadowed.run("min(Seven, Eleven)", 7));
+        CHECK(shadowed.run("MAX(Seven, Eleven)", 11));
+        CHECK(shadowed.run("Select(Off, Seven, A)", 3));
+
+        auto const count = [](dsOpHistogram const& histogram, dsOpCode op) { return histogram.ops[static_cast<uint8_t>(op)]; };
+        dsOpHistogram histogram;
+
+        REQUIRE(shadowed.countOpCodes("max(Seven, Eleven)", histogram));
+        CHECK(count(histogram, dsOpCode::MaxI32) == 0);
+        CHECK(count(histogram, dsOpCode::Call) == 1);
+    }
+
+    SECTION("Short circuit")
+    {
+        touchCount = 0;
+        CHECK(tester.run("Off and Touch()", false));
+        CHECK(tester.run("not Off or Touch()", true));
+        CHECK(tester.run("select(Off, Touch(), Off)", false));
+        CHECK(touchCount == 0);
+
+        CHECK(tester.run("Off or Touch()", true));
+        CHECK(tester.run("not Off and Touch()", true));
+        CHECK(touchCount != 0);
+
+        // a constant left operand decides the result without any code at all
+        touchCount = 0;
+        CHECK(tester.constant("false and Touch()", false));
+        CHECK(tester.constant("true or Touch()", true));
+        CHECK(touchCount == 0);
+
+        auto const count = [](dsOpHistogram const& histogram, dsOpCode op) { return histogram.ops[static_cast<uint8_t>(op)]; };
+        dsOpHistogram histogram;
+
+        REQUIRE(tester.countOpCodes("Off and Touch()", histogram));
+        CHECK(count(histogram, dsOpCode::JumpIfFalseOrPop) == 1);
+        CHECK(count(histogram, dsOpCode::AndB) == 0);
+
+        REQUIRE(tester.countOpCodes("Off or Touch()", histogram));
+        CHECK(count(histogram, dsOpCode::JumpIfTrueOrPop) == 1);
+
+        // a right operand without calls is cheaper to evaluate than to jump over
+        REQUIRE(tester.countOpCodes("Off and not Off", histogram));
+        CHECK(count(histogram, dsOpCode::AndB) == 1);
+        CHECK(count(histogram, dsOpCode::JumpIfFalseOrPop) == 0);
+    }
+}
+
+TEST_CASE("Byte code decoding", "[vm]")
+{
+    using namespace descript;
+
+    // an empty header has no constants, variables, or functions for operands to refer to
+    dsAssemblyHeader const header;
+
+    auto const decode = [&header](std::initializer_list<uint8_t> ops, dsByteCodeSummary& out_summary) {
+        return dsDecodeByteCode(header, nullptr, ops.begin(), static_cast<uint32_t>(ops.size()), nullptr, out_summary);
+    };
+
+    dsByteCodeSummary summary;
+
+    CHECK(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::PushU16, 0x01, 0x02, (uint8_t)dsOpCode::AddI32}, summary));
+    CHECK(summary.instructionCount == 3);
+    CHECK(summary.maxStack == 2);
+
+    // a superinstruction needs as much stack as the sequence it fuses
+    CHECK(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::AddImmI32, 0xff, 0xfe}, summary));
+    CHECK(summary.instructionCount == 2);
+    CHECK(summary.maxStack == 2);
+
+    CHECK(decode({(uint8_t)dsOpCode::Push0, (uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::Push2, (uint8_t)dsOpCode::ClampI32}, summary));
+    CHECK(summary.instructionCount == 4);
+    CHECK(summary.maxStack == 3);
+
+    // condition, JumpIfFalse over the true branch, true branch, Jump over the false branch, false branch
+    CHECK(decode({(uint8_t)dsOpCode::PushTrue, (uint8_t)dsOpCode::JumpIfFalse, 0x00, 0x04, (uint8_t)dsOpCode::Push1,
+                     (uint8_t)dsOpCode::Jump, 0x00, 0x01, (uint8_t)dsOpCode::Push2},
+        summary));
+    CHECK(summary.instructionCount == 5);
+    CHECK(summary.maxStack == 1);
+
+    CHECK(decode({(uint8_t)dsOpCode::PushFalse, (uint8_t)dsOpCode::JumpIfFalseOrPop, 0x00, 0x01, (uint8_t)dsOpCode::PushTrue}, summary));
+
+    // truncated operands
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::PushS8}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::PushS16, 0x01}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Call, 0x00, 0x00}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::MulImmI32, 0x00}, summary));
+
+    // out of range operands
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Read, 0x00, 0x00}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::ReadF32, 0x00, 0x00}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::PushConstant, 0x00, 0x00}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::ReadRead, 0x00, 0x00, 0x00, 0x00}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::AddReadI32, 0x00, 0x00}, summary));
+
+    // jumps past the end, or into the operands of an instruction
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::Jump, 0x00, 0x01}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::PushTrue, (uint8_t)dsOpCode::JumpIfFalse, 0x00, 0x01, (uint8_t)dsOpCode::PushU8, 0x07,
+                           (uint8_t)dsOpCode::Push1},
+        summary));
+
+    // unknown op-codes
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Last}, summary));
+
+    // unbalanced stacks
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::AddI32}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::SubImmI32, 0x00, 0x01}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::Push2, (uint8_t)dsOpCode::LerpF32}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::Push2}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Nop}, summary));
+
+    // the stack must be as deep at a jump target whichever way it is reached
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::PushTrue, (uint8_t)dsOpCode::JumpIfFalse, 0x00, 0x01, (uint8_t)dsOpCode::Push1}, summary));
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::PushTrue, (uint8_t)dsOpCode::JumpIfTrueOrPop, 0x00, 0x02, (uint8_t)dsOpCode::Push1,
+                           (uint8_t)dsOpCode::Push2},
+        summary));
+
+    // unreachable code after an unconditional jump
+    CHECK_FALSE(decode({(uint8_t)dsOpCode::Push1, (uint8_t)dsOpCode::Jump, 0x00, 0x01, (uint8_t)dsOpCode::Push2}, summary));
 }
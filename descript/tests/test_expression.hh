@@ -10,6 +10,8 @@
 #include "descript/value.hh"
 
 #include "array.hh"
+#include "evaluate_internal.hh"
+#include "evaluate_t.hh"
 #include "fnv.hh"
 #include "storage.hh"
 #include "utility.hh"
@@ -23,6 +25,8 @@ namespace descript::test::expression {
         dsTypeId returnType;
         dsFunction function = nullptr;
         void* userData = nullptr;
+        bool isPure = false;                            // the compiler may fold calls by invoking function directly
+        dsFunctionSignature const* signature = nullptr; // checked against the arguments of every call
     };
 
     struct Variable
@@ -78,6 +82,8 @@ namespace descript::test::expression {
             EvalFailed,
             OptimizedEvalFailed,
             OptimizedResultFailed,
+            ConcreteEvalFailed,
+            ConcreteResultFailed,
             NotConstant,
             ResultFailed,
         } code = Code::Success;
@@ -107,6 +113,9 @@ namespace descript::test::expression {
             case Code::NotConstant: return os << "Not Constant";
             case Code::OptimizedResultFailed:
                 return os << "Result (Optimized) Failed\nExpected: " << result.expected << "\nResult: " << result.actual;
+            case Code::ConcreteEvalFailed: return os << "Eval (Concrete Host) Failed\nExpected: " << result.expected;
+            case Code::ConcreteResultFailed:
+                return os << "Result (Concrete Host) Failed\nExpected: " << result.expected << "\nResult: " << result.actual;
             default: return os;
             }
         }
@@ -126,6 +135,13 @@ namespace descript::test::expression {
         CompileResult variable(char const* expression, dsTypeId expectedType);
         RunResult run(char const* expression, dsValueStorage const& expected);
         RunResult constant(char const* expression, dsValueStorage const& expected);
+        bool countOpCodes(char const* expression, dsOpHistogram& out_histogram);
+
+        // dsEvaluateHost, public so that dsEvaluateT may also evaluate over the tester directly
+        void listen(dsEmitterId) override {}
+        bool readVariable(uint32_t variableIndex, dsValueOut out_value) override;
+        bool readConstant(uint32_t constantIndex, dsValueOut out_value) override;
+        bool invokeFunction(uint32_t functionIndex, dsFunctionContext& ctx) override;
 
     protected:
         // dsExpressionCompilerHost
@@ -138,12 +154,6 @@ namespace descript::test::expression {
         uint32_t pushFunction(dsFunctionId functionId) override;
         uint32_t pushVariable(uint64_t nameHash) override;
 
-        // dsEvaluateHost
-        void listen(dsEmitterId) override {}
-        bool readVariable(uint32_t variableIndex, dsValueOut out_value) override;
-        bool readConstant(uint32_t constantIndex, dsValueOut out_value) override;
-        bool invokeFunction(uint32_t functionIndex, dsFunctionContext& ctx) override;
-
     private:
         dsArray<uint8_t> byteCode_;
         dsArray<dsValueStorage> constants_;
@@ -214,6 +224,14 @@ namespace descript::test::expression {
         if (optimizedResult != expected)
             return RunResult{RunResult::Code::OptimizedResultFailed, expected, optimizedResult};
 
+        // the same evaluator, instantiated over the concrete host rather than dsEvaluateHost
+        dsValueStorage concreteResult;
+        if (!dsEvaluateT(*this, byteCode_.data() + optimizedByteCodeOffset, byteCode_.size() - optimizedByteCodeOffset,
+                concreteResult.out()))
+            return RunResult{RunResult::Code::ConcreteEvalFailed, expected};
+        if (concreteResult != expected)
+            return RunResult{RunResult::Code::ConcreteResultFailed, expected, concreteResult};
+
         return RunResult{RunResult::Code::Success, expected, result};
     };
 
@@ -234,6 +252,16 @@ namespace descript::test::expression {
         return RunResult{RunResult::Code::Success, expected, actual};
     };
 
+    bool ExpressionTester::countOpCodes(char const* expression, dsOpHistogram& out_histogram)
+    {
+        uint32_t const byteCodeOffset = byteCode_.size();
+        if (!compiler_->compile(expression) || !compiler_->optimize() || !compiler_->build(*this))
+            return false;
+
+        out_histogram = dsOpHistogram{};
+        return dsCountOpCodes(byteCode_.data() + byteCodeOffset, byteCode_.size() - byteCodeOffset, out_histogram);
+    }
+
     bool ExpressionTester::lookupVariable(dsName name, dsVariableCompileMeta& out_meta) const noexcept
     {
         uint32_t const variableLen = dsNameLen(name);
@@ -258,6 +286,10 @@ namespace descript::test::expression {
             {
                 out_meta.functionId = dsFunctionId{nextFunctionId};
                 out_meta.returnType = function.returnType;
+                out_meta.isPure = function.isPure;
+                out_meta.fold = function.function;
+                out_meta.foldUserData = function.userData;
+                out_meta.signature = function.signature;
                 return true;
             }
             ++nextFunctionId;
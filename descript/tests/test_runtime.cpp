@@ -4,6 +4,7 @@
 
 #include "descript/alloc.hh"
 #include "descript/assembly.hh"
+#include "descript/bind.hh"
 #include "descript/context.hh"
 #include "descript/database.hh"
 #include "descript/evaluate.hh"
@@ -13,17 +14,48 @@
 #include "descript/value.hh"
 
 #include "array.hh"
+#include "assembly_internal.hh"
+#include "evaluate_internal.hh"
 #include "fnv.hh"
 #include "leak_alloc.hh"
 #include "storage.hh"
 #include "utility.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
 using namespace descript;
 
+namespace {
+    // a value type which is not built-in, so is boxed on the stack and never packed
+    struct TestPair
+    {
+        int32_t first = 0;
+        int32_t second = 0;
+
+        bool operator==(TestPair const&) const noexcept = default;
+    };
+} // namespace
+
+template <>
+struct descript::dsValueTraits<TestPair>
+{
+    static constexpr char name[] = "TestPair";
+};
+
 namespace {
     static bool canaryValue = false;
     static bool flagValue = false;
     static dsEmitterId flagEmitterId = dsInvalidEmitterId;
+    static int countedCalls = 0;
+    static int volatileCalls = 0;
+    static dsEmitterId otherEmitterId = dsInvalidEmitterId;
+    static int switchedCalls = 0;
 
     class EmptyState final : public NodeVirtualBase<EmptyState>
     {
@@ -162,10 +194,27 @@ namespace {
         {.typeId = ToggleState::typeId, .kind = ToggleState::kind},
     };
 
+    static float lerp(float from, float to, float t) noexcept { return from + (to - from) * t; }
+
+    static constexpr dsFunctionBinding lerpBinding = dsBindFunction<&lerp>();
+
+    // counts calls to the generic adapter of a bound function, which the interpreter should bypass
+    static int genericLerpCalls = 0;
+
+    static void genericLerp(dsFunctionContext& ctx, void* userData)
+    {
+        ++genericLerpCalls;
+        lerpBinding.function(ctx, userData);
+    }
+
     static constexpr dsFunctionCompileMeta functions[] = {
         {.name = "series", .functionId = dsFunctionId{0}, .returnType = dsType<int32_t>.typeId},
         {.name = "readFlag", .functionId = dsFunctionId{1}, .returnType = dsType<bool>.typeId},
         {.name = "readFlagNum", .functionId = dsFunctionId{2}, .returnType = dsType<int32_t>.typeId},
+        {.name = "countedFlagNum", .functionId = dsFunctionId{3}, .returnType = dsType<int32_t>.typeId},
+        {.name = "volatileFlagNum", .functionId = dsFunctionId{4}, .returnType = dsType<int32_t>.typeId, .isVolatile = true},
+        {.name = "switchedFlagNum", .functionId = dsFunctionId{5}, .returnType = dsType<int32_t>.typeId},
+        {.name = "mix", .functionId = dsFunctionId{6}, .returnType = dsType<float>.typeId, .signature = lerpBinding.signature},
     };
 
     class TestCompilerHost final : public dsGraphCompilerHost
@@ -215,6 +264,7 @@ namespace {
 
         void registerNode(dsNodeTypeId typeId, dsNodeFunction function, uint32_t userSize, uint32_t userAlign);
         void registerFunction(dsFunctionId functionId, dsFunction function, void* userData = nullptr);
+        void registerFunction(dsFunctionRuntimeMeta const& meta) { functions_.pushBack(meta); }
 
         template <typename NodeT>
         void registerNode()
@@ -226,10 +276,18 @@ namespace {
         bool lookupFunction(dsFunctionId, dsFunctionRuntimeMeta& out_meta) const noexcept override;
         bool lookupType(dsTypeId typeId, dsTypeMeta const*& out_meta) const noexcept override;
 
+        dsRuntimeScheduler* scheduler() const noexcept override { return scheduler_; }
+        void setScheduler(dsRuntimeScheduler* scheduler) noexcept { scheduler_ = scheduler; }
+
+        uint32_t postedChangeCapacity() const noexcept override { return postedChangeCapacity_; }
+        void setPostedChangeCapacity(uint32_t capacity) noexcept { postedChangeCapacity_ = capacity; }
+
         dsAllocator& allocator() noexcept { return allocator_; }
 
     private:
         dsAllocator& allocator_;
+        dsRuntimeScheduler* scheduler_ = nullptr;
+        uint32_t postedChangeCapacity_ = 4096;
         dsTypeDatabase& database_;
         dsArray<dsNodeRuntimeMeta> nodes_;
         dsArray<dsFunctionRuntimeMeta> functions_;
@@ -282,6 +340,56 @@ namespace {
         return false;
     }
 
+    // counts the allocations passed through to another allocator, and fails any beyond its budget
+    class CountingAllocator final : public dsAllocator
+    {
+    public:
+        explicit CountingAllocator(dsAllocator& base) noexcept : base_(base) {}
+
+        void* allocate(uint32_t size, uint32_t alignment) override
+        {
+            if (allocations == budget)
+                return nullptr;
+            ++allocations;
+            return base_.allocate(size, alignment);
+        }
+
+        void free(void* block, uint32_t size, uint32_t alignment) override { base_.free(block, size, alignment); }
+
+        uint32_t allocations = 0;
+        uint32_t budget = UINT32_MAX;
+
+    private:
+        dsAllocator& base_;
+    };
+
+    // runs every job on its own thread
+    class ThreadScheduler final : public dsRuntimeScheduler
+    {
+    public:
+        uint32_t workerCount() const noexcept override { return 4; }
+
+        void dispatch(dsRuntimeJob job, void* userData, uint32_t jobCount) override
+        {
+            std::vector<std::thread> threads;
+            for (uint32_t jobIndex = 1; jobIndex < jobCount; ++jobIndex)
+                threads.emplace_back(job, userData, jobIndex);
+            job(userData, 0);
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+    };
+
+    // evaluates decoded expressions outside of a runtime, so nothing is listening
+    class DetachedEvaluateHost final : public dsEvaluateHost
+    {
+    public:
+        void listen(dsEmitterId) override {}
+        bool readConstant(uint32_t, dsValueOut) override { return false; }
+        bool readVariable(uint32_t, dsValueOut) override { return false; }
+        bool invokeFunction(uint32_t, dsFunctionContext&) override { return false; }
+    };
+
     static void series(dsFunctionContext& ctx, void* userData)
     {
         int32_t result = 1;
@@ -301,6 +409,100 @@ namespace {
         ctx.listen(flagEmitterId);
         ctx.result(flagValue ? 1 : 0);
     }
+
+    static void countedFlagNum(dsFunctionContext& ctx, void* userData)
+    {
+        ++countedCalls;
+        ctx.listen(flagEmitterId);
+        ctx.result(flagValue ? 1 : 0);
+    }
+
+    static void volatileFlagNum(dsFunctionContext& ctx, void* userData)
+    {
+        ++volatileCalls;
+        ctx.result(flagValue ? 1 : 0);
+    }
+
+    // listens to the flag until it is set, and to the other emitter afterwards
+    static void switchedFlagNum(dsFunctionContext& ctx, void* userData)
+    {
+        ++switchedCalls;
+        ctx.listen(flagValue ? otherEmitterId : flagEmitterId);
+        ctx.result(flagValue ? 1 : 0);
+    }
+
+    struct TestVariable
+    {
+        dsTypeId type = dsInvalidTypeId;
+        char const* name = nullptr;
+    };
+
+    // an entry node wired to a single SetState node, whose slots each test binds to whatever it checks;
+    // owns the type database and hosts the graph is compiled and loaded with
+    struct SetStateGraph
+    {
+        explicit SetStateGraph(dsAllocator& allocator)
+            : alloc(allocator), database(dsCreateTypeDatabase(allocator)), runtimeHost(allocator, *database), compilerHost(allocator)
+        {
+            runtimeHost.registerNode(entryNodeTypeId, nullptr, 0, alignof(void*));
+            runtimeHost.registerNode<SetState>();
+        }
+
+        ~SetStateGraph() { dsDestroyTypeDatabase(database); }
+
+        SetStateGraph(SetStateGraph const&) = delete;
+        SetStateGraph& operator=(SetStateGraph const&) = delete;
+
+        // declares the variables, then lets bindSlots bind the slots of the open SetState node; fails
+        // with nullptr if the graph does not compile
+        template <typename BindT>
+        [[nodiscard]] dsAssembly* build(TestVariable const* first, TestVariable const* last, BindT const& bindSlots)
+        {
+            constexpr dsNodeId entryNodeId{0};
+            constexpr dsNodeId setNodeId{1};
+
+            dsGraphCompiler* const compiler = dsCreateGraphCompiler(alloc, compilerHost);
+
+            for (TestVariable const* variable = first; variable != last; ++variable)
+                compiler->addVariable(variable->type, variable->name);
+
+            compiler->beginNode(entryNodeId, entryNodeTypeId);
+            compiler->addOutputPlug(dsDefaultOutputPlugIndex);
+
+            compiler->beginNode(setNodeId, SetState::typeId);
+            compiler->addInputPlug(dsBeginPlugIndex);
+            bindSlots(*compiler);
+
+            compiler->addWire(entryNodeId, dsDefaultOutputPlugIndex, setNodeId, dsBeginPlugIndex);
+
+            dsAssembly* assembly = nullptr;
+            if (compiler->compile() && compiler->build())
+                assembly = dsLoadAssembly(alloc, runtimeHost, compiler->assemblyBytes(), compiler->assemblySize());
+
+            dsDestroyGraphCompiler(compiler);
+            return assembly;
+        }
+
+        template <typename BindT>
+        [[nodiscard]] dsAssembly* build(std::initializer_list<TestVariable> variables, BindT const& bindSlots)
+        {
+            return build(variables.begin(), variables.end(), bindSlots);
+        }
+
+        // binds the expression to the first input slot, with variables X and Y both of the given type
+        [[nodiscard]] dsAssembly* buildExpression(char const* expression, dsTypeId typeId)
+        {
+            return build({{.type = typeId, .name = "X"}, {.type = typeId, .name = "Y"}}, [&](dsGraphCompiler& compiler) {
+                compiler.beginInputSlot(dsInputSlot(0), typeId);
+                compiler.bindExpression(expression);
+            });
+        }
+
+        dsAllocator& alloc;
+        dsTypeDatabase* const database = nullptr;
+        TestRuntimeHost runtimeHost;
+        TestCompilerHost compilerHost;
+    };
 } // namespace
 
 TEST_CASE("Graph Compiler", "[runtime]")
@@ -457,6 +659,15 @@ TEST_CASE("Graph Compiler", "[runtime]")
 
     flagEmitterId = runtime->makeEmitterId();
 
+    // assemblies from another version are refused, even with a matching hash
+    {
+        std::vector<uint8_t> stale = blob;
+        dsAssemblyHeader* const header = reinterpret_cast<dsAssemblyHeader*>(stale.data());
+        header->version = dsAssemblyVersion - 1;
+        header->hash = dsHashAssembly(header);
+        CHECK(dsLoadAssembly(alloc, runtimeHost, stale.data(), stale.size()) == nullptr);
+    }
+
     dsAssembly* assembly = dsLoadAssembly(alloc, runtimeHost, blob.data(), blob.size());
     REQUIRE(assembly != nullptr);
 
@@ -526,3 +737,1253 @@ TEST_CASE("Graph Compiler", "[runtime]")
     dsDestroyRuntime(runtime);
     dsDestroyTypeDatabase(database);
 }
+
+TEST_CASE("Instance handles", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+
+    auto const build = [&graph] {
+        return graph.build({{.type = dsType<int32_t>.typeId, .name = "Value"}}, [](dsGraphCompiler& compiler) {
+            compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindConstant(7);
+            compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindVariable("Value");
+        });
+    };
+
+    dsAssembly* assembly = build();
+    REQUIRE(assembly != nullptr);
+
+    dsAssembly* otherAssembly = build();
+    REQUIRE(otherAssembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    // instance memory is recycled through the assembly's pool; the leak allocator checks it is all returned
+    dsReserveInstances(assembly, 2);
+
+    dsInstanceId const firstId = runtime->createInstance(assembly);
+    REQUIRE(firstId != dsInvalidInstanceId);
+
+    runtime->destroyInstance(firstId);
+
+    // the slot of the destroyed instance is reused, but the old id must not resolve to the new instance
+    dsInstanceId const secondId = runtime->createInstance(assembly);
+    REQUIRE(secondId != dsInvalidInstanceId);
+    CHECK(secondId != firstId);
+
+    runtime->processEvents();
+
+    dsValueStorage value;
+    CHECK_FALSE(runtime->readVariable(firstId, dsName{"Value"}, value.out()));
+    CHECK_FALSE(runtime->writeVariable(firstId, dsName{"Value"}, dsValueRef{1}));
+    REQUIRE(runtime->readVariable(secondId, dsName{"Value"}, value.out()));
+    CHECK(value.as<int32_t>() == 7);
+
+    // destroying a stale id is a no-op
+    runtime->destroyInstance(firstId);
+    CHECK(runtime->readVariable(secondId, dsName{"Value"}, value.out()));
+
+    CHECK_FALSE(runtime->readVariable(dsInvalidInstanceId, dsName{"Value"}, value.out()));
+
+    // variable handles are resolved once, and only accepted by instances of the same assembly
+    dsVariableHandle const valueHandle = runtime->lookupVariable(assembly, dsName{"Value"});
+    REQUIRE(valueHandle != dsInvalidVariableHandle);
+    CHECK(runtime->lookupVariable(assembly, dsName{"Missing"}) == dsInvalidVariableHandle);
+
+    CHECK(runtime->writeVariable(secondId, valueHandle, dsValueRef{9}));
+    REQUIRE(runtime->readVariable(secondId, valueHandle, value.out()));
+    CHECK(value.as<int32_t>() == 9);
+    CHECK_FALSE(runtime->readVariable(firstId, valueHandle, value.out()));
+
+    dsVariableHandle const otherHandle = runtime->lookupVariable(otherAssembly, dsName{"Value"});
+    REQUIRE(otherHandle != dsInvalidVariableHandle);
+    CHECK_FALSE(runtime->writeVariable(secondId, otherHandle, dsValueRef{1}));
+    CHECK_FALSE(runtime->readVariable(secondId, otherHandle, value.out()));
+
+    dsReleaseAssembly(otherAssembly);
+    dsReleaseAssembly(assembly);
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Instance pool", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator leakAlloc;
+    CountingAllocator alloc(leakAlloc);
+    SetStateGraph graph(alloc);
+
+    dsAssembly* const assembly = graph.build({{.type = dsType<int32_t>.typeId, .name = "Value"}}, [](dsGraphCompiler& compiler) {
+        compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindConstant(7);
+        compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindVariable("Value");
+    });
+    REQUIRE(assembly != nullptr);
+    dsAssemblyInstancePool const& pool = assembly->instancePool;
+
+    SECTION("Reserved")
+    {
+        constexpr uint32_t blockCount = 20;
+
+        uint32_t const before = alloc.allocations;
+        dsReserveInstances(assembly, blockCount);
+        CHECK(alloc.allocations - before == 1);
+        CHECK(pool.freeCount == blockCount);
+
+        // reserved blocks are handed out without touching the allocator
+        void* blocks[blockCount] = {};
+        for (void*& block : blocks)
+        {
+            block = dsAllocateInstanceMemory(*assembly);
+            REQUIRE(block != nullptr);
+        }
+        CHECK(alloc.allocations - before == 1);
+        CHECK(pool.freeCount == 0);
+
+        // as is the block of the last instance destroyed
+        dsFreeInstanceMemory(*assembly, blocks[3]);
+        CHECK(dsAllocateInstanceMemory(*assembly) == blocks[3]);
+        CHECK(alloc.allocations - before == 1);
+
+        for (void* const block : blocks)
+            dsFreeInstanceMemory(*assembly, block);
+        CHECK(pool.freeCount == blockCount);
+
+        // instances take their memory from the pool, and give it back
+        dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+        dsInstanceId const instanceId = runtime->createInstance(assembly);
+        REQUIRE(instanceId != dsInvalidInstanceId);
+        CHECK(pool.freeCount == blockCount - 1);
+        runtime->destroyInstance(instanceId);
+        CHECK(pool.freeCount == blockCount);
+        CHECK(pool.blockCount == blockCount);
+        dsDestroyRuntime(runtime);
+    }
+
+    SECTION("Large")
+    {
+        // split into slabs of bounded size, rather than one whose size would overflow
+        constexpr uint32_t largeCount = 3000;
+        dsReserveInstances(assembly, largeCount);
+        CHECK(pool.blockCount == largeCount);
+
+        uint32_t slabCount = 0;
+        for (dsAssemblyInstancePool::Slab const* slab = pool.slabs; slab != nullptr; slab = slab->next)
+        {
+            CHECK(uint64_t{slab->blockCount} * pool.blockStride < UINT32_MAX);
+            ++slabCount;
+        }
+        CHECK(slabCount > 1);
+
+        // a count beyond any allocator reserves what it can, one bounded slab at a time
+        alloc.budget = alloc.allocations + 2;
+        dsReserveInstances(assembly, UINT32_MAX);
+        CHECK(alloc.allocations == alloc.budget);
+        CHECK(pool.blockCount > largeCount);
+        CHECK(pool.freeCount == pool.blockCount);
+        alloc.budget = UINT32_MAX;
+    }
+
+    SECTION("Exhausted")
+    {
+        // an instance which the pool cannot grow for is refused
+        dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+        alloc.budget = alloc.allocations;
+        CHECK(runtime->createInstance(assembly) == dsInvalidInstanceId);
+        CHECK(pool.blockCount == 0);
+        CHECK(assembly->references == 1);
+        alloc.budget = UINT32_MAX;
+        dsDestroyRuntime(runtime);
+    }
+
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Dependency coalescing", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+
+    dsAssembly* assembly = graph.build(
+        {
+            {.type = dsType<int32_t>.typeId, .name = "Left"},
+            {.type = dsType<int32_t>.typeId, .name = "Right"},
+            {.type = dsType<int32_t>.typeId, .name = "Sum"},
+        },
+        [](dsGraphCompiler& compiler) {
+            compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindExpression("Left + Right");
+            compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindVariable("Sum");
+        });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    dsParam const params[] = {
+        {.name = dsName{"Left"}, .value = 0},
+        {.name = dsName{"Right"}, .value = 0},
+    };
+
+    dsInstanceId const instanceId = runtime->createInstance(assembly, params, sizeof(params) / sizeof(params[0]));
+    REQUIRE(instanceId != dsInvalidInstanceId);
+    runtime->processEvents();
+
+    dsRuntimeStats const before = runtime->stats();
+
+    // both writes target the same node, which should only be dispatched once
+    CHECK(runtime->writeVariable(instanceId, dsName{"Left"}, dsValueRef{2}));
+    CHECK(runtime->writeVariable(instanceId, dsName{"Right"}, dsValueRef{3}));
+    runtime->processEvents();
+
+    dsRuntimeStats const after = runtime->stats();
+    CHECK(after.queuedEvents - before.queuedEvents == 1);
+    CHECK(after.coalescedDependencyEvents - before.coalescedDependencyEvents == 1);
+
+    dsValueStorage value;
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Sum"}, value.out()));
+    CHECK(value.as<int32_t>() == 5);
+
+    // once processed, a later change must queue a fresh event
+    CHECK(runtime->writeVariable(instanceId, dsName{"Left"}, dsValueRef{4}));
+    runtime->processEvents();
+
+    CHECK(runtime->stats().queuedEvents - after.queuedEvents == 1);
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Sum"}, value.out()));
+    CHECK(value.as<int32_t>() == 7);
+
+    runtime->destroyInstance(instanceId);
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Expression result cache", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionId{3}, countedFlagNum);
+    graph.runtimeHost.registerFunction(dsFunctionId{4}, volatileFlagNum);
+
+    dsAssembly* assembly = graph.build(
+        {
+            {.type = dsType<int32_t>.typeId, .name = "Input"},
+            {.type = dsType<int32_t>.typeId, .name = "Counted"},
+            {.type = dsType<int32_t>.typeId, .name = "Volatile"},
+            {.type = dsType<int32_t>.typeId, .name = "Echo"},
+        },
+        [](dsGraphCompiler& compiler) {
+            compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindExpression("countedFlagNum()");
+            compiler.beginInputSlot(dsInputSlot(1), dsType<int32_t>.typeId);
+            compiler.bindExpression("volatileFlagNum()");
+            compiler.beginInputSlot(dsInputSlot(2), dsType<int32_t>.typeId);
+            compiler.bindExpression("Input");
+            compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindVariable("Counted");
+            compiler.beginOutputSlot(dsOutputSlot(1), dsType<int32_t>.typeId);
+            compiler.bindVariable("Volatile");
+            compiler.beginOutputSlot(dsOutputSlot(2), dsType<int32_t>.typeId);
+            compiler.bindVariable("Echo");
+        });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    flagEmitterId = runtime->makeEmitterId();
+    flagValue = false;
+    countedCalls = 0;
+    volatileCalls = 0;
+
+    dsParam const params[] = {
+        {.name = dsName{"Input"}, .value = 0},
+    };
+
+    dsInstanceId const instanceId = runtime->createInstance(assembly, params, sizeof(params) / sizeof(params[0]));
+    REQUIRE(instanceId != dsInvalidInstanceId);
+    runtime->processEvents();
+
+    CHECK(countedCalls == 1);
+    CHECK(volatileCalls == 1);
+
+    dsRuntimeStats const before = runtime->stats();
+
+    // the node re-reads every slot, but only the changed one and the volatile one are evaluated again
+    CHECK(runtime->writeVariable(instanceId, dsName{"Input"}, dsValueRef{7}));
+    runtime->processEvents();
+
+    CHECK(runtime->stats().cachedSlotReads - before.cachedSlotReads == 1);
+    CHECK(countedCalls == 1);
+    CHECK(volatileCalls == 2);
+
+    dsValueStorage value;
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Echo"}, value.out()));
+    CHECK(value.as<int32_t>() == 7);
+
+    // a change to something the cached evaluation listened to discards its result
+    flagValue = true;
+    runtime->notifyChange(flagEmitterId);
+    runtime->processEvents();
+
+    CHECK(countedCalls == 2);
+    CHECK(volatileCalls == 3);
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Counted"}, value.out()));
+    CHECK(value.as<int32_t>() == 1);
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Volatile"}, value.out()));
+    CHECK(value.as<int32_t>() == 1);
+
+    runtime->destroyInstance(instanceId);
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Listener diffing", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionId{5}, switchedFlagNum);
+
+    dsAssembly* assembly = graph.build({{.type = dsType<int32_t>.typeId, .name = "Result"}}, [](dsGraphCompiler& compiler) {
+        compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindExpression("switchedFlagNum()");
+        compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindVariable("Result");
+    });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    flagEmitterId = runtime->makeEmitterId();
+    otherEmitterId = runtime->makeEmitterId();
+    flagValue = false;
+    switchedCalls = 0;
+
+    dsInstanceId const instanceId = runtime->createInstance(assembly);
+    REQUIRE(instanceId != dsInvalidInstanceId);
+    runtime->processEvents();
+
+    CHECK(switchedCalls == 1);
+    CHECK(runtime->stats().listenerChanges == 1);
+
+    // re-evaluating with the same emitters leaves the registry untouched
+    runtime->notifyChange(flagEmitterId);
+    runtime->processEvents();
+
+    CHECK(switchedCalls == 2);
+    CHECK(runtime->stats().listenerChanges == 1);
+
+    // swapping emitters forgets the old listener and registers the new one
+    flagValue = true;
+    runtime->notifyChange(flagEmitterId);
+    runtime->processEvents();
+
+    CHECK(switchedCalls == 3);
+    CHECK(runtime->stats().listenerChanges == 3);
+
+    runtime->notifyChange(flagEmitterId);
+    runtime->processEvents();
+    CHECK(switchedCalls == 3);
+
+    runtime->notifyChange(otherEmitterId);
+    runtime->processEvents();
+    CHECK(switchedCalls == 4);
+
+    dsValueStorage value;
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Result"}, value.out()));
+    CHECK(value.as<int32_t>() == 1);
+
+    runtime->destroyInstance(instanceId);
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Native function binding", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionRuntimeMeta{.functionId = dsFunctionId{6},
+        .function = genericLerp,
+        .native = lerpBinding.native,
+        .nativeResult = lerpBinding.nativeResult});
+
+    auto const buildAssembly = [&graph](char const* expression) {
+        return graph.build(
+            {
+                {.type = dsType<float>.typeId, .name = "From"},
+                {.type = dsType<float>.typeId, .name = "To"},
+                {.type = dsType<float>.typeId, .name = "T"},
+            },
+            [expression](dsGraphCompiler& compiler) {
+                compiler.beginInputSlot(dsInputSlot(0), dsType<float>.typeId);
+                compiler.bindExpression(expression);
+            });
+    };
+
+    // the signature generated from lerp rejects arguments of any other type
+    CHECK(buildAssembly("mix(From, 1, T)") == nullptr);
+    CHECK(buildAssembly("mix(From, To)") == nullptr);
+
+    dsAssembly* const assembly = buildAssembly("mix(From, To, T) * -T");
+    REQUIRE(assembly != nullptr);
+
+    dsValueStorage const variables[] = {dsValueStorage{2.f}, dsValueStorage{6.f}, dsValueStorage{0.25f}};
+
+    DetachedEvaluateHost evaluateHost;
+
+    dsEvaluateScratch scratch(alloc);
+    genericLerpCalls = 0;
+
+    for (dsEvaluateDispatch const dispatch : {dsEvaluateDispatch::Switch, dsEvaluateDispatch::Threaded})
+    {
+        dsValueStorage result;
+        REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out(), dispatch));
+        REQUIRE(result.is<float>());
+        CHECK(result.as<float>() == -0.75f);
+    }
+
+    CHECK(genericLerpCalls == 0);
+
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Parallel processing", "[runtime]")
+{
+    using namespace descript;
+
+    // the parallel modes require a thread-safe allocator
+    dsDefaultAllocator alloc;
+    SetStateGraph graph(alloc);
+
+    ThreadScheduler scheduler;
+    graph.runtimeHost.registerFunction(dsFunctionId{2}, readFlagNum);
+    graph.runtimeHost.setScheduler(&scheduler);
+
+    dsAssembly* assembly = graph.build(
+        {
+            {.type = dsType<int32_t>.typeId, .name = "Base"},
+            {.type = dsType<int32_t>.typeId, .name = "Result"},
+        },
+        [](dsGraphCompiler& compiler) {
+            compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindExpression("Base + readFlagNum()");
+            compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindVariable("Result");
+        });
+    REQUIRE(assembly != nullptr);
+
+    for (dsProcessMode const mode : {dsProcessMode::Parallel, dsProcessMode::Deterministic})
+    {
+        dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+        runtime->setProcessMode(mode);
+
+        flagEmitterId = runtime->makeEmitterId();
+        flagValue = false;
+
+        // enough instances to be split into many chunks across all workers
+        constexpr int32_t instanceCount = 1000;
+        std::vector<dsInstanceId> instanceIds;
+        for (int32_t index = 0; index != instanceCount; ++index)
+        {
+            dsParam const param{.name = dsName{"Base"}, .value = index};
+            instanceIds.push_back(runtime->createInstance(assembly, &param, 1));
+        }
+
+        runtime->processEvents();
+
+        dsVariableHandle const resultHandle = runtime->lookupVariable(assembly, dsName{"Result"});
+        auto const countMatching = [&](int32_t offset) {
+            int32_t matching = 0;
+            dsValueStorage value;
+            for (int32_t index = 0; index != instanceCount; ++index)
+                if (runtime->readVariable(instanceIds[index], resultHandle, value.out()) && value.as<int32_t>() == index + offset)
+                    ++matching;
+            return matching;
+        };
+
+        CHECK(countMatching(0) == instanceCount);
+
+        // listeners registered on worker threads must have been merged into the runtime
+        flagValue = true;
+        runtime->notifyChange(flagEmitterId);
+        runtime->processEvents();
+
+        CHECK(countMatching(1) == instanceCount);
+
+        for (dsInstanceId const instanceId : instanceIds)
+            runtime->destroyInstance(instanceId);
+
+        dsDestroyRuntime(runtime);
+    }
+
+    dsReleaseAssembly(assembly);
+}
+
+TEST_CASE("Posted changes", "[runtime]")
+{
+    using namespace descript;
+
+    // producers run on their own threads, so the allocator must be thread-safe
+    dsDefaultAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionId{2}, readFlagNum);
+
+    dsAssembly* assembly = graph.build({{.type = dsType<int32_t>.typeId, .name = "Result"}}, [](dsGraphCompiler& compiler) {
+        compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindExpression("readFlagNum()");
+        compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindVariable("Result");
+    });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    flagEmitterId = runtime->makeEmitterId();
+    flagValue = false;
+
+    dsInstanceId const instanceId = runtime->createInstance(assembly);
+    REQUIRE(instanceId != dsInvalidInstanceId);
+    runtime->processEvents();
+
+    dsValueStorage value;
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Result"}, value.out()));
+    CHECK(value.as<int32_t>() == 0);
+
+    flagValue = true;
+
+    constexpr int producerCount = 4;
+    constexpr int postsPerProducer = 500;
+
+    // Catch assertions are not thread-safe, so producers only count their rejected posts
+    std::atomic<int> rejected = 0;
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer != producerCount; ++producer)
+    {
+        producers.emplace_back([runtime, &rejected] {
+            for (int post = 0; post != postsPerProducer; ++post)
+                if (!runtime->postChange(flagEmitterId))
+                    ++rejected;
+        });
+    }
+    for (std::thread& producer : producers)
+        producer.join();
+
+    CHECK(rejected == 0);
+
+    dsRuntimeStats const before = runtime->stats();
+    runtime->processEvents();
+    dsRuntimeStats const after = runtime->stats();
+
+    // every post after the first names the same emitter and collapses into it
+    CHECK(after.coalescedPostedChanges - before.coalescedPostedChanges == producerCount * postsPerProducer - 1);
+    CHECK(after.queuedEvents - before.queuedEvents == 1);
+
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Result"}, value.out()));
+    CHECK(value.as<int32_t>() == 1);
+
+    CHECK_FALSE(runtime->postChange(dsInvalidEmitterId));
+
+    runtime->destroyInstance(instanceId);
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Posted change capacity", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionId{2}, readFlagNum);
+
+    // rounded up to a power of two
+    graph.runtimeHost.setPostedChangeCapacity(6);
+    constexpr uint32_t capacity = 8;
+
+    dsAssembly* assembly = graph.build({{.type = dsType<int32_t>.typeId, .name = "Result"}}, [](dsGraphCompiler& compiler) {
+        compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindExpression("readFlagNum()");
+        compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+        compiler.bindVariable("Result");
+    });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    flagEmitterId = runtime->makeEmitterId();
+    flagValue = false;
+
+    dsInstanceId const instanceId = runtime->createInstance(assembly);
+    REQUIRE(instanceId != dsInvalidInstanceId);
+    runtime->processEvents();
+
+    flagValue = true;
+
+    for (uint32_t post = 0; post != capacity; ++post)
+        CHECK(runtime->postChange(flagEmitterId));
+
+    // a full queue refuses further posts, and counts them
+    CHECK_FALSE(runtime->postChange(flagEmitterId));
+    CHECK_FALSE(runtime->postChange(flagEmitterId));
+    CHECK(runtime->stats().rejectedPostedChanges == 2);
+
+    // the changes already queued are still applied
+    dsRuntimeStats const before = runtime->stats();
+    runtime->processEvents();
+    dsRuntimeStats const after = runtime->stats();
+    CHECK(after.coalescedPostedChanges - before.coalescedPostedChanges == capacity - 1);
+
+    dsValueStorage value;
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Result"}, value.out()));
+    CHECK(value.as<int32_t>() == 1);
+
+    // and draining makes room again
+    CHECK(runtime->postChange(flagEmitterId));
+    CHECK(runtime->stats().rejectedPostedChanges == 2);
+
+    runtime->destroyInstance(instanceId);
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Deep expressions", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+
+    // nesting to the right keeps every left operand on the stack, beyond the interpreter's inline stack
+    constexpr int depth = 48;
+    std::string expression;
+    for (int index = 0; index != depth; ++index)
+        expression += "Value + (";
+    expression += "Value";
+    expression.append(depth, ')');
+
+    dsAssembly* assembly = graph.build(
+        {
+            {.type = dsType<int32_t>.typeId, .name = "Value"},
+            {.type = dsType<int32_t>.typeId, .name = "Result"},
+        },
+        [&expression](dsGraphCompiler& compiler) {
+            compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindExpression(expression.c_str());
+            compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+            compiler.bindVariable("Result");
+        });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    dsParam const param{.name = dsName{"Value"}, .value = 2};
+    dsInstanceId const instanceId = runtime->createInstance(assembly, &param, 1);
+    REQUIRE(instanceId != dsInvalidInstanceId);
+    runtime->processEvents();
+
+    dsValueStorage value;
+    REQUIRE(runtime->readVariable(instanceId, dsName{"Result"}, value.out()));
+    CHECK(value.as<int32_t>() == 2 * (depth + 1));
+
+    // the deep stack is allocated once, and reused by every later evaluation
+    {
+        CountingAllocator countingAlloc(alloc);
+        dsEvaluateScratch scratch(countingAlloc);
+        DetachedEvaluateHost evaluateHost;
+        dsValueStorage const variables[2] = {3, 0};
+        for (int evaluation = 0; evaluation != 4; ++evaluation)
+        {
+            dsValueStorage result;
+            REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out()));
+            CHECK(result.as<int32_t>() == 3 * (depth + 1));
+        }
+        CHECK(countingAlloc.allocations == 1);
+
+        // an allocator which fails the stack fails the evaluation, rather than the process
+        dsEvaluateScratch exhausted(countingAlloc);
+        countingAlloc.budget = countingAlloc.allocations;
+        dsValueStorage result;
+        CHECK_FALSE(dsEvaluateInstructions(evaluateHost, exhausted, *assembly, dsAssemblyExpressionIndex{0}, variables, result.out()));
+    }
+
+    runtime->destroyInstance(instanceId);
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Tagged stack", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+
+    // values of types which are not built-in are carried on the stack alongside their type
+    dsAssembly* const assembly = graph.build(
+        {
+            {.type = dsType<bool>.typeId, .name = "Flag"},
+            {.type = dsType<TestPair>.typeId, .name = "Left"},
+            {.type = dsType<TestPair>.typeId, .name = "Right"},
+            {.type = dsType<TestPair>.typeId, .name = "Result"},
+        },
+        [](dsGraphCompiler& compiler) {
+            compiler.beginInputSlot(dsInputSlot(0), dsType<TestPair>.typeId);
+            compiler.bindExpression("select(Flag, Left, Right)");
+            compiler.beginOutputSlot(dsOutputSlot(0), dsType<TestPair>.typeId);
+            compiler.bindVariable("Result");
+        });
+    REQUIRE(assembly != nullptr);
+
+    dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+    for (bool const flag : {true, false})
+    {
+        dsInstanceId const instanceId = runtime->createInstance(assembly);
+        REQUIRE(instanceId != dsInvalidInstanceId);
+        CHECK(runtime->writeVariable(instanceId, dsName{"Flag"}, dsValueRef{flag}));
+        CHECK(runtime->writeVariable(instanceId, dsName{"Left"}, dsValueRef{TestPair{.first = 1, .second = 2}}));
+        CHECK(runtime->writeVariable(instanceId, dsName{"Right"}, dsValueRef{TestPair{.first = 3, .second = 4}}));
+        runtime->processEvents();
+
+        dsValueStorage value;
+        REQUIRE(runtime->readVariable(instanceId, dsName{"Result"}, value.out()));
+        REQUIRE(value.type() == dsType<TestPair>.typeId);
+        CHECK(value.as<TestPair>() == (flag ? TestPair{.first = 1, .second = 2} : TestPair{.first = 3, .second = 4}));
+
+        runtime->destroyInstance(instanceId);
+    }
+
+    dsReleaseAssembly(assembly);
+
+    dsDestroyRuntime(runtime);
+}
+
+TEST_CASE("Packed variables", "[runtime]")
+{
+    using namespace descript;
+
+    SECTION("Values")
+    {
+        // two int32, one float32, seventy bools spanning two words, and one in storage
+        int32_t int32s[2] = {};
+        float float32s[1] = {};
+        uint64_t boolBits[2] = {};
+        dsValueStorage values[1];
+        dsPackedVariables variables{.int32s = int32s,
+            .float32s = float32s,
+            .boolBits = boolBits,
+            .values = values,
+            .layout = {.float32Start = 2, .boolStart = 3, .valueStart = 73, .count = 74}};
+
+        REQUIRE(variables.assign(1, dsValueRef{7}));
+        CHECK(variables.read<int32_t>(1) == 7);
+        CHECK(variables.ref(1) == dsValueRef{7});
+
+        REQUIRE(variables.assign(2, dsValueRef{2.5f}));
+        CHECK(variables.read<float>(2) == 2.5f);
+        CHECK(variables.ref(2) == dsValueRef{2.5f});
+
+        REQUIRE(variables.assign(71, dsValueRef{true}));
+        CHECK(boolBits[0] == 0);
+        CHECK(boolBits[1] == uint64_t{1} << 4);
+        CHECK(variables.read<bool>(71));
+        CHECK_FALSE(variables.read<bool>(70));
+        CHECK(variables.ref(71) == dsValueRef{true});
+        REQUIRE(variables.assign(71, dsValueRef{false}));
+        CHECK(boolBits[1] == 0);
+
+        // a packed variable refuses any other type, and keeps its value
+        CHECK_FALSE(variables.assign(1, dsValueRef{2.5f}));
+        CHECK_FALSE(variables.assign(2, dsValueRef{7}));
+        CHECK_FALSE(variables.assign(3, dsValueRef{1}));
+        CHECK(variables.read<int32_t>(1) == 7);
+
+        // while storage holds anything
+        TestPair const pair{.first = 1, .second = 2};
+        REQUIRE(variables.assign(73, dsValueRef{pair}));
+        CHECK(variables.ref(73) == dsValueRef{pair});
+        REQUIRE(variables.assign(73, dsValueRef{7}));
+        CHECK(variables.ref(73) == dsValueRef{7});
+    }
+
+    SECTION("Instances")
+    {
+        test::LeakTestAllocator alloc;
+        SetStateGraph graph(alloc);
+
+        // declared out of order, optionally after one of a type which is not built-in
+        constexpr TestVariable variables[] = {
+            {.type = dsType<TestPair>.typeId, .name = "Pair"},
+            {.type = dsType<bool>.typeId, .name = "Flag"},
+            {.type = dsType<float>.typeId, .name = "Scale"},
+            {.type = dsType<int32_t>.typeId, .name = "Input"},
+            {.type = dsType<float>.typeId, .name = "Scaled"},
+            {.type = dsType<int32_t>.typeId, .name = "Echo"},
+        };
+
+        auto const buildAssembly = [&](bool withPair) {
+            return graph.build(withPair ? variables : variables + 1, std::end(variables), [withPair](dsGraphCompiler& compiler) {
+                compiler.beginInputSlot(dsInputSlot(0), dsType<int32_t>.typeId);
+                compiler.bindExpression("Input + 1");
+                compiler.beginInputSlot(dsInputSlot(1), dsType<float>.typeId);
+                compiler.bindExpression("select(Flag, Scale * Scale, -Scale)");
+                compiler.beginOutputSlot(dsOutputSlot(0), dsType<int32_t>.typeId);
+                compiler.bindVariable("Echo");
+                compiler.beginOutputSlot(dsOutputSlot(1), dsType<float>.typeId);
+                compiler.bindVariable("Scaled");
+
+                // bound only to keep the variable live, as the node has no input slot to echo into it
+                if (withPair)
+                {
+                    compiler.beginOutputSlot(dsOutputSlot(2), dsType<TestPair>.typeId);
+                    compiler.bindVariable("Pair");
+                }
+            });
+        };
+
+        dsAssembly* const packed = buildAssembly(false);
+        REQUIRE(packed != nullptr);
+        dsAssembly* const mixed = buildAssembly(true);
+        REQUIRE(mixed != nullptr);
+
+        // sorted by type, whatever the order of declaration
+        for (dsAssembly* const assembly : {packed, mixed})
+        {
+            dsVariableLayout const& layout = assembly->variableLayout;
+            CHECK(layout.float32Start == 2);
+            CHECK(layout.boolStart == 4);
+            CHECK(layout.valueStart == 5);
+        }
+        CHECK(packed->variableLayout.valueCount() == 0);
+        CHECK(mixed->variableLayout.valueCount() == 1);
+
+        dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+        for (dsAssembly* const assembly : {packed, mixed})
+        {
+            dsParam const params[] = {
+                {.name = dsName{"Input"}, .value = 4},
+            };
+
+            dsInstanceId const instanceId = runtime->createInstance(assembly, params, sizeof(params) / sizeof(params[0]));
+            REQUIRE(instanceId != dsInvalidInstanceId);
+            CHECK(runtime->writeVariable(instanceId, dsName{"Scale"}, dsValueRef{0.5f}));
+            CHECK(runtime->writeVariable(instanceId, dsName{"Flag"}, dsValueRef{true}));
+            runtime->processEvents();
+
+            dsValueStorage value;
+            REQUIRE(runtime->readVariable(instanceId, dsName{"Echo"}, value.out()));
+            CHECK(value.as<int32_t>() == 5);
+            REQUIRE(runtime->readVariable(instanceId, dsName{"Scaled"}, value.out()));
+            CHECK(value.as<float>() == 0.25f);
+
+            CHECK(runtime->writeVariable(instanceId, dsName{"Input"}, dsValueRef{9}));
+            CHECK(runtime->writeVariable(instanceId, dsName{"Flag"}, dsValueRef{false}));
+            runtime->processEvents();
+            REQUIRE(runtime->readVariable(instanceId, dsName{"Echo"}, value.out()));
+            CHECK(value.as<int32_t>() == 10);
+            REQUIRE(runtime->readVariable(instanceId, dsName{"Scaled"}, value.out()));
+            CHECK(value.as<float>() == -0.5f);
+
+            // a packed variable only holds its declared type, while one in storage holds anything
+            CHECK_FALSE(runtime->writeVariable(instanceId, dsName{"Scale"}, dsValueRef{1}));
+            REQUIRE(runtime->readVariable(instanceId, dsName{"Scale"}, value.out()));
+            CHECK(value.as<float>() == 0.5f);
+            if (assembly == mixed)
+            {
+                CHECK(runtime->writeVariable(instanceId, dsName{"Pair"}, dsValueRef{7}));
+                TestPair const pair{.first = 1, .second = 2};
+                CHECK(runtime->writeVariable(instanceId, dsName{"Pair"}, dsValueRef{pair}));
+            }
+
+            runtime->destroyInstance(instanceId);
+        }
+
+        dsReleaseAssembly(mixed);
+        dsReleaseAssembly(packed);
+
+        dsDestroyRuntime(runtime);
+    }
+
+    SECTION("Size")
+    {
+        test::LeakTestAllocator alloc;
+        SetStateGraph graph(alloc);
+
+        // a third each of int32, float32, and bool variables, each kept live by an output slot
+        auto const buildAssembly = [&graph](uint32_t variableCount) {
+            constexpr dsTypeId types[] = {dsType<int32_t>.typeId, dsType<float>.typeId, dsType<bool>.typeId};
+
+            // the names are all created before any is referenced, so that none moves
+            std::vector<std::string> names;
+            for (uint32_t index = 0; index != variableCount; ++index)
+                names.push_back("Var" + std::to_string(index));
+
+            std::vector<TestVariable> variables;
+            for (uint32_t index = 0; index != variableCount; ++index)
+                variables.push_back({.type = types[index % 3], .name = names[index].c_str()});
+
+            return graph.build(variables.data(), variables.data() + variables.size(), [&variables](dsGraphCompiler& compiler) {
+                for (uint32_t index = 0; index != variables.size(); ++index)
+                {
+                    compiler.beginOutputSlot(dsOutputSlot(index), variables[index].type);
+                    compiler.bindVariable(variables[index].name);
+                }
+            });
+        };
+
+        dsAssembly* const empty = buildAssembly(0);
+        REQUIRE(empty != nullptr);
+        dsAssembly* const full = buildAssembly(200);
+        REQUIRE(full != nullptr);
+
+        // at least five times smaller than holding every variable in storage
+        CHECK(full->variableLayout.valueCount() == 0);
+        CHECK((full->instanceSize - empty->instanceSize) * 5 <= 200 * sizeof(dsValueStorage));
+
+        dsReleaseAssembly(full);
+        dsReleaseAssembly(empty);
+    }
+}
+
+TEST_CASE("Batch evaluation", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionId{0}, series);
+
+    // more blocks than a group of lanes holds, and not a multiple of it
+    constexpr uint32_t blockCount = 13;
+    dsValueStorage blocks[blockCount][2];
+    dsValueStorage const* variables[blockCount];
+    for (uint32_t index = 0; index != blockCount; ++index)
+        variables[index] = blocks[index];
+
+    DetachedEvaluateHost evaluateHost;
+
+    dsEvaluateScratch scratch(alloc);
+
+    auto const checkBatch = [&](char const* expression, dsTypeId typeId) {
+        dsAssembly* assembly = graph.buildExpression(expression, typeId);
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage results[blockCount];
+        REQUIRE(
+            dsEvaluateInstructionsBatch(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables, blockCount, results));
+
+        for (uint32_t index = 0; index != blockCount; ++index)
+        {
+            dsValueStorage expected;
+            REQUIRE(
+                dsEvaluateInstructions(evaluateHost, scratch, *assembly, dsAssemblyExpressionIndex{0}, variables[index], expected.out()));
+            CHECK(results[index].ref() == expected.ref());
+        }
+
+        dsReleaseAssembly(assembly);
+    };
+
+    SECTION("Int32")
+    {
+        for (uint32_t index = 0; index != blockCount; ++index)
+        {
+            blocks[index][0] = dsValueStorage{static_cast<int32_t>(index) - 4};
+            blocks[index][1] = dsValueStorage{static_cast<int32_t>(index % 3)};
+        }
+
+        // includes division by zero
+        checkBatch("X * Y - X / Y + -X", dsType<int32_t>.typeId);
+        checkBatch("clamp(X, -2, 3) + max(abs(X), Y) * min(X, Y)", dsType<int32_t>.typeId);
+        checkBatch("select(X < Y, X * 2, Y - X) + select(X == Y or X > 3, 1, 0)", dsType<int32_t>.typeId);
+
+        // functions cannot be evaluated in lanes, so each block is evaluated alone
+        checkBatch("series(X, Y) + 1", dsType<int32_t>.typeId);
+
+        // nor can jumps, which the lanes of a group may take differently
+        checkBatch("select(X < Y, series(X, Y), Y)", dsType<int32_t>.typeId);
+    }
+
+    SECTION("Float32")
+    {
+        for (uint32_t index = 0; index != blockCount; ++index)
+        {
+            blocks[index][0] = dsValueStorage{static_cast<float>(index) * 0.5f};
+            blocks[index][1] = dsValueStorage{static_cast<float>(index % 3)};
+        }
+
+        checkBatch("X * X - X / Y + -Y", dsType<float>.typeId);
+        checkBatch("lerp(X, Y, Y) + sqrt(abs(X - Y)) - floor(Y - X) * clamp(X, -Y, Y)", dsType<float>.typeId);
+        checkBatch("select(X >= Y, X, -Y) * select(X != Y and X <= Y + Y, Y, X)", dsType<float>.typeId);
+    }
+
+    SECTION("Runtime")
+    {
+        // the SetState node follows the entry node
+        constexpr dsNodeIndex setStateNodeIndex{1};
+
+        dsRuntime* const runtime = dsCreateRuntime(alloc, graph.runtimeHost);
+
+        auto const checkSlot = [&](char const* expression, auto const& expected) {
+            dsAssembly* assembly = graph.buildExpression(expression, dsType<int32_t>.typeId);
+            REQUIRE(assembly != nullptr);
+
+            std::vector<dsInstanceId> instanceIds(blockCount, dsInvalidInstanceId);
+            for (uint32_t index = 0; index != blockCount; ++index)
+            {
+                dsParam const params[] = {
+                    {.name = dsName{"X"}, .value = static_cast<int32_t>(index) - 4},
+                    {.name = dsName{"Y"}, .value = static_cast<int32_t>(index % 3)},
+                };
+                instanceIds[index] = runtime->createInstance(assembly, params, 2);
+                REQUIRE(instanceIds[index] != dsInvalidInstanceId);
+            }
+
+            dsValueStorage results[blockCount];
+            std::vector<dsValueOut> outs;
+            for (dsValueStorage& result : results)
+                outs.push_back(result.out());
+
+            REQUIRE(runtime->readInputSlot(assembly, setStateNodeIndex, dsInputSlot(0), instanceIds.data(), blockCount, outs.data()));
+            for (uint32_t index = 0; index != blockCount; ++index)
+                CHECK(results[index].as<int32_t>() == expected(static_cast<int32_t>(index) - 4, static_cast<int32_t>(index % 3)));
+
+            // every instance must be of the assembly, and the slot must exist
+            CHECK_FALSE(runtime->readInputSlot(assembly, dsNodeIndex{2}, dsInputSlot(0), instanceIds.data(), blockCount, outs.data()));
+            CHECK_FALSE(runtime->readInputSlot(assembly, setStateNodeIndex, dsInputSlot(1), instanceIds.data(), blockCount, outs.data()));
+            runtime->destroyInstance(instanceIds[5]);
+            CHECK_FALSE(runtime->readInputSlot(assembly, setStateNodeIndex, dsInputSlot(0), instanceIds.data(), blockCount, outs.data()));
+
+            for (dsInstanceId const instanceId : instanceIds)
+                runtime->destroyInstance(instanceId);
+            dsReleaseAssembly(assembly);
+        };
+
+        checkSlot("X * Y + clamp(X, -2, 3)", [](int32_t x, int32_t y) { return x * y + std::clamp(x, -2, 3); });
+
+        // functions are called for each instance alone
+        checkSlot("series(X, Y) + 1", [](int32_t x, int32_t y) { return x * y + 1; });
+
+        dsDestroyRuntime(runtime);
+    }
+}
+
+#if DS_JIT
+TEST_CASE("JIT compilation", "[runtime]")
+{
+    using namespace descript;
+
+    test::LeakTestAllocator alloc;
+    SetStateGraph graph(alloc);
+    graph.runtimeHost.registerFunction(dsFunctionId{0}, series);
+
+    DetachedEvaluateHost evaluateHost;
+
+    dsEvaluateScratch scratch(alloc);
+    constexpr dsAssemblyExpressionIndex expressionIndex{0};
+
+    // NaN is unequal even to itself, so two NaN results agree
+    auto const agrees = [](dsValueRef const& actual, dsValueStorage const& expected) {
+        bool const bothNaN = actual.type() == dsType<float>.typeId && expected.type() == dsType<float>.typeId &&
+            actual.as<float>() != actual.as<float>() && expected.as<float>() != expected.as<float>();
+        return bothNaN || actual == expected.ref();
+    };
+
+    // the interpreter is the oracle for the compiled code, over variables held either as storage or packed
+    auto const checkCompiled = [&](char const* expression, dsTypeId typeId, std::initializer_list<dsValueStorage> values) {
+        dsAssembly* assembly = graph.buildExpression(expression, typeId);
+        REQUIRE(assembly != nullptr);
+        REQUIRE(assembly->variableLayout.valueCount() == 0);
+
+        dsValueStorage variables[2] = {*values.begin(), *values.begin()};
+        dsJitExpression jit;
+        REQUIRE(dsJitCompile(*assembly, expressionIndex, variables, jit));
+
+        int32_t int32s[2] = {};
+        float float32s[2] = {};
+        uint64_t boolBits[1] = {};
+        dsPackedVariables packedVariables{
+            .int32s = int32s, .float32s = float32s, .boolBits = boolBits, .layout = assembly->variableLayout};
+        dsJitExpression packedJit;
+        REQUIRE(dsJitCompile(*assembly, expressionIndex, &packedVariables, packedJit));
+
+        dsJitFunction const function = jit.function.load();
+        REQUIRE(function != nullptr);
+        dsJitFunction const packedFunction = packedJit.function.load();
+        REQUIRE(packedFunction != nullptr);
+
+        for (dsValueStorage const& x : values)
+        {
+            for (dsValueStorage const& y : values)
+            {
+                variables[0] = x;
+                variables[1] = y;
+                REQUIRE(packedVariables.assign(0, x.ref()));
+                REQUIRE(packedVariables.assign(1, y.ref()));
+
+                dsValueStorage expected;
+                REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, expressionIndex, variables, expected.out()));
+
+                dsValueStorage interpreted;
+                REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, expressionIndex, &packedVariables, interpreted.out()));
+                CHECK(agrees(interpreted.ref(), expected));
+
+                alignas(uint32_t) char result[sizeof(uint32_t)];
+                REQUIRE(function(variables, result));
+                CHECK(agrees(dsValueRef(*jit.resultMeta, result), expected));
+
+                REQUIRE(packedFunction(&packedVariables, result));
+                CHECK(agrees(dsValueRef(*packedJit.resultMeta, result), expected));
+            }
+        }
+
+        dsJitRelease(packedJit);
+        dsJitRelease(jit);
+        dsReleaseAssembly(assembly);
+    };
+
+    SECTION("Int32")
+    {
+        std::initializer_list<dsValueStorage> const values = {0, 1, -1, 7, -13, 1000};
+        checkCompiled("X * Y - X / Y + -X", dsType<int32_t>.typeId, values);
+        checkCompiled("(X + 1000000) * (Y - 2) / (X + -3)", dsType<int32_t>.typeId, values);
+        checkCompiled("clamp(X, -Y, 100) - max(X, Y) * min(abs(X), Y)", dsType<int32_t>.typeId, values);
+        checkCompiled("select(X < Y, X, Y) - select(X >= Y, Y, 3) * select(X == Y or X > 7, X, 5) + select(X <= Y, 1, 0)",
+            dsType<int32_t>.typeId, values);
+    }
+
+    SECTION("Float32")
+    {
+        std::initializer_list<dsValueStorage> const values = {0.f, -0.f, 1.f, 2.5f, -7.25f, 1e30f};
+        checkCompiled("X * X - X / Y + -Y", dsType<float>.typeId, values);
+
+        // without the largest value, which would overflow to infinities whose difference is NaN
+        checkCompiled("lerp(X, Y, X) + clamp(X, -Y, Y) - sqrt(abs(Y)) + min(X, Y) * max(X, Y)", dsType<float>.typeId,
+            {0.f, -0.f, 1.f, 2.5f, -7.25f, 16.f});
+
+        // comparisons with NaN are false, except for inequality
+        checkCompiled("select(X < Y, Y, X) - select(X >= Y, Y, X) * select(X != Y, X, Y) + select(X == Y or X > Y, X, -Y)",
+            dsType<float>.typeId, {0.f, -0.f, 2.5f, -7.25f, dsValueStorage{std::numeric_limits<float>::quiet_NaN()}});
+        checkCompiled("select(X <= Y, -X, Y) + select(X == X and Y == Y, X, Y)", dsType<float>.typeId,
+            {1.f, -1.f, dsValueStorage{std::numeric_limits<float>::quiet_NaN()}});
+    }
+
+    SECTION("Bool")
+    {
+        std::initializer_list<dsValueStorage> const values = {true, false};
+        checkCompiled("X and not Y or X xor Y", dsType<bool>.typeId, values);
+        checkCompiled("select(X == Y, X, Y != X) and (X is not Y or X)", dsType<bool>.typeId, values);
+    }
+
+    SECTION("Guards")
+    {
+        dsAssembly* assembly = graph.buildExpression("X + Y", dsType<int32_t>.typeId);
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage variables[2] = {1, 2};
+        dsJitExpression jit;
+        REQUIRE(dsJitCompile(*assembly, expressionIndex, variables, jit));
+
+        // specialized to int32 variables, so anything else must fall back to the interpreter
+        variables[1] = dsValueStorage{2.f};
+        alignas(uint32_t) char result[sizeof(uint32_t)];
+        CHECK_FALSE(jit.function.load()(variables, result));
+
+        dsJitRelease(jit);
+        dsReleaseAssembly(assembly);
+    }
+
+    SECTION("Unsupported")
+    {
+        dsAssembly* assembly = graph.buildExpression("series(X, Y) + 1", dsType<int32_t>.typeId);
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage const variables[2] = {1, 2};
+        dsJitExpression jit;
+        CHECK_FALSE(dsJitCompile(*assembly, expressionIndex, variables, jit));
+        CHECK(jit.function.load() == nullptr);
+
+        dsReleaseAssembly(assembly);
+
+        // rounding needs instructions beyond the SSE2 baseline
+        assembly = graph.buildExpression("floor(X)", dsType<float>.typeId);
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage const floatVariables[2] = {1.5f, 2.f};
+        CHECK_FALSE(dsJitCompile(*assembly, expressionIndex, floatVariables, jit));
+
+        dsReleaseAssembly(assembly);
+    }
+
+    SECTION("Jumps")
+    {
+        // jumps are only emitted to skip calls, so these are never compiled, and evaluation stays in the interpreter
+        for (char const* const expression : {"select(X < Y, series(X, Y), Y)", "select(X > 0 and series(X, Y) > 1, X, Y)"})
+        {
+            dsAssembly* assembly = graph.buildExpression(expression, dsType<int32_t>.typeId);
+            REQUIRE(assembly != nullptr);
+
+            dsAssemblyDecodedExpression const& decoded = assembly->decodedExpressions[expressionIndex];
+            bool jumps = false;
+            for (uint32_t index = 0; index != decoded.instructionCount; ++index)
+            {
+                dsOpCode const op = assembly->instructions[decoded.instructionStart + index].op;
+                jumps |= op == dsOpCode::Jump || op == dsOpCode::JumpIfFalse || op == dsOpCode::JumpIfFalseOrPop;
+            }
+            REQUIRE(jumps);
+
+            dsValueStorage const variables[2] = {2, 3};
+            dsJitExpression jit;
+            CHECK_FALSE(dsJitCompile(*assembly, expressionIndex, variables, jit));
+
+            dsValueStorage expected;
+            REQUIRE(dsEvaluateInstructions(evaluateHost, scratch, *assembly, expressionIndex, variables, expected.out()));
+
+            for (uint32_t evaluation = 0; evaluation != dsJitPromotionThreshold + 1; ++evaluation)
+            {
+                dsValueStorage result;
+                REQUIRE(dsEvaluateExpression(evaluateHost, scratch, *assembly, expressionIndex, variables, result.out()));
+                CHECK(result.ref() == expected.ref());
+            }
+            CHECK(assembly->decodedExpressions[expressionIndex].jit.function.load() == nullptr);
+
+            dsReleaseAssembly(assembly);
+        }
+    }
+
+    SECTION("Promotion")
+    {
+        dsAssembly* assembly = graph.buildExpression("X * Y", dsType<int32_t>.typeId);
+        REQUIRE(assembly != nullptr);
+
+        dsValueStorage const variables[2] = {6, 7};
+        for (uint32_t evaluation = 0; evaluation != dsJitPromotionThreshold + 1; ++evaluation)
+        {
+            dsValueStorage result;
+            REQUIRE(dsEvaluateExpression(evaluateHost, scratch, *assembly, expressionIndex, variables, result.out()));
+            CHECK(result.as<int32_t>() == 42);
+            bool const promoted = assembly->decodedExpressions[expressionIndex].jit.function.load() != nullptr;
+            CHECK(promoted == (evaluation + 1 >= dsJitPromotionThreshold));
+        }
+
+        dsReleaseAssembly(assembly);
+    }
+}
+#endif